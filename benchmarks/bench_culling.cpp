@@ -0,0 +1,142 @@
+#include "benchmark.h"
+#include "core/math/aabb_tree.h"
+#include "core/math/frustum.h"
+#include "core/math/math_includes.h"
+#include <random>
+
+// Culls 100k and 1M boxes spread around a camera, without any rendering:
+// the oriented box test per model that gather_visible_models did before,
+// the batched world box test and a query of the aabb tree. Building the tree
+// and updating it for a frame with a few moved boxes is timed as well.
+namespace
+{
+const std::size_t runs = 5;
+const float world_size = 1000.0f;
+
+struct scene
+{
+	std::vector<math::transform> transforms;
+	std::vector<math::bbox> world_bounds;
+	math::bbox local_bounds;
+};
+
+scene create_scene(std::size_t count)
+{
+	std::mt19937 rng(7);
+	std::uniform_real_distribution<float> position(-world_size, world_size);
+	std::uniform_real_distribution<float> height(-50.0f, 50.0f);
+	std::uniform_real_distribution<float> scale(0.5f, 4.0f);
+
+	scene s;
+	s.local_bounds = math::bbox(-0.5f, -0.5f, -0.5f, 0.5f, 0.5f, 0.5f);
+	s.transforms.resize(count);
+	s.world_bounds.resize(count);
+	for(std::size_t i = 0; i < count; ++i)
+	{
+		auto& t = s.transforms[i];
+		t.set_scale(math::vec3(scale(rng)));
+		t.set_position(math::vec3(position(rng), height(rng), position(rng)));
+		s.world_bounds[i] = math::bbox::mul(s.local_bounds, t);
+	}
+	return s;
+}
+
+math::frustum create_frustum()
+{
+	math::transform view;
+	view.look_at(math::vec3(0.0f, 10.0f, 0.0f), math::vec3(0.0f, 10.0f, 1.0f));
+	math::transform proj =
+		math::perspective(math::radians(60.0f), 16.0f / 9.0f, 0.1f, world_size, false);
+	return math::frustum(view, proj, false);
+}
+
+std::size_t cull_obbs(const scene& s, const math::frustum& f)
+{
+	std::size_t visible = 0;
+	for(std::size_t i = 0; i < s.transforms.size(); ++i)
+	{
+		if(math::frustum::test_obb(f, s.local_bounds, s.transforms[i]))
+			++visible;
+	}
+	return visible;
+}
+
+std::size_t cull_aabbs(const scene& s, const math::frustum& f, std::vector<std::uint32_t>& bits)
+{
+	bits.resize((s.world_bounds.size() + 31) / 32);
+	f.test_aabbs(s.world_bounds.data(), s.world_bounds.size(), bits.data());
+
+	std::size_t visible = 0;
+	for(auto word : bits)
+	{
+		for(; word != 0; word &= word - 1)
+		{
+			++visible;
+		}
+	}
+	return visible;
+}
+
+// the same as the renderer, only leaves crossing a plane get the exact test
+std::size_t cull_tree(const scene& s, const math::aabb_tree& tree, const math::frustum& f)
+{
+	std::size_t visible = 0;
+	tree.query(f, [&](std::uint32_t index, bool inside) {
+		if(inside || math::frustum::test_obb(f, s.local_bounds, s.transforms[index]))
+			++visible;
+	});
+	return visible;
+}
+
+void run(std::size_t count)
+{
+	auto s = create_scene(count);
+	const auto f = create_frustum();
+	std::vector<std::uint32_t> bits;
+
+	std::size_t obb_visible = 0;
+	const auto obb_ms = benchmark::measure_ms(runs, [&]() { obb_visible = cull_obbs(s, f); });
+
+	std::size_t aabb_visible = 0;
+	const auto aabb_ms = benchmark::measure_ms(runs, [&]() { aabb_visible = cull_aabbs(s, f, bits); });
+
+	math::aabb_tree tree;
+	std::vector<std::int32_t> proxies(count);
+	const auto build_start = benchmark::clock_t::now();
+	for(std::size_t i = 0; i < count; ++i)
+	{
+		proxies[i] = tree.insert(s.world_bounds[i], std::uint32_t(i));
+	}
+	const auto build_ms = benchmark::elapsed_ms(build_start);
+
+	std::size_t tree_visible = 0;
+	const auto tree_ms = benchmark::measure_ms(runs, [&]() { tree_visible = cull_tree(s, tree, f); });
+
+	// one box in a hundred moves a little, most stay inside their fat boxes
+	std::size_t frame = 0;
+	const auto update_ms = benchmark::measure_ms(runs, [&]() {
+		const float offset = (frame++ % 2 == 0) ? 0.05f : -0.05f;
+		for(std::size_t i = frame % 100; i < count; i += 100)
+		{
+			auto& t = s.transforms[i];
+			t.set_position(t.get_position() + math::vec3(offset, 0.0f, 0.0f));
+			s.world_bounds[i] = math::bbox::mul(s.local_bounds, t);
+			tree.update(proxies[i], s.world_bounds[i]);
+		}
+	});
+
+	std::printf("%-10zu %10.3f %10.3f %10.3f %10.3f %10.3f %10zu %10zu %10zu\n", count, obb_ms, aabb_ms,
+				tree_ms, build_ms, update_ms, obb_visible, aabb_visible, tree_visible);
+}
+}
+
+int main()
+{
+	std::printf("frustum culling, ms per frame\n");
+	std::printf("%-10s %10s %10s %10s %10s %10s %10s %10s %10s\n", "boxes", "obb", "aabbs", "tree",
+				"tree build", "1% update", "obb vis", "aabbs vis", "tree vis");
+
+	run(100000);
+	run(1000000);
+	return 0;
+}
@@ -0,0 +1,69 @@
+#include "benchmark.h"
+#include "core/math/math_includes.h"
+#include "core/system/subsystem.h"
+#include "core/system/task_system.h"
+#include "runtime/rendering/light_clusters.h"
+#include <random>
+#include <thread>
+
+// Bins growing numbers of point lights into the default 16x8x24 cluster
+// grid on the CPU, once on the calling thread and once with the depth
+// slices spread over the task system, and prints the build counters.
+namespace
+{
+const std::size_t runs = 10;
+const float near_clip = 0.1f;
+const float far_clip = 500.0f;
+
+// Lights scattered around the camera, most of them in front of it.
+std::vector<math::vec4> create_lights(std::size_t count)
+{
+	std::mt19937 rng(3);
+	std::uniform_real_distribution<float> side(-200.0f, 200.0f);
+	std::uniform_real_distribution<float> depth(-50.0f, far_clip);
+	std::uniform_real_distribution<float> radius(1.0f, 20.0f);
+
+	std::vector<math::vec4> spheres(count);
+	for(auto& sphere : spheres)
+	{
+		sphere = math::vec4(side(rng), side(rng) * 0.25f, depth(rng), radius(rng));
+	}
+	return spheres;
+}
+}
+
+int main()
+{
+	core::details::initialize();
+
+	const auto workers = std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+	core::task_system ts(workers, core::task_system::scheduling_mode::work_stealing);
+
+	math::transform view;
+	view.look_at(math::vec3(0.0f, 0.0f, 0.0f), math::vec3(0.0f, 0.0f, 1.0f));
+	math::transform proj = math::perspective(math::radians(60.0f), 16.0f / 9.0f, near_clip, far_clip, false);
+
+	light_clusters clusters;
+	std::printf("light_clusters::build, %ux%ux%u clusters, %zu workers\n", clusters.get_size_x(),
+				clusters.get_size_y(), clusters.get_size_z(), workers);
+	std::printf("%-8s %10s %10s %10s %10s %12s %12s\n", "lights", "visible", "indices", "max/cell",
+				"serial ms", "tasks ms", "speedup");
+
+	for(std::size_t count : {64, 256, 1024, 4096, 16384})
+	{
+		const auto spheres = create_lights(count);
+
+		const auto serial_ms = benchmark::measure_ms(
+			runs, [&]() { clusters.build(view, proj, near_clip, far_clip, spheres); });
+		const auto tasks_ms = benchmark::measure_ms(
+			runs, [&]() { clusters.build(view, proj, near_clip, far_clip, spheres, &ts); });
+
+		const auto& stats = clusters.get_stats();
+		std::printf("%-8zu %10u %10u %10u %10.3f %12.3f %12.2f\n", count, stats.visible_lights, stats.indices,
+					stats.max_cluster_lights, serial_ms, tasks_ms, serial_ms / tasks_ms);
+	}
+
+	ts.dispose();
+	core::details::dispose();
+	return 0;
+}
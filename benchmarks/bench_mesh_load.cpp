@@ -0,0 +1,153 @@
+#include "benchmark.h"
+#include "core/filesystem/memory_stream.h"
+#include "core/graphics/graphics.h"
+#include "core/serialization/binary_archive.h"
+#include "runtime/meta/rendering/mesh.hpp"
+#include "runtime/rendering/mesh.h"
+#include <cstring>
+#include <sstream>
+
+// Loads large grid meshes from memory the two ways the asset reader can: the
+// cereal serialized load_data of assets compiled before the blob format,
+// followed by the full mesh preparation, and the compiled blob. Only the
+// CPU side is timed, the renderer buffers are built afterwards on the main
+// thread by both.
+namespace
+{
+const std::size_t runs = 3;
+
+mesh::load_data create_grid(std::uint32_t size)
+{
+	mesh::load_data data;
+	data.vertex_format = gfx::mesh_vertex::decl;
+
+	const auto stride = data.vertex_format.getStride();
+	const auto position_offset = data.vertex_format.getOffset(gfx::Attrib::Position);
+	data.vertex_count = (size + 1) * (size + 1);
+	data.vertex_data.resize(std::size_t(data.vertex_count) * stride);
+	for(std::uint32_t z = 0; z <= size; ++z)
+	{
+		for(std::uint32_t x = 0; x <= size; ++x)
+		{
+			const float position[3] = {float(x), 0.0f, float(z)};
+			const auto vertex = std::size_t(z * (size + 1) + x) * stride;
+			std::memcpy(&data.vertex_data[vertex + position_offset], position, sizeof(position));
+		}
+	}
+
+	// two triangles per cell, split into four subsets by rows
+	data.material_count = 4;
+	data.triangle_count = size * size * 2;
+	data.triangle_data.reserve(data.triangle_count);
+	for(std::uint32_t z = 0; z < size; ++z)
+	{
+		for(std::uint32_t x = 0; x < size; ++x)
+		{
+			const auto corner = z * (size + 1) + x;
+			mesh::triangle t;
+			t.data_group_id = z * data.material_count / size;
+			t.indices[0] = corner;
+			t.indices[1] = corner + size + 1;
+			t.indices[2] = corner + 1;
+			data.triangle_data.push_back(t);
+			t.indices[0] = corner + 1;
+			t.indices[1] = corner + size + 1;
+			t.indices[2] = corner + size + 2;
+			data.triangle_data.push_back(t);
+		}
+	}
+	return data;
+}
+
+bool prepare(mesh& m, mesh::load_data& data, bool hardware_copy)
+{
+	m.prepare_mesh(data.vertex_format);
+	m.set_vertex_source(&data.vertex_data[0], data.vertex_count, data.vertex_format);
+	m.add_primitives(data.triangle_data);
+	m.set_subset_count(data.material_count);
+	m.bind_skin(data.skin_data);
+	m.bind_armature(data.root_node);
+	return m.end_prepare(hardware_copy, false, false, false);
+}
+
+// The legacy path of the asset reader.
+bool load_serialized(const fs::byte_array_t& bytes)
+{
+	// the copy stands in for the read buffer the reader hands over
+	auto copy = bytes;
+	mesh::load_data data;
+	{
+		fs::memory_stream stream(std::move(copy));
+		cereal::iarchive_binary_t ar(stream);
+
+		try_load(ar, cereal::make_nvp("mesh", data));
+	}
+	mesh m;
+	return prepare(m, data, true);
+}
+
+bool load_blob(const fs::byte_array_t& bytes)
+{
+	const auto blob = reinterpret_cast<const std::uint8_t*>(bytes.data());
+	if(!mesh::is_blob(blob, bytes.size()))
+		return false;
+
+	mesh m;
+	return m.read_blob(blob, bytes.size());
+}
+
+void run(std::uint32_t size)
+{
+	auto data = create_grid(size);
+
+	fs::byte_array_t serialized;
+	{
+		std::ostringstream stream;
+		{
+			cereal::oarchive_binary_t ar(stream);
+			try_save(ar, cereal::make_nvp("mesh", data));
+		}
+		const auto str = stream.str();
+		serialized.assign(str.begin(), str.end());
+	}
+
+	fs::byte_array_t blob;
+	{
+		// the asset compiler prepares the mesh before writing the blob
+		auto compiled_data = create_grid(size);
+		mesh compiled;
+		prepare(compiled, compiled_data, false);
+
+		std::vector<std::uint8_t> bytes;
+		compiled.write_blob(bytes);
+		blob.assign(bytes.begin(), bytes.end());
+	}
+
+	bool serialized_result = false;
+	const auto serialized_ms =
+		benchmark::measure_ms(runs, [&]() { serialized_result = load_serialized(serialized); });
+
+	bool blob_result = false;
+	const auto blob_ms = benchmark::measure_ms(runs, [&]() { blob_result = load_blob(blob); });
+
+	std::printf("%-10u %10u %12.2f %12.2f %12.3f %12.3f %8.1f%s\n", data.vertex_count, data.triangle_count,
+				double(serialized.size()) / (1024.0 * 1024.0), double(blob.size()) / (1024.0 * 1024.0),
+				serialized_ms, blob_ms, serialized_ms / blob_ms,
+				serialized_result && blob_result ? "" : " (failed)");
+}
+}
+
+int main()
+{
+	// the vertex declarations are set up by gfx::init, no renderer is needed
+	gfx::mesh_vertex::init();
+
+	std::printf("mesh load from memory, CPU only\n");
+	std::printf("%-10s %10s %12s %12s %12s %12s %8s\n", "vertices", "triangles", "cereal MB", "blob MB",
+				"cereal ms", "blob ms", "speedup");
+
+	run(128);
+	run(512);
+	run(1024);
+	return 0;
+}
@@ -0,0 +1,111 @@
+#include "benchmark.h"
+#include "core/math/math_includes.h"
+#include "core/system/subsystem.h"
+#include "core/system/task_system.h"
+#include <thread>
+
+// Runs a transform update like the scene graph one, world = parent * local
+// for a flat array of nodes, through task_system::parallel_for with 1, 2,
+// 4, 8 and as many threads as the hardware has. A bounds merge through
+// parallel_reduce runs next to it.
+namespace
+{
+const std::size_t node_count = 200000;
+const std::size_t runs = 10;
+
+struct node_data
+{
+	std::vector<math::transform> parents;
+	std::vector<math::transform> locals;
+	std::vector<math::transform> worlds;
+};
+
+node_data create_nodes()
+{
+	node_data nodes;
+	nodes.parents.resize(node_count / 8);
+	nodes.locals.resize(node_count);
+	nodes.worlds.resize(node_count);
+
+	// every eight nodes share a parent, resolved beforehand
+	for(std::size_t i = 0; i < node_count; ++i)
+	{
+		auto& local = nodes.locals[i];
+		local.set_position(math::vec3(float(i % 97), float(i % 13), float(i % 31)));
+		local.set_rotation(math::angleAxis(float(i % 360) * 0.0174533f, math::vec3(0.0f, 1.0f, 0.0f)));
+	}
+	for(std::size_t i = 0; i < nodes.parents.size(); ++i)
+	{
+		nodes.parents[i].set_position(math::vec3(float(i % 7), 0.0f, float(i % 11)));
+	}
+	return nodes;
+}
+
+void update_range(node_data& nodes, std::size_t begin, std::size_t end)
+{
+	for(std::size_t i = begin; i < end; ++i)
+	{
+		nodes.worlds[i] = nodes.parents[i / 8] * nodes.locals[i];
+	}
+}
+
+math::bbox merge_bounds(const node_data& nodes, std::size_t begin, std::size_t end)
+{
+	math::bbox bounds;
+	bounds.reset();
+	for(std::size_t i = begin; i < end; ++i)
+	{
+		bounds.add_point(nodes.worlds[i].get_position());
+	}
+	return bounds;
+}
+}
+
+int main()
+{
+	core::details::initialize();
+
+	auto nodes = create_nodes();
+	const auto hardware_threads = std::size_t(std::thread::hardware_concurrency());
+
+	std::printf("parallel_for, %zu nodes\n", node_count);
+	std::printf("%-8s %14s %14s %14s %10s\n", "threads", "serial ms", "for ms", "reduce ms", "speedup");
+
+	const std::size_t grain = 1024;
+	const auto serial_ms = benchmark::measure_ms(runs, [&]() { update_range(nodes, 0, node_count); });
+
+	for(auto threads : benchmark::get_thread_counts(hardware_threads))
+	{
+		// the calling thread works too
+		core::task_system ts(threads - 1, core::task_system::scheduling_mode::work_stealing);
+
+		const auto for_ms = benchmark::measure_ms(runs, [&]() {
+			ts.parallel_for(0, node_count, grain, [&nodes](std::size_t begin, std::size_t end) {
+				update_range(nodes, begin, end);
+			});
+		});
+
+		math::bbox bounds;
+		const auto reduce_ms = benchmark::measure_ms(runs, [&]() {
+			math::bbox empty;
+			empty.reset();
+			bounds = ts.parallel_reduce(
+				0, node_count, grain, empty,
+				[&nodes](std::size_t begin, std::size_t end) { return merge_bounds(nodes, begin, end); },
+				[](math::bbox lhs, const math::bbox& rhs) {
+					lhs.add_point(rhs.min);
+					lhs.add_point(rhs.max);
+					return lhs;
+				});
+		});
+		benchmark::keep(bounds.max.x);
+
+		std::printf("%-8zu %14.3f %14.3f %14.3f %10.2f\n", threads, serial_ms, for_ms, reduce_ms,
+					serial_ms / for_ms);
+
+		ts.dispose();
+	}
+
+	core::details::dispose();
+	return 0;
+}
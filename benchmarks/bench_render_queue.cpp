@@ -0,0 +1,168 @@
+#include "benchmark.h"
+#include "core/graphics/graphics.h"
+#include "runtime/rendering/mesh.h"
+#include "runtime/rendering/program.h"
+#include "runtime/rendering/render_queue.h"
+#include "runtime/rendering/shader.h"
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <random>
+
+// Drives render_queue::flush on the Noop renderer of bgfx and reports what
+// render_queue_stats counts next to the CPU cost of recording, sorting and
+// submitting a frame of draws. Materials need the asset manager, so items
+// carry none and only sort by program and mesh.
+namespace
+{
+const std::size_t item_count = 10000;
+const std::size_t mesh_count = 64;
+const std::size_t program_count = 4;
+const std::size_t recorder_count = 4;
+const std::size_t frames = 50;
+
+asset_handle<shader> load_shader(const std::string& name)
+{
+	const auto path = std::string(ENGINE_DIRECTORY) + "/engine_data/shaders/" + name + ".sc.gl.asset";
+	std::ifstream file(path, std::ios::binary);
+	std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	asset_handle<shader> result;
+	if(bytes.empty())
+	{
+		std::printf("failed to read %s\n", path.c_str());
+		return result;
+	}
+
+	auto shdr = std::make_shared<shader>();
+	shdr->populate(gfx::copy(bytes.data(), static_cast<std::uint32_t>(bytes.size())));
+	result = shdr;
+	return result;
+}
+
+struct frame_data
+{
+	std::vector<draw_item> items;
+	std::vector<math::transform> transforms;
+};
+
+// Items in the order a scene walk would record them, unrelated to their
+// programs and meshes.
+frame_data create_frame(const std::vector<std::unique_ptr<program>>& programs, program* instanced_prog,
+						const std::vector<std::unique_ptr<mesh>>& meshes)
+{
+	std::mt19937 rng(11);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	frame_data frame;
+	frame.items.resize(item_count);
+	frame.transforms.resize(item_count);
+	for(std::size_t i = 0; i < item_count; ++i)
+	{
+		auto& item = frame.items[i];
+		item.prog = programs[rng() % programs.size()].get();
+		item.instanced_prog = instanced_prog;
+		item.msh = meshes[rng() % meshes.size()].get();
+		item.states = BGFX_STATE_DEFAULT;
+		item.key = render_queue::make_sort_key(0, item.prog, item.mat, item.msh, item.group_id, unit(rng));
+
+		frame.transforms[i].set_position(math::vec3(unit(rng), unit(rng), unit(rng)) * 100.0f);
+	}
+	return frame;
+}
+
+void run(const char* name, render_queue& queue, const frame_data& frame)
+{
+	render_queue_stats stats;
+	double record_ms = 0.0;
+	double flush_ms = 0.0;
+	double gfx_frame_ms = 0.0;
+
+	for(std::size_t f = 0; f < frames; ++f)
+	{
+		// recorders like the ones of several visibility tasks
+		const auto record_start = benchmark::clock_t::now();
+		for(std::size_t r = 0; r < recorder_count; ++r)
+		{
+			render_queue::recorder recorder(queue);
+			for(std::size_t i = r; i < frame.items.size(); i += recorder_count)
+			{
+				recorder.add(frame.items[i], &frame.transforms[i], 1);
+			}
+		}
+		record_ms += benchmark::elapsed_ms(record_start);
+
+		const auto flush_start = benchmark::clock_t::now();
+		stats += queue.flush(0, [](program&) {}, [](program&, const draw_item&) {});
+		flush_ms += benchmark::elapsed_ms(flush_start);
+
+		const auto gfx_frame_start = benchmark::clock_t::now();
+		gfx::frame();
+		gfx_frame_ms += benchmark::elapsed_ms(gfx_frame_start);
+	}
+
+	const auto ms = [](std::chrono::duration<float> d) {
+		return std::chrono::duration<double, std::milli>(d).count() / double(frames);
+	};
+	std::printf("%-14s %8zu %8zu %8zu %8zu %8zu %8zu %9.3f %9.3f %9.3f %9.3f %9.3f\n", name, stats.items / frames,
+				stats.program_changes / frames, stats.mesh_changes / frames,
+				stats.unsorted_state_changes / frames, stats.instanced_draws / frames,
+				stats.instances / frames, record_ms / frames, ms(stats.sort_time), ms(stats.submit_time),
+				flush_ms / frames, gfx_frame_ms / frames);
+}
+}
+
+int main()
+{
+	if(!gfx::init(gfx::RendererType::Noop))
+	{
+		std::printf("failed to initialize the Noop renderer\n");
+		return 1;
+	}
+	gfx::reset(1280, 720, BGFX_RESET_NONE);
+	gfx::setViewRect(0, 0, 0, 1280, 720);
+
+	{
+		// bgfx hands out one program handle per pair of shaders, so every
+		// program needs a pair of its own. The Noop renderer draws nothing,
+		// any pair will do.
+		const std::pair<const char*, const char*> pairs[program_count] = {
+			{"vs_deferred_geom", "fs_deferred_geom"},
+			{"vs_deferred_geom_skinned", "fs_deferred_geom"},
+			{"vs_clip_quad", "fs_gamma_correction"},
+			{"vs_clip_quad_ex", "fs_atmospherics"}};
+
+		std::vector<std::unique_ptr<program>> programs;
+		for(const auto& pair : pairs)
+		{
+			auto vs = load_shader(pair.first);
+			auto fs = load_shader(pair.second);
+			programs.emplace_back(std::make_unique<program>(vs, fs));
+		}
+		auto instanced_prog = std::make_unique<program>(load_shader("vs_deferred_geom_instanced"),
+														load_shader("fs_deferred_geom"));
+
+		std::vector<std::unique_ptr<mesh>> meshes;
+		for(std::size_t i = 0; i < mesh_count; ++i)
+		{
+			meshes.emplace_back(std::make_unique<mesh>());
+			meshes.back()->create_cube(gfx::mesh_vertex::decl, 1.0f, 1.0f, 1.0f, 1, 1, 1, false,
+									   mesh_create_origin::center);
+		}
+
+		render_queue queue;
+		std::printf("render_queue::flush on the Noop renderer, %zu items, %zu programs, %zu meshes, "
+					"average per frame\n",
+					item_count, program_count, mesh_count);
+		std::printf("%-14s %8s %8s %8s %8s %8s %8s %9s %9s %9s %9s %9s\n", "draws", "items", "programs",
+					"meshes", "unsorted", "inst", "instances", "record ms", "sort ms", "submit ms",
+					"flush ms", "frame ms");
+
+		run("one by one", queue, create_frame(programs, nullptr, meshes));
+		run("instanced", queue, create_frame(programs, instanced_prog.get(), meshes));
+	}
+
+	gfx::shutdown();
+	return 0;
+}
@@ -0,0 +1,181 @@
+#include "benchmark.h"
+#include "core/system/simulation.h"
+#include "core/system/subsystem.h"
+#include "core/system/task_system.h"
+#include "runtime/ecs/components/transform_component.h"
+#include "runtime/ecs/ecs.h"
+#include "runtime/ecs/systems/scene_graph.h"
+#include <string>
+#include <thread>
+
+// Measures scene_graph::frame_update on deep chains, one wide flat
+// hierarchy and many parentless transforms: the first update after
+// building the scene, updates with nothing changed, with a few transforms
+// moved and after a reparent.
+namespace
+{
+using transform_handle = std::shared_ptr<transform_component>;
+
+const std::size_t node_count = 100000;
+const std::size_t runs = 20;
+const std::chrono::duration<float> frame_time(1.0f / 60.0f);
+
+struct scene
+{
+	std::string name;
+	std::vector<transform_handle> nodes;
+	std::vector<transform_handle> roots;
+};
+
+transform_handle create_node(runtime::entity_component_system& ecs, const transform_handle& parent)
+{
+	auto e = ecs.create();
+	auto node = e.assign<transform_component>().lock();
+	node->set_local_position(math::vec3(1.0f, 0.0f, 0.0f));
+	if(parent)
+		node->set_parent(parent->handle(), false, true);
+	return node;
+}
+
+scene create_chains(runtime::entity_component_system& ecs, std::size_t depth)
+{
+	scene s;
+	s.name = "chains of " + std::to_string(depth);
+	while(s.nodes.size() < node_count)
+	{
+		transform_handle parent;
+		for(std::size_t i = 0; i < depth && s.nodes.size() < node_count; ++i)
+		{
+			parent = create_node(ecs, parent);
+			s.nodes.push_back(parent);
+			if(i == 0)
+				s.roots.push_back(parent);
+		}
+	}
+	return s;
+}
+
+scene create_wide(runtime::entity_component_system& ecs)
+{
+	scene s;
+	s.name = "one wide root";
+	auto root = create_node(ecs, nullptr);
+	s.roots.push_back(root);
+	s.nodes.push_back(root);
+	while(s.nodes.size() < node_count)
+	{
+		s.nodes.push_back(create_node(ecs, root));
+	}
+	return s;
+}
+
+scene create_flat(runtime::entity_component_system& ecs)
+{
+	scene s;
+	s.name = "parentless";
+	while(s.nodes.size() < node_count)
+	{
+		s.nodes.push_back(create_node(ecs, nullptr));
+		s.roots.push_back(s.nodes.back());
+	}
+	return s;
+}
+
+double update(core::simulation& sim, runtime::scene_graph& sg)
+{
+	sim.run_one_frame();
+	const auto start = benchmark::clock_t::now();
+	sg.frame_update(frame_time);
+	return benchmark::elapsed_ms(start);
+}
+
+void run(const scene& s, core::simulation& sim, runtime::scene_graph& sg)
+{
+	const auto first_ms = update(sim, sg);
+
+	double static_ms = 0.0;
+	for(std::size_t i = 0; i < runs; ++i)
+	{
+		static_ms += update(sim, sg);
+	}
+
+	// one node in a hundred moves every frame, through its local transform
+	// like animation does
+	double moved_ms = 0.0;
+	std::size_t resolved = 0;
+	for(std::size_t i = 0; i < runs; ++i)
+	{
+		const math::vec3 position(1.0f, 0.01f * float(i + 1), 0.0f);
+		for(std::size_t n = i % 100; n < s.nodes.size(); n += 100)
+		{
+			s.nodes[n]->set_local_position(position);
+		}
+		moved_ms += update(sim, sg);
+		resolved += sg.get_resolved().size();
+	}
+
+	// the last node changes parents every frame, the hierarchy is flattened
+	// again
+	double reparent_ms = 0.0;
+	for(std::size_t i = 0; i < runs; ++i)
+	{
+		s.nodes.back()->set_parent(s.nodes[i + 1]->handle(), false, true);
+		reparent_ms += update(sim, sg);
+	}
+
+	std::printf("%-16s %12.3f %12.3f %12.3f %12zu %12.3f\n", s.name.c_str(), first_ms, static_ms / runs,
+				moved_ms / runs, resolved / runs, reparent_ms / runs);
+}
+
+void destroy(scene& s)
+{
+	std::vector<runtime::entity> roots;
+	for(auto& root : s.roots)
+	{
+		roots.push_back(root->get_entity());
+	}
+
+	// the components go with their entities once nothing else holds them,
+	// roots that were reparented go with their new hierarchy
+	s.roots.clear();
+	s.nodes.clear();
+	for(auto& e : roots)
+	{
+		if(e.valid())
+			e.destroy();
+	}
+}
+}
+
+int main()
+{
+	core::details::initialize();
+	auto& sim = core::add_subsystem<core::simulation>();
+	core::add_subsystem<core::task_system>(std::thread::hardware_concurrency(),
+										   core::task_system::scheduling_mode::work_stealing);
+	auto& ecs = core::add_subsystem<runtime::entity_component_system>();
+	auto& sg = core::add_subsystem<runtime::scene_graph>();
+
+	std::printf("scene_graph::frame_update, %zu transforms\n", node_count);
+	std::printf("%-16s %12s %12s %12s %12s %12s\n", "hierarchy", "first ms", "static ms", "moved ms",
+				"resolved", "reparent ms");
+
+	auto deep = create_chains(ecs, 1000);
+	run(deep, sim, sg);
+	destroy(deep);
+
+	auto shallow = create_chains(ecs, 10);
+	run(shallow, sim, sg);
+	destroy(shallow);
+
+	auto wide = create_wide(ecs);
+	run(wide, sim, sg);
+	destroy(wide);
+
+	auto flat = create_flat(ecs);
+	run(flat, sim, sg);
+	destroy(flat);
+
+	core::details::dispose();
+	return 0;
+}
@@ -0,0 +1,136 @@
+#include "benchmark.h"
+#include "core/system/subsystem.h"
+#include <memory>
+#include <unordered_map>
+
+// Measures the cost of one get_subsystem call: the sequential slots of
+// core::subsystem_context against the hash map keyed by the type hash that
+// was used before, with as many subsystems registered as the engine has.
+namespace
+{
+const std::size_t lookups = 10000000;
+const std::size_t runs = 5;
+
+template <int N>
+struct dummy_subsystem : core::subsystem
+{
+	int value = N;
+};
+
+//-----------------------------------------------------------------------------
+//  Name : hashed_context (Struct)
+/// <summary>
+/// The former subsystem_context lookup. Subsystems are found by the hash of
+/// their type, get searches the map once to check the subsystem exists and
+/// once more to return it.
+/// </summary>
+//-----------------------------------------------------------------------------
+struct hashed_context
+{
+	template <typename S>
+	S& add_subsystem()
+	{
+		const auto index = rtti::type_id<S>().hash_code();
+		_subsystems.emplace(std::make_pair(index, std::make_unique<S>()));
+		return static_cast<S&>(*_subsystems[index].get());
+	}
+
+	template <typename S>
+	S& get_subsystem()
+	{
+		expects(has_subsystems<S>() && "failed to find system");
+		const auto index = rtti::type_id<S>().hash_code();
+		return static_cast<S&>(*_subsystems[index].get());
+	}
+
+	template <typename S>
+	bool has_subsystems() const
+	{
+		const auto index = rtti::type_id<S>().hash_code();
+		return _subsystems.find(index) != _subsystems.end();
+	}
+
+	std::unordered_map<std::size_t, std::unique_ptr<core::subsystem>> _subsystems;
+};
+
+template <typename Context>
+void add_all(Context& context)
+{
+	context.template add_subsystem<dummy_subsystem<0>>();
+	context.template add_subsystem<dummy_subsystem<1>>();
+	context.template add_subsystem<dummy_subsystem<2>>();
+	context.template add_subsystem<dummy_subsystem<3>>();
+	context.template add_subsystem<dummy_subsystem<4>>();
+	context.template add_subsystem<dummy_subsystem<5>>();
+	context.template add_subsystem<dummy_subsystem<6>>();
+	context.template add_subsystem<dummy_subsystem<7>>();
+}
+
+// eight lookups of different subsystems, like a frame of systems asking for
+// their dependencies
+template <typename Context>
+int get_all(Context& context)
+{
+	return context.template get_subsystem<dummy_subsystem<0>>().value +
+		   context.template get_subsystem<dummy_subsystem<1>>().value +
+		   context.template get_subsystem<dummy_subsystem<2>>().value +
+		   context.template get_subsystem<dummy_subsystem<3>>().value +
+		   context.template get_subsystem<dummy_subsystem<4>>().value +
+		   context.template get_subsystem<dummy_subsystem<5>>().value +
+		   context.template get_subsystem<dummy_subsystem<6>>().value +
+		   context.template get_subsystem<dummy_subsystem<7>>().value;
+}
+
+// the global core::get_subsystem the engine calls
+struct global_context
+{
+	template <typename S>
+	S& add_subsystem()
+	{
+		return core::add_subsystem<S>();
+	}
+
+	template <typename S>
+	S& get_subsystem()
+	{
+		return core::get_subsystem<S>();
+	}
+};
+
+template <typename Context>
+double measure_ns(Context& context)
+{
+	int sum = 0;
+	const auto ms = benchmark::measure_ms(runs, [&]() {
+		for(std::size_t i = 0; i < lookups / 8; ++i)
+		{
+			sum += get_all(context);
+		}
+	});
+	benchmark::keep(sum);
+	return ms * 1000000.0 / double(lookups);
+}
+}
+
+int main()
+{
+	core::details::initialize();
+
+	hashed_context hashed;
+	add_all(hashed);
+
+	core::subsystem_context slots;
+	add_all(slots);
+
+	global_context global;
+	add_all(global);
+
+	std::printf("get_subsystem, %zu lookups over 8 subsystems\n", lookups);
+	std::printf("%-32s %12s\n", "lookup", "ns per call");
+	std::printf("%-32s %12.3f\n", "hash map (before)", measure_ns(hashed));
+	std::printf("%-32s %12.3f\n", "sequential slots", measure_ns(slots));
+	std::printf("%-32s %12.3f\n", "core::get_subsystem", measure_ns(global));
+
+	core::details::dispose();
+	return 0;
+}
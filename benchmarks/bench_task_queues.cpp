@@ -0,0 +1,121 @@
+#include "benchmark.h"
+#include "core/system/subsystem.h"
+#include "core/system/task_system.h"
+#include <atomic>
+#include <thread>
+
+// Compares the locked per thread queues with the work-stealing deques of
+// core::task_system: throughput of pushes from the main thread, of tasks
+// spawning more tasks on the workers, and the latency from a push to the
+// start of the task.
+namespace
+{
+using scheduling_mode = core::task_system::scheduling_mode;
+
+const std::size_t main_pushes = 200000;
+const std::size_t spawners = 256;
+const std::size_t spawned_per_task = 1000;
+const std::size_t bursts = 400;
+const std::size_t burst_size = 256;
+
+const char* get_mode_name(scheduling_mode mode)
+{
+	return mode == scheduling_mode::work_stealing ? "work_stealing" : "shared_queues";
+}
+
+void wait_for_count(const std::atomic<std::size_t>& counter, std::size_t count)
+{
+	while(counter.load(std::memory_order_acquire) < count)
+	{
+		std::this_thread::yield();
+	}
+}
+
+double push_from_main(core::task_system& ts)
+{
+	std::atomic<std::size_t> done{0};
+	const auto ms = benchmark::measure_ms(3, [&]() {
+		done = 0;
+		for(std::size_t i = 0; i < main_pushes; ++i)
+		{
+			ts.push_ready([&done]() { done.fetch_add(1, std::memory_order_release); });
+		}
+		wait_for_count(done, main_pushes);
+	});
+	return double(main_pushes) / ms;
+}
+
+double push_from_workers(core::task_system& ts)
+{
+	const auto total = spawners * spawned_per_task;
+	std::atomic<std::size_t> done{0};
+	const auto ms = benchmark::measure_ms(3, [&]() {
+		done = 0;
+		for(std::size_t i = 0; i < spawners; ++i)
+		{
+			ts.push_ready([&ts, &done]() {
+				for(std::size_t n = 0; n < spawned_per_task; ++n)
+				{
+					ts.push_ready([&done]() { done.fetch_add(1, std::memory_order_release); });
+				}
+			});
+		}
+		wait_for_count(done, total);
+	});
+	return double(total) / ms;
+}
+
+benchmark::percentiles push_latency(core::task_system& ts)
+{
+	const auto total = bursts * burst_size;
+	std::vector<benchmark::clock_t::time_point> pushed(total);
+	std::vector<double> latencies(total);
+	std::atomic<std::size_t> done{0};
+
+	// Bursts like the reads of a level load, with a pause for the workers to
+	// go idle in between.
+	for(std::size_t burst = 0; burst < bursts; ++burst)
+	{
+		for(std::size_t n = 0; n < burst_size; ++n)
+		{
+			const auto i = burst * burst_size + n;
+			pushed[i] = benchmark::clock_t::now();
+			ts.push_ready([i, &pushed, &latencies, &done]() {
+				const auto latency = benchmark::clock_t::now() - pushed[i];
+				latencies[i] = std::chrono::duration<double, std::micro>(latency).count();
+				done.fetch_add(1, std::memory_order_release);
+			});
+		}
+		std::this_thread::sleep_for(std::chrono::microseconds(200));
+	}
+	wait_for_count(done, total);
+
+	return benchmark::get_percentiles(latencies);
+}
+}
+
+int main()
+{
+	core::details::initialize();
+
+	const auto workers = std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+	std::printf("task queues, %zu workers\n", workers);
+	std::printf("%-14s %16s %16s %10s %10s %10s %10s\n", "mode", "main tasks/ms", "spawned tasks/ms",
+				"p50 us", "p99 us", "p99.9 us", "max us");
+
+	for(auto mode : {scheduling_mode::shared_queues, scheduling_mode::work_stealing})
+	{
+		core::task_system ts(workers, mode);
+
+		const auto main_rate = push_from_main(ts);
+		const auto spawn_rate = push_from_workers(ts);
+		const auto latency = push_latency(ts);
+		std::printf("%-14s %16.1f %16.1f %10.2f %10.2f %10.2f %10.2f\n", get_mode_name(mode), main_rate,
+					spawn_rate, latency.p50, latency.p99, latency.p999, latency.max);
+
+		ts.dispose();
+	}
+
+	core::details::dispose();
+	return 0;
+}
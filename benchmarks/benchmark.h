@@ -0,0 +1,119 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <vector>
+
+namespace benchmark
+{
+using clock_t = std::chrono::steady_clock;
+
+//-----------------------------------------------------------------------------
+//  Name : elapsed_ms ()
+/// <summary>
+/// Milliseconds since a time point.
+/// </summary>
+//-----------------------------------------------------------------------------
+inline double elapsed_ms(clock_t::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(clock_t::now() - start).count();
+}
+
+//-----------------------------------------------------------------------------
+//  Name : measure_ms ()
+/// <summary>
+/// Runs f once to warm up and then the given number of times, returns the
+/// fastest of the measured runs in milliseconds.
+/// </summary>
+//-----------------------------------------------------------------------------
+template <typename F>
+double measure_ms(std::size_t runs, F&& f)
+{
+	f();
+
+	double best = std::numeric_limits<double>::max();
+	for(std::size_t i = 0; i < runs; ++i)
+	{
+		const auto start = clock_t::now();
+		f();
+		best = std::min(best, elapsed_ms(start));
+	}
+	return best;
+}
+
+//-----------------------------------------------------------------------------
+//  Name : keep ()
+/// <summary>
+/// Keeps the compiler from optimizing away the computation of a value. GCC
+/// and Clang get an empty asm statement that uses it, other compilers a
+/// volatile store that is read back.
+/// </summary>
+//-----------------------------------------------------------------------------
+template <typename T>
+void keep(const T& value)
+{
+#if defined(__GNUC__)
+	asm volatile("" : : "r,m"(value) : "memory");
+#else
+	static volatile T sink;
+	sink = value;
+	static_cast<void>(sink);
+#endif
+}
+
+//-----------------------------------------------------------------------------
+//  Name : percentiles (Struct)
+/// <summary>
+/// Distribution of a set of samples.
+/// </summary>
+//-----------------------------------------------------------------------------
+struct percentiles
+{
+	double p50 = 0.0;
+	double p99 = 0.0;
+	double p999 = 0.0;
+	double max = 0.0;
+};
+
+//-----------------------------------------------------------------------------
+//  Name : get_percentiles ()
+/// <summary>
+/// Sorts the samples and picks the percentiles out of them.
+/// </summary>
+//-----------------------------------------------------------------------------
+inline percentiles get_percentiles(std::vector<double>& samples)
+{
+	percentiles result;
+	if(samples.empty())
+		return result;
+
+	std::sort(samples.begin(), samples.end());
+	auto at = [&samples](double fraction) {
+		const auto index = static_cast<std::size_t>(fraction * double(samples.size() - 1));
+		return samples[index];
+	};
+	result.p50 = at(0.5);
+	result.p99 = at(0.99);
+	result.p999 = at(0.999);
+	result.max = samples.back();
+	return result;
+}
+
+//-----------------------------------------------------------------------------
+//  Name : get_thread_counts ()
+/// <summary>
+/// 1, 2, 4 and 8 threads followed by the hardware thread count when it is
+/// not one of them already.
+/// </summary>
+//-----------------------------------------------------------------------------
+inline std::vector<std::size_t> get_thread_counts(std::size_t hardware_threads)
+{
+	std::vector<std::size_t> counts = {1, 2, 4, 8};
+	if(hardware_threads > 0 && std::find(counts.begin(), counts.end(), hardware_threads) == counts.end())
+		counts.push_back(hardware_threads);
+	return counts;
+}
+}
@@ -238,11 +238,27 @@ void compile<mesh>(const fs::path& absolute_key)
 		return;
 	}
 
+	// Prepare the mesh here so that loading only has to copy the final buffers.
+	mesh compiled;
+	compiled.prepare_mesh(data.vertex_format);
+	compiled.set_vertex_source(&data.vertex_data[0], data.vertex_count, data.vertex_format);
+	compiled.add_primitives(data.triangle_data);
+	compiled.set_subset_count(data.material_count);
+	compiled.bind_skin(data.skin_data);
+	compiled.bind_armature(data.root_node);
+	compiled.end_prepare(false, false, false, false);
+
+	std::vector<std::uint8_t> blob;
+	if(!compiled.write_blob(blob))
+	{
+		APPLOG_ERROR("Failed compilation of {0}", str_input);
+		return;
+	}
+
 	fs::path entry = dir / fs::path(file + ".buildtemp");
 	{
 		std::ofstream soutput(entry.string(), std::ios::out | std::ios::binary);
-		cereal::oarchive_binary_t ar(soutput);
-		try_save(ar, cereal::make_nvp("mesh", data));
+		soutput.write(reinterpret_cast<const char*>(blob.data()), static_cast<std::streamsize>(blob.size()));
 	}
 	fs::error_code err;
 	fs::copy_file(entry, output, fs::copy_option::overwrite_if_exists, err);
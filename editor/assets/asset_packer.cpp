@@ -0,0 +1,134 @@
+#include "asset_packer.h"
+#include "core/filesystem/archive.h"
+#include "core/filesystem/lz4.h"
+#include "core/logging/logging.h"
+#include "runtime/assets/asset_extensions.h"
+#include <algorithm>
+#include <fstream>
+
+namespace asset_packer
+{
+bool pack(const std::string& directory, const fs::path& output, bool compress)
+{
+	const auto pos = directory.find(':');
+	if(pos == std::string::npos)
+	{
+		APPLOG_ERROR("Failed packing {0}, expected a protocol directory", directory);
+		return false;
+	}
+
+	// Names are relative to the protocol root, as fs::read_file looks them up.
+	auto prefix = directory.substr(pos + 1);
+	prefix.erase(0, prefix.find_first_not_of('/'));
+	if(!prefix.empty() && prefix.back() != '/')
+		prefix += '/';
+
+	const auto root = fs::resolve_protocol(directory);
+	const auto root_string = root.generic_string();
+
+	fs::error_code err;
+	std::vector<fs::path> files;
+	for(fs::recursive_directory_iterator it(root, err), end; it != end; it.increment(err))
+	{
+		if(err)
+			break;
+		if(fs::is_regular_file(it->path(), err) &&
+		   extensions::is_compiled_format(it->path().extension().string()))
+			files.push_back(it->path());
+	}
+
+	fs::path temp = output.string() + ".buildtemp";
+	std::ofstream stream(temp.string(), std::ios::out | std::ios::binary);
+	if(!stream.is_open())
+	{
+		APPLOG_ERROR("Failed packing {0}, could not write {1}", directory, temp.string());
+		return false;
+	}
+
+	auto align = [&stream]() {
+		const auto position = static_cast<std::uint64_t>(stream.tellp());
+		const auto padding = (fs::pak::alignment - position % fs::pak::alignment) % fs::pak::alignment;
+		const char zeros[fs::pak::alignment] = {};
+		stream.write(zeros, static_cast<std::streamsize>(padding));
+	};
+
+	fs::pak::header header;
+	stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	std::vector<fs::pak::entry> entries;
+	std::vector<char> names;
+	std::uint64_t original_total = 0;
+	std::uint64_t stored_total = 0;
+	fs::byte_array_t compressed;
+	for(const auto& file : files)
+	{
+		std::ifstream input(file.string(), std::ios::in | std::ios::binary);
+		const auto data = fs::read_stream(input);
+
+		const auto name = prefix + file.generic_string().substr(root_string.size() + 1);
+
+		fs::pak::entry entry;
+		entry.hash = fs::pak::hash_name(name);
+		entry.name_offset = static_cast<std::uint32_t>(names.size());
+		entry.name_size = static_cast<std::uint32_t>(name.size());
+		entry.original_size = data.size();
+		names.insert(names.end(), name.begin(), name.end());
+
+		const char* stored = data.data();
+		entry.size = data.size();
+		if(compress && !data.empty())
+		{
+			compressed.resize(lz4::compress_bound(data.size()));
+			const auto size = lz4::compress(data.data(), data.size(), compressed.data(), compressed.size());
+			if(size > 0 && size < data.size())
+			{
+				stored = compressed.data();
+				entry.size = size;
+				entry.flags |= fs::pak::compressed;
+			}
+		}
+
+		align();
+		entry.offset = static_cast<std::uint64_t>(stream.tellp());
+		stream.write(stored, static_cast<std::streamsize>(entry.size));
+		entries.push_back(entry);
+
+		original_total += entry.original_size;
+		stored_total += entry.size;
+	}
+
+	// Sort by hash and name, the same order lookups binary search in.
+	auto get_name = [&names](const fs::pak::entry& entry) {
+		return std::string(names.data() + entry.name_offset, entry.name_size);
+	};
+	std::sort(entries.begin(), entries.end(), [&](const fs::pak::entry& lhs, const fs::pak::entry& rhs) {
+		return lhs.hash != rhs.hash ? lhs.hash < rhs.hash : get_name(lhs) < get_name(rhs);
+	});
+
+	header.entry_count = static_cast<std::uint32_t>(entries.size());
+	header.names_offset = static_cast<std::uint64_t>(stream.tellp());
+	header.names_size = names.size();
+	stream.write(names.data(), static_cast<std::streamsize>(names.size()));
+	align();
+	header.directory_offset = static_cast<std::uint64_t>(stream.tellp());
+	stream.write(reinterpret_cast<const char*>(entries.data()),
+				 static_cast<std::streamsize>(entries.size() * sizeof(fs::pak::entry)));
+
+	stream.seekp(0);
+	stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	stream.close();
+	if(!stream)
+	{
+		APPLOG_ERROR("Failed packing {0}, could not write {1}", directory, temp.string());
+		fs::remove(temp, err);
+		return false;
+	}
+
+	fs::copy_file(temp, output, fs::copy_option::overwrite_if_exists, err);
+	fs::remove(temp, err);
+
+	APPLOG_INFO("Packed {0} assets of {1} into {2}, {3} bytes stored for {4}", entries.size(), directory,
+				output.string(), stored_total, original_total);
+	return true;
+}
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include "core/filesystem/filesystem.h"
+
+namespace asset_packer
+{
+//-----------------------------------------------------------------------------
+//  Name : pack ()
+/// <summary>
+/// Packs the compiled assets under a protocol directory, e.g. "app:/data",
+/// into an archive that fs::mount_archive can serve the protocol from.
+/// Entries are LZ4 compressed when asked to and when it saves space.
+/// </summary>
+//-----------------------------------------------------------------------------
+bool pack(const std::string& directory, const fs::path& output, bool compress = true);
+};
@@ -70,34 +70,50 @@ void picking_system::frame_render(std::chrono::duration<float>)
 
 		pass.set_view_proj(pick_view, pick_proj);
 
-		ecs.each<transform_component, model_component>([this, &pass, &camera](
-			runtime::entity e, transform_component& transform_comp_ref, model_component& model_comp_ref) {
-			auto& model = model_comp_ref.get_model();
-			if(!model.is_valid())
-				return;
-
-			const auto& world_transform = transform_comp_ref.get_transform();
-
-			auto mesh = model.get_lod(0);
-			if(!mesh)
-				return;
-
-			const auto& frustum = camera.get_frustum();
-			const auto& bounds = mesh->get_bounds();
-
-			// Test the bounding box of the mesh
-			if(!math::frustum::test_obb(frustum, bounds, world_transform))
-				return;
+		struct candidate
+		{
+			runtime::entity e;
+			const math::transform* world_transform;
+			const model* mdl;
+		};
+		std::vector<candidate> candidates;
+		std::vector<math::bbox> world_bounds;
+
+		ecs.each<transform_component, model_component>(
+			[&candidates, &world_bounds](runtime::entity e, transform_component& transform_comp_ref,
+										 model_component& model_comp_ref) {
+				const auto& model = model_comp_ref.get_model();
+				if(!model.is_valid())
+					return;
+
+				auto mesh = model.get_lod(0);
+				if(!mesh)
+					return;
+
+				const auto& world_transform = transform_comp_ref.get_transform();
+				candidates.push_back({e, &world_transform, &model});
+				world_bounds.push_back(math::bbox::mul(mesh->get_bounds(), world_transform));
+			});
+
+		// Test the world bounding boxes of the meshes in one batch
+		std::vector<std::uint32_t> visible((candidates.size() + 31) / 32);
+		frustum.test_aabbs(world_bounds.data(), world_bounds.size(), visible.data());
+
+		for(std::size_t i = 0; i < candidates.size(); ++i)
+		{
+			if(!(visible[i / 32] & (1u << (i % 32))))
+				continue;
 
-			auto entity_index = e.id().index();
+			const auto& c = candidates[i];
+			auto entity_index = c.e.id().index();
 			std::uint32_t rr = (entity_index)&0xff;
 			std::uint32_t gg = (entity_index >> 8) & 0xff;
 			std::uint32_t bb = (entity_index >> 16) & 0xff;
 			math::vec4 color_id = {rr / 255.0f, gg / 255.0f, bb / 255.0f, 1.0f};
 
-			model.render(pass.id, world_transform, true, true, true, 0, 0, _program.get(),
-						 [&color_id](program& p) { p.set_uniform("u_id", &color_id); });
-		});
+			c.mdl->render(pass.id, *c.world_transform, true, true, true, 0, 0, _program.get(),
+						  [&color_id](program& p) { p.set_uniform("u_id", &color_id); });
+		}
 	}
 
 	// If the user previously clicked, and we're done reading data from GPU, look at ID buffer on CPU
@@ -1,4 +1,5 @@
 #include "editor_window.h"
+#include "../assets/asset_packer.h"
 #include "../editing/editing_system.h"
 #include "core/filesystem/filesystem.h"
 #include "core/logging/logging.h"
@@ -263,6 +264,11 @@ void main_editor_window::on_menubar()
 				save_scene_as();
 			}
 
+			if(gui::MenuItem("Pack Assets", nullptr, false, current_project != ""))
+			{
+				asset_packer::pack("app:/data", fs::resolve_protocol("app:/data.pak"));
+			}
+
 			gui::EndMenu();
 		}
 		if(gui::BeginMenu("Edit"))
@@ -1,6 +1,7 @@
 #ifndef _NONSTD_TYPE_TRAITS_
 #define _NONSTD_TYPE_TRAITS_
 
+#include <atomic>
 #include <cstddef>
 #include <future>
 #include <type_traits>
@@ -40,6 +41,14 @@ static bool check_all_true(bool arg1, BoolArgs... args)
 	return arg1 & check_all_true(args...);
 }
 
+template <typename... Ts>
+struct make_void
+{
+	typedef void type;
+};
+template <typename... Ts>
+using void_t = typename make_void<Ts...>::type;
+
 template <bool...>
 struct bool_pack;
 template <bool... v>
@@ -65,12 +74,13 @@ protected:
 	template <typename Base>
 	struct counter
 	{
-		static index_t value;
+		/// first uses of different types may happen on different threads
+		static std::atomic<index_t> value;
 	};
 };
 
 template <typename B>
-type_index_sequential_t::index_t type_index_sequential_t::counter<B>::value = 0;
+std::atomic<type_index_sequential_t::index_t> type_index_sequential_t::counter<B>::value{0};
 }
 
 ///////////////////////////////////////////////////////
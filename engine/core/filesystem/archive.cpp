@@ -0,0 +1,216 @@
+#include "archive.h"
+#include "../common/platform_config.h"
+#include "../common/string.h"
+#include "lz4.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <unordered_map>
+
+#if $on($windows)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace fs
+{
+namespace
+{
+struct mounted_archives
+{
+	std::mutex mutex;
+	std::unordered_map<std::string, std::shared_ptr<archive>> archives;
+};
+
+mounted_archives& get_mounted_archives()
+{
+	static mounted_archives mounted;
+	return mounted;
+}
+
+std::shared_ptr<archive> find_archive(const std::string& protocol)
+{
+	auto& mounted = get_mounted_archives();
+	std::lock_guard<std::mutex> lock(mounted.mutex);
+	auto it = mounted.archives.find(protocol);
+	if(it == mounted.archives.end())
+		return nullptr;
+	return it->second;
+}
+
+bool entry_less(const pak::entry& entry, std::uint64_t hash)
+{
+	return entry.hash < hash;
+}
+}
+
+std::uint64_t pak::hash_name(const std::string& name)
+{
+	std::uint64_t hash = 14695981039346656037ull;
+	for(auto c : name)
+	{
+		hash ^= static_cast<std::uint8_t>(c);
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+archive::~archive()
+{
+	close();
+}
+
+bool archive::open(const path& file)
+{
+	close();
+
+#if $on($windows)
+	auto handle = CreateFileW(file.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+							  FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+	if(handle == INVALID_HANDLE_VALUE)
+		return false;
+	_handle = reinterpret_cast<std::intptr_t>(handle);
+#else
+	_handle = ::open(file.string().c_str(), O_RDONLY);
+	if(_handle < 0)
+		return false;
+#endif
+
+	pak::header header;
+	if(!read_at(0, &header, sizeof(header)) || header.magic != pak::magic || header.version != pak::version)
+	{
+		close();
+		return false;
+	}
+
+	_entries.resize(header.entry_count);
+	_names.resize(static_cast<std::size_t>(header.names_size));
+	if(!read_at(header.directory_offset, _entries.data(), _entries.size() * sizeof(pak::entry)) ||
+	   !read_at(header.names_offset, _names.data(), _names.size()))
+	{
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void archive::close()
+{
+	if(_handle != -1)
+	{
+#if $on($windows)
+		CloseHandle(reinterpret_cast<HANDLE>(_handle));
+#else
+		::close(static_cast<int>(_handle));
+#endif
+	}
+	_handle = -1;
+	_entries.clear();
+	_names.clear();
+}
+
+const pak::entry* archive::find(const std::string& name) const
+{
+	const auto hash = pak::hash_name(name);
+	auto it = std::lower_bound(_entries.begin(), _entries.end(), hash, entry_less);
+	for(; it != _entries.end() && it->hash == hash; ++it)
+	{
+		if(it->name_size == name.size() && it->name_offset + std::size_t(it->name_size) <= _names.size() &&
+		   name.compare(0, name.size(), &_names[it->name_offset], it->name_size) == 0)
+			return &*it;
+	}
+	return nullptr;
+}
+
+bool archive::read(const pak::entry& entry, byte_array_t& data) const
+{
+	data.resize(static_cast<std::size_t>(entry.original_size));
+	if((entry.flags & pak::compressed) == 0)
+		return read_at(entry.offset, data.data(), data.size());
+
+	byte_array_t compressed(static_cast<std::size_t>(entry.size));
+	return read_at(entry.offset, compressed.data(), compressed.size()) &&
+		   lz4::decompress(compressed.data(), compressed.size(), data.data(), data.size());
+}
+
+std::string archive::get_name(const pak::entry& entry) const
+{
+	if(entry.name_offset + std::size_t(entry.name_size) > _names.size())
+		return {};
+	return std::string(&_names[entry.name_offset], entry.name_size);
+}
+
+bool archive::read_at(std::uint64_t offset, void* data, std::size_t size) const
+{
+	auto dst = static_cast<char*>(data);
+	while(size > 0)
+	{
+#if $on($windows)
+		OVERLAPPED overlapped = {};
+		overlapped.Offset = static_cast<DWORD>(offset);
+		overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+		const auto chunk = static_cast<DWORD>(std::min<std::size_t>(size, 1u << 30));
+		DWORD read = 0;
+		if(!ReadFile(reinterpret_cast<HANDLE>(_handle), dst, chunk, &read, &overlapped) || read == 0)
+			return false;
+#else
+		const auto read = ::pread(static_cast<int>(_handle), dst, size, static_cast<off_t>(offset));
+		if(read <= 0)
+			return false;
+#endif
+		dst += read;
+		size -= static_cast<std::size_t>(read);
+		offset += static_cast<std::uint64_t>(read);
+	}
+	return true;
+}
+
+bool mount_archive(const std::string& protocol, const path& file)
+{
+	auto mounted_archive = std::make_shared<archive>();
+	if(!mounted_archive->open(file))
+		return false;
+
+	auto& mounted = get_mounted_archives();
+	std::lock_guard<std::mutex> lock(mounted.mutex);
+	mounted.archives[string_utils::to_lower(protocol)] = mounted_archive;
+	return true;
+}
+
+void unmount_archive(const std::string& protocol)
+{
+	auto& mounted = get_mounted_archives();
+	std::lock_guard<std::mutex> lock(mounted.mutex);
+	mounted.archives.erase(string_utils::to_lower(protocol));
+}
+
+bool read_file(const path& file, byte_array_t& data)
+{
+	const auto string_path = file.generic_string();
+	const auto pos = string_path.find(':');
+	if(pos != std::string::npos)
+	{
+		auto mounted_archive = find_archive(string_utils::to_lower(string_path.substr(0, pos + 1)));
+		if(mounted_archive)
+		{
+			auto name = string_path.substr(pos + 1);
+			name.erase(0, name.find_first_not_of('/'));
+
+			const auto entry = mounted_archive->find(name);
+			if(entry)
+				return mounted_archive->read(*entry, data);
+		}
+	}
+
+	std::ifstream stream{resolve_protocol(file).string(), std::ios::in | std::ios::binary};
+	if(!stream.is_open())
+		return false;
+
+	data = read_stream(stream);
+	return true;
+}
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#include "filesystem.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace fs
+{
+//-----------------------------------------------------------------------------
+//  Name : pak (Namespace)
+/// <summary>
+/// Layout of an archive. A header is followed by the entry data, each entry
+/// starting on an alignment boundary, then by the names and the directory.
+/// The directory is sorted by the hash of the names so lookups are a binary
+/// search, names are compared to tell colliding hashes apart.
+/// </summary>
+//-----------------------------------------------------------------------------
+namespace pak
+{
+/// "EPAK" in little endian.
+const std::uint32_t magic = 0x4B415045;
+const std::uint32_t version = 1;
+const std::uint32_t alignment = 16;
+
+enum entry_flags : std::uint32_t
+{
+	/// The data is a LZ4 block.
+	compressed = 0x1
+};
+
+struct header
+{
+	std::uint32_t magic = pak::magic;
+	std::uint32_t version = pak::version;
+	std::uint32_t entry_count = 0;
+	std::uint32_t reserved = 0;
+	std::uint64_t directory_offset = 0;
+	std::uint64_t names_offset = 0;
+	std::uint64_t names_size = 0;
+};
+
+struct entry
+{
+	std::uint64_t hash = 0;
+	std::uint64_t offset = 0;
+	/// Size of the data as stored.
+	std::uint64_t size = 0;
+	/// Size of the data once decompressed.
+	std::uint64_t original_size = 0;
+	std::uint32_t name_offset = 0;
+	std::uint32_t name_size = 0;
+	std::uint32_t flags = 0;
+	std::uint32_t reserved = 0;
+};
+
+//-----------------------------------------------------------------------------
+//  Name : hash_name ()
+/// <summary>
+/// 64 bit FNV-1a of an entry name.
+/// </summary>
+//-----------------------------------------------------------------------------
+std::uint64_t hash_name(const std::string& name);
+}
+
+//-----------------------------------------------------------------------------
+//  Name : archive (Class)
+/// <summary>
+/// Read only view of an archive file. The directory is loaded on open and
+/// the file stays open, entries are read with positional reads on that one
+/// handle so any number of threads can read at the same time.
+/// </summary>
+//-----------------------------------------------------------------------------
+class archive
+{
+public:
+	archive() = default;
+	~archive();
+
+	archive(const archive&) = delete;
+	archive& operator=(const archive&) = delete;
+
+	//-----------------------------------------------------------------------------
+	//  Name : open ()
+	/// <summary>
+	/// Opens the archive and loads its directory.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	bool open(const path& file);
+
+	//-----------------------------------------------------------------------------
+	//  Name : close ()
+	/// <summary>
+	/// Closes the file and drops the directory.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void close();
+
+	//-----------------------------------------------------------------------------
+	//  Name : find ()
+	/// <summary>
+	/// Finds an entry by name, names are relative paths with forward slashes.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	const pak::entry* find(const std::string& name) const;
+
+	//-----------------------------------------------------------------------------
+	//  Name : read ()
+	/// <summary>
+	/// Reads and if needed decompresses an entry.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	bool read(const pak::entry& entry, byte_array_t& data) const;
+
+	//-----------------------------------------------------------------------------
+	//  Name : get_name ()
+	/// <summary>
+	/// Name of an entry.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	std::string get_name(const pak::entry& entry) const;
+
+	//-----------------------------------------------------------------------------
+	//  Name : get_entries ()
+	/// <summary>
+	/// All entries in directory order.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	const std::vector<pak::entry>& get_entries() const
+	{
+		return _entries;
+	}
+
+private:
+	bool read_at(std::uint64_t offset, void* data, std::size_t size) const;
+
+	/// Native file handle, -1 when closed.
+	std::intptr_t _handle = -1;
+	std::vector<pak::entry> _entries;
+	std::vector<char> _names;
+};
+
+//-----------------------------------------------------------------------------
+//  Name : mount_archive ()
+/// <summary>
+/// Serves files of a protocol from an archive, e.g. mounting "app:" makes
+/// "app:/data/mesh.fbx.asset" read the entry "data/mesh.fbx.asset". Files
+/// the archive does not hold are still read from the mapped directory.
+/// </summary>
+//-----------------------------------------------------------------------------
+bool mount_archive(const std::string& protocol, const path& file);
+
+//-----------------------------------------------------------------------------
+//  Name : unmount_archive ()
+/// <summary>
+/// Stops serving a protocol from its archive.
+/// </summary>
+//-----------------------------------------------------------------------------
+void unmount_archive(const std::string& protocol);
+
+//-----------------------------------------------------------------------------
+//  Name : read_file ()
+/// <summary>
+/// Reads a whole file given with its protocol, from the archive mounted for
+/// the protocol when it holds the file and from disk otherwise.
+/// </summary>
+//-----------------------------------------------------------------------------
+bool read_file(const path& file, byte_array_t& data);
+}
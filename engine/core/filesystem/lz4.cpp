@@ -0,0 +1,188 @@
+#include "lz4.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace lz4
+{
+namespace
+{
+const std::size_t min_match = 4;
+/// The last literals of a block, a match never reaches into them.
+const std::size_t last_literals = 5;
+/// A match has to start this far before the end of a block.
+const std::size_t match_limit = 12;
+const std::size_t max_offset = 65535;
+const std::uint32_t hash_bits = 12;
+
+std::uint32_t read32(const std::uint8_t* p)
+{
+	std::uint32_t value;
+	std::memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+std::uint32_t hash(std::uint32_t sequence)
+{
+	return (sequence * 2654435761u) >> (32 - hash_bits);
+}
+
+bool write_length(std::size_t length, std::uint8_t*& op, const std::uint8_t* oend)
+{
+	for(; length >= 255; length -= 255)
+	{
+		if(op >= oend)
+			return false;
+		*op++ = 255;
+	}
+	if(op >= oend)
+		return false;
+	*op++ = static_cast<std::uint8_t>(length);
+	return true;
+}
+
+bool write_sequence(const std::uint8_t* literals, std::size_t literal_count, std::size_t offset,
+					std::size_t match_length, std::uint8_t*& op, const std::uint8_t* oend)
+{
+	if(op >= oend)
+		return false;
+
+	auto token = op++;
+	*token = static_cast<std::uint8_t>(std::min<std::size_t>(literal_count, 15) << 4);
+	if(literal_count >= 15 && !write_length(literal_count - 15, op, oend))
+		return false;
+
+	if(std::size_t(oend - op) < literal_count)
+		return false;
+	if(literal_count > 0)
+		std::memcpy(op, literals, literal_count);
+	op += literal_count;
+
+	// The last sequence only has literals.
+	if(match_length == 0)
+		return true;
+
+	if(oend - op < 2)
+		return false;
+	*op++ = static_cast<std::uint8_t>(offset & 0xff);
+	*op++ = static_cast<std::uint8_t>(offset >> 8);
+
+	const auto length = match_length - min_match;
+	*token |= static_cast<std::uint8_t>(std::min<std::size_t>(length, 15));
+	return length < 15 || write_length(length - 15, op, oend);
+}
+
+bool read_length(std::size_t& length, const std::uint8_t*& ip, const std::uint8_t* iend)
+{
+	std::uint8_t value = 255;
+	while(value == 255)
+	{
+		if(ip >= iend)
+			return false;
+		value = *ip++;
+		length += value;
+	}
+	return true;
+}
+}
+
+std::size_t compress_bound(std::size_t size)
+{
+	return size + size / 255 + 16;
+}
+
+std::size_t compress(const char* src, std::size_t size, char* dst, std::size_t capacity)
+{
+	const auto base = reinterpret_cast<const std::uint8_t*>(src);
+	auto op = reinterpret_cast<std::uint8_t*>(dst);
+	const auto oend = op + capacity;
+
+	std::size_t anchor = 0;
+	if(size > match_limit)
+	{
+		std::vector<std::int64_t> table(std::size_t(1) << hash_bits, -1);
+		const auto limit = size - match_limit;
+		const auto match_end = size - last_literals;
+
+		std::size_t ip = 0;
+		while(ip < limit)
+		{
+			const auto sequence = read32(base + ip);
+			auto& slot = table[hash(sequence)];
+			const auto ref = slot;
+			slot = static_cast<std::int64_t>(ip);
+
+			if(ref < 0 || ip - std::size_t(ref) > max_offset || read32(base + ref) != sequence)
+			{
+				++ip;
+				continue;
+			}
+
+			auto length = min_match;
+			while(ip + length < match_end && base[std::size_t(ref) + length] == base[ip + length])
+				++length;
+
+			if(!write_sequence(base + anchor, ip - anchor, ip - std::size_t(ref), length, op, oend))
+				return 0;
+
+			ip += length;
+			anchor = ip;
+		}
+	}
+
+	if(!write_sequence(base + anchor, size - anchor, 0, 0, op, oend))
+		return 0;
+
+	return static_cast<std::size_t>(op - reinterpret_cast<std::uint8_t*>(dst));
+}
+
+bool decompress(const char* src, std::size_t size, char* dst, std::size_t dst_size)
+{
+	auto ip = reinterpret_cast<const std::uint8_t*>(src);
+	const auto iend = ip + size;
+	const auto obegin = reinterpret_cast<std::uint8_t*>(dst);
+	auto op = obegin;
+	const auto oend = op + dst_size;
+
+	while(ip < iend)
+	{
+		const auto token = *ip++;
+
+		std::size_t literal_count = token >> 4;
+		if(literal_count == 15 && !read_length(literal_count, ip, iend))
+			return false;
+		if(std::size_t(iend - ip) < literal_count || std::size_t(oend - op) < literal_count)
+			return false;
+		if(literal_count > 0)
+			std::memcpy(op, ip, literal_count);
+		ip += literal_count;
+		op += literal_count;
+
+		if(ip == iend)
+			break;
+
+		if(iend - ip < 2)
+			return false;
+		const std::size_t offset = ip[0] | (std::size_t(ip[1]) << 8);
+		ip += 2;
+		if(offset == 0 || offset > std::size_t(op - obegin))
+			return false;
+
+		std::size_t length = token & 15;
+		if(length == 15 && !read_length(length, ip, iend))
+			return false;
+		length += min_match;
+		if(std::size_t(oend - op) < length)
+			return false;
+
+		// Matches may overlap what they write.
+		const auto match = op - offset;
+		for(std::size_t i = 0; i < length; ++i)
+			op[i] = match[i];
+		op += length;
+	}
+
+	return op == oend;
+}
+}
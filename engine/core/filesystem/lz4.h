@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+
+//-----------------------------------------------------------------------------
+//  Name : lz4 (Namespace)
+/// <summary>
+/// Compression in the LZ4 block format. The compressor is a plain greedy
+/// one, it trades ratio for speed, the output is readable by any LZ4 block
+/// decoder.
+/// </summary>
+//-----------------------------------------------------------------------------
+namespace lz4
+{
+//-----------------------------------------------------------------------------
+//  Name : compress_bound ()
+/// <summary>
+/// Largest compressed size of size bytes.
+/// </summary>
+//-----------------------------------------------------------------------------
+std::size_t compress_bound(std::size_t size);
+
+//-----------------------------------------------------------------------------
+//  Name : compress ()
+/// <summary>
+/// Compresses src into dst, which should hold compress_bound(size) bytes.
+/// Returns the compressed size, 0 when dst is too small.
+/// </summary>
+//-----------------------------------------------------------------------------
+std::size_t compress(const char* src, std::size_t size, char* dst, std::size_t capacity);
+
+//-----------------------------------------------------------------------------
+//  Name : decompress ()
+/// <summary>
+/// Decompresses a block that expands to exactly dst_size bytes. Returns
+/// false for malformed input.
+/// </summary>
+//-----------------------------------------------------------------------------
+bool decompress(const char* src, std::size_t size, char* dst, std::size_t dst_size);
+}
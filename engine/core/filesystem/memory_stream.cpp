@@ -0,0 +1,41 @@
+#include "memory_stream.h"
+
+namespace fs
+{
+memory_buffer::memory_buffer(char* data, std::size_t size)
+{
+	setg(data, data, data + size);
+}
+
+memory_buffer::pos_type memory_buffer::seekoff(off_type off, std::ios_base::seekdir dir,
+											   std::ios_base::openmode which)
+{
+	if((which & std::ios_base::in) == 0)
+		return pos_type(off_type(-1));
+
+	char* base = gptr();
+	if(dir == std::ios_base::beg)
+		base = eback();
+	else if(dir == std::ios_base::end)
+		base = egptr();
+
+	if(off < eback() - base || off > egptr() - base)
+		return pos_type(off_type(-1));
+
+	setg(eback(), base + off, egptr());
+	return pos_type(gptr() - eback());
+}
+
+memory_buffer::pos_type memory_buffer::seekpos(pos_type pos, std::ios_base::openmode which)
+{
+	return seekoff(off_type(pos), std::ios_base::beg, which);
+}
+
+memory_stream::memory_stream(byte_array_t&& data)
+	: std::istream(nullptr)
+	, _data(std::move(data))
+	, _buffer(_data.data(), _data.size())
+{
+	rdbuf(&_buffer);
+}
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "filesystem.h"
+#include <istream>
+#include <streambuf>
+
+namespace fs
+{
+//-----------------------------------------------------------------------------
+//  Name : memory_buffer (Class)
+/// <summary>
+/// Read only, seekable stream buffer over memory it does not own.
+/// </summary>
+//-----------------------------------------------------------------------------
+class memory_buffer : public std::streambuf
+{
+public:
+	memory_buffer(char* data, std::size_t size);
+
+protected:
+	pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+					 std::ios_base::openmode which = std::ios_base::in) override;
+	pos_type seekpos(pos_type pos, std::ios_base::openmode which = std::ios_base::in) override;
+};
+
+//-----------------------------------------------------------------------------
+//  Name : memory_stream (Class)
+/// <summary>
+/// Input stream that takes over a byte array, e.g. the result of
+/// read_stream, and reads from it without copying it again.
+/// </summary>
+//-----------------------------------------------------------------------------
+class memory_stream : public std::istream
+{
+public:
+	explicit memory_stream(byte_array_t&& data);
+
+	memory_stream(const memory_stream&) = delete;
+	memory_stream& operator=(const memory_stream&) = delete;
+
+	//-----------------------------------------------------------------------------
+	//  Name : size ()
+	/// <summary>
+	/// Size of the bytes the stream owns.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	std::size_t size() const
+	{
+		return _data.size();
+	}
+
+private:
+	byte_array_t _data;
+	memory_buffer _buffer;
+};
+}
@@ -0,0 +1,288 @@
+#include "aabb_tree.h"
+#include <algorithm>
+
+namespace math
+{
+namespace
+{
+bbox combine(const bbox& a, const bbox& b)
+{
+	return bbox(glm::min(a.min, b.min), glm::max(a.max, b.max));
+}
+
+bool contains(const bbox& outer, const bbox& inner)
+{
+	return outer.min.x <= inner.min.x && outer.min.y <= inner.min.y && outer.min.z <= inner.min.z &&
+		   outer.max.x >= inner.max.x && outer.max.y >= inner.max.y && outer.max.z >= inner.max.z;
+}
+
+// half the surface area, good enough as an insertion cost
+float area(const bbox& b)
+{
+	const auto d = b.max - b.min;
+	return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// aabb_tree Member Functions
+///////////////////////////////////////////////////////////////////////////////
+aabb_tree::aabb_tree(float margin)
+	: _margin(margin)
+{
+}
+
+void aabb_tree::clear()
+{
+	_nodes.clear();
+	_root = null_node;
+	_free_list = null_node;
+	_leaf_count = 0;
+}
+
+std::int32_t aabb_tree::insert(const bbox& bounds, std::uint32_t user_data)
+{
+	const auto proxy = allocate_node();
+	auto& n = _nodes[proxy];
+	n.bounds = bounds;
+	n.bounds.inflate(_margin);
+	n.user_data = user_data;
+	n.height = 0;
+
+	insert_leaf(proxy);
+	++_leaf_count;
+	return proxy;
+}
+
+void aabb_tree::remove(std::int32_t proxy)
+{
+	remove_leaf(proxy);
+	free_node(proxy);
+	--_leaf_count;
+}
+
+bool aabb_tree::update(std::int32_t proxy, const bbox& bounds)
+{
+	if(contains(_nodes[proxy].bounds, bounds))
+		return false;
+
+	remove_leaf(proxy);
+	_nodes[proxy].bounds = bounds;
+	_nodes[proxy].bounds.inflate(_margin);
+	insert_leaf(proxy);
+	return true;
+}
+
+std::int32_t aabb_tree::allocate_node()
+{
+	if(_free_list == null_node)
+	{
+		_nodes.emplace_back();
+		return static_cast<std::int32_t>(_nodes.size() - 1);
+	}
+
+	const auto index = _free_list;
+	_free_list = _nodes[index].parent;
+	_nodes[index] = node();
+	return index;
+}
+
+void aabb_tree::free_node(std::int32_t index)
+{
+	_nodes[index].parent = _free_list;
+	_nodes[index].height = -1;
+	_free_list = index;
+}
+
+void aabb_tree::insert_leaf(std::int32_t leaf)
+{
+	if(_root == null_node)
+	{
+		_root = leaf;
+		_nodes[leaf].parent = null_node;
+		return;
+	}
+
+	// Find the best sibling by walking down where the enlargement is cheapest.
+	const auto leaf_bounds = _nodes[leaf].bounds;
+	auto index = _root;
+	while(!_nodes[index].is_leaf())
+	{
+		const auto& n = _nodes[index];
+		const auto node_area = area(n.bounds);
+		const auto combined_area = area(combine(n.bounds, leaf_bounds));
+
+		// cost of making a new parent for this node and the leaf
+		const auto cost = 2.0f * combined_area;
+		// minimum cost of pushing the leaf further down
+		const auto inheritance_cost = 2.0f * (combined_area - node_area);
+
+		auto child_cost = [&](std::int32_t child) {
+			const auto& c = _nodes[child];
+			const auto enlarged = area(combine(c.bounds, leaf_bounds));
+			return c.is_leaf() ? enlarged + inheritance_cost
+							   : (enlarged - area(c.bounds)) + inheritance_cost;
+		};
+
+		const auto cost_left = child_cost(n.left);
+		const auto cost_right = child_cost(n.right);
+
+		if(cost < cost_left && cost < cost_right)
+			break;
+
+		index = cost_left < cost_right ? n.left : n.right;
+	}
+
+	const auto sibling = index;
+	const auto old_parent = _nodes[sibling].parent;
+	const auto new_parent = allocate_node();
+	{
+		auto& p = _nodes[new_parent];
+		p.parent = old_parent;
+		p.bounds = combine(leaf_bounds, _nodes[sibling].bounds);
+		p.height = _nodes[sibling].height + 1;
+		p.left = sibling;
+		p.right = leaf;
+	}
+	_nodes[sibling].parent = new_parent;
+	_nodes[leaf].parent = new_parent;
+
+	if(old_parent != null_node)
+	{
+		if(_nodes[old_parent].left == sibling)
+			_nodes[old_parent].left = new_parent;
+		else
+			_nodes[old_parent].right = new_parent;
+	}
+	else
+	{
+		_root = new_parent;
+	}
+
+	// Walk back up fixing heights and bounds.
+	index = _nodes[leaf].parent;
+	while(index != null_node)
+	{
+		index = balance(index);
+
+		auto& n = _nodes[index];
+		n.height = 1 + std::max(_nodes[n.left].height, _nodes[n.right].height);
+		n.bounds = combine(_nodes[n.left].bounds, _nodes[n.right].bounds);
+
+		index = n.parent;
+	}
+}
+
+void aabb_tree::remove_leaf(std::int32_t leaf)
+{
+	if(leaf == _root)
+	{
+		_root = null_node;
+		return;
+	}
+
+	const auto parent = _nodes[leaf].parent;
+	const auto grand_parent = _nodes[parent].parent;
+	const auto sibling = _nodes[parent].left == leaf ? _nodes[parent].right : _nodes[parent].left;
+
+	if(grand_parent != null_node)
+	{
+		// Destroy the parent and connect the sibling to the grand parent.
+		if(_nodes[grand_parent].left == parent)
+			_nodes[grand_parent].left = sibling;
+		else
+			_nodes[grand_parent].right = sibling;
+
+		_nodes[sibling].parent = grand_parent;
+		free_node(parent);
+
+		auto index = grand_parent;
+		while(index != null_node)
+		{
+			index = balance(index);
+
+			auto& n = _nodes[index];
+			n.bounds = combine(_nodes[n.left].bounds, _nodes[n.right].bounds);
+			n.height = 1 + std::max(_nodes[n.left].height, _nodes[n.right].height);
+
+			index = n.parent;
+		}
+	}
+	else
+	{
+		_root = sibling;
+		_nodes[sibling].parent = null_node;
+		free_node(parent);
+	}
+}
+
+std::int32_t aabb_tree::balance(std::int32_t a_index)
+{
+	// Rotates the taller grand child up when the children of a differ in
+	// height by more than one. Returns the new root of the subtree.
+	auto& a = _nodes[a_index];
+	if(a.is_leaf() || a.height < 2)
+		return a_index;
+
+	const auto b_index = a.left;
+	const auto c_index = a.right;
+	auto& b = _nodes[b_index];
+	auto& c = _nodes[c_index];
+
+	const auto balance = c.height - b.height;
+
+	auto rotate_up = [&](std::int32_t up_index, std::int32_t other_index, bool up_is_right) {
+		auto& up = _nodes[up_index];
+		auto& other = _nodes[other_index];
+		const auto f_index = up.left;
+		const auto g_index = up.right;
+		auto& f = _nodes[f_index];
+		auto& g = _nodes[g_index];
+
+		// Swap a and up.
+		up.left = a_index;
+		up.parent = a.parent;
+		a.parent = up_index;
+
+		if(up.parent != null_node)
+		{
+			if(_nodes[up.parent].left == a_index)
+				_nodes[up.parent].left = up_index;
+			else
+				_nodes[up.parent].right = up_index;
+		}
+		else
+		{
+			_root = up_index;
+		}
+
+		// Keep the taller grand child under up, move the other one to a.
+		const bool keep_f = f.height > g.height;
+		const auto keep_index = keep_f ? f_index : g_index;
+		const auto move_index = keep_f ? g_index : f_index;
+		auto& move = _nodes[move_index];
+
+		up.right = keep_index;
+		if(up_is_right)
+			a.right = move_index;
+		else
+			a.left = move_index;
+		move.parent = a_index;
+
+		a.bounds = combine(other.bounds, move.bounds);
+		up.bounds = combine(a.bounds, _nodes[keep_index].bounds);
+		a.height = 1 + std::max(other.height, move.height);
+		up.height = 1 + std::max(a.height, _nodes[keep_index].height);
+
+		return up_index;
+	};
+
+	if(balance > 1)
+		return rotate_up(c_index, b_index, true);
+
+	if(balance < -1)
+		return rotate_up(b_index, c_index, false);
+
+	return a_index;
+}
+}
@@ -0,0 +1,229 @@
+#pragma once
+//-----------------------------------------------------------------------------
+// aabb_tree Header Includes
+//-----------------------------------------------------------------------------
+#include "bbox.h"
+#include "frustum.h"
+#include <cstdint>
+#include <vector>
+
+namespace math
+{
+//-----------------------------------------------------------------------------
+// Main class declarations
+//-----------------------------------------------------------------------------
+//-----------------------------------------------------------------------------
+//  Name : aabb_tree (Class)
+/// <summary>
+/// Dynamic bounding volume hierarchy. Leaves store slightly enlarged (fat)
+/// boxes so that small movements do not touch the tree, and the tree is kept
+/// balanced with rotations on insertion and removal. Queries reject or
+/// accept whole subtrees at once.
+/// </summary>
+//-----------------------------------------------------------------------------
+class aabb_tree
+{
+public:
+	static const std::int32_t null_node = -1;
+
+	explicit aabb_tree(float margin = 0.1f);
+
+	//-----------------------------------------------------------------------------
+	//  Name : insert ()
+	/// <summary>
+	/// Adds a box and returns the proxy that identifies it.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	std::int32_t insert(const bbox& bounds, std::uint32_t user_data);
+
+	//-----------------------------------------------------------------------------
+	//  Name : remove ()
+	/// <summary>
+	/// Removes a proxy returned from insert.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void remove(std::int32_t proxy);
+
+	//-----------------------------------------------------------------------------
+	//  Name : update ()
+	/// <summary>
+	/// Moves a proxy. The tree is only changed when the new box leaves the fat
+	/// box, returns true in that case.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	bool update(std::int32_t proxy, const bbox& bounds);
+
+	//-----------------------------------------------------------------------------
+	//  Name : query ()
+	/// <summary>
+	/// Calls visit(user_data, fully_inside) for each leaf whose fat box is not
+	/// outside the frustum. fully_inside tells that no further test is needed.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	template <typename F>
+	void query(const frustum& f, F&& visit) const;
+
+	//-----------------------------------------------------------------------------
+	//  Name : query ()
+	/// <summary>
+	/// Calls visit(user_data) for each leaf whose fat box overlaps bounds.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	template <typename F>
+	void query(const bbox& bounds, F&& visit) const;
+
+	const bbox& get_fat_bounds(std::int32_t proxy) const
+	{
+		return _nodes[proxy].bounds;
+	}
+
+	std::uint32_t get_user_data(std::int32_t proxy) const
+	{
+		return _nodes[proxy].user_data;
+	}
+
+	//-----------------------------------------------------------------------------
+	//  Name : size ()
+	/// <summary>
+	/// Number of proxies in the tree.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	std::size_t size() const
+	{
+		return _leaf_count;
+	}
+
+	//-----------------------------------------------------------------------------
+	//  Name : get_height ()
+	/// <summary>
+	/// Height of the tree, 0 for a single leaf.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	std::int32_t get_height() const
+	{
+		return _root == null_node ? 0 : _nodes[_root].height;
+	}
+
+	void clear();
+
+private:
+	struct node
+	{
+		bool is_leaf() const
+		{
+			return left == null_node;
+		}
+
+		bbox bounds;
+		std::uint32_t user_data = 0;
+		/// parent, or next free node while on the free list
+		std::int32_t parent = null_node;
+		std::int32_t left = null_node;
+		std::int32_t right = null_node;
+		/// leaf = 0, free node = -1
+		std::int32_t height = -1;
+	};
+
+	std::int32_t allocate_node();
+	void free_node(std::int32_t index);
+	void insert_leaf(std::int32_t leaf);
+	void remove_leaf(std::int32_t leaf);
+	std::int32_t balance(std::int32_t index);
+	template <typename F>
+	void visit_subtree(std::int32_t index, F& visit) const;
+
+	std::vector<node> _nodes;
+	std::int32_t _root = null_node;
+	std::int32_t _free_list = null_node;
+	std::size_t _leaf_count = 0;
+	float _margin = 0.1f;
+	/// scratch stack for queries, mutable so that queries stay const
+	mutable std::vector<std::int32_t> _stack;
+};
+
+template <typename F>
+void aabb_tree::visit_subtree(std::int32_t index, F& visit) const
+{
+	const auto base = _stack.size();
+	_stack.push_back(index);
+	while(_stack.size() > base)
+	{
+		const auto current = _stack.back();
+		_stack.pop_back();
+
+		const auto& n = _nodes[current];
+		if(n.is_leaf())
+		{
+			visit(n.user_data, true);
+		}
+		else
+		{
+			_stack.push_back(n.left);
+			_stack.push_back(n.right);
+		}
+	}
+}
+
+template <typename F>
+void aabb_tree::query(const frustum& f, F&& visit) const
+{
+	if(_root == null_node)
+		return;
+
+	_stack.clear();
+	_stack.push_back(_root);
+	while(!_stack.empty())
+	{
+		const auto current = _stack.back();
+		_stack.pop_back();
+
+		const auto& n = _nodes[current];
+		const auto result = f.classify_aabb(n.bounds);
+		if(result == volume_query::outside)
+			continue;
+
+		if(result == volume_query::inside)
+		{
+			visit_subtree(current, visit);
+		}
+		else if(n.is_leaf())
+		{
+			visit(n.user_data, false);
+		}
+		else
+		{
+			_stack.push_back(n.left);
+			_stack.push_back(n.right);
+		}
+	}
+}
+
+template <typename F>
+void aabb_tree::query(const bbox& bounds, F&& visit) const
+{
+	if(_root == null_node)
+		return;
+
+	_stack.clear();
+	_stack.push_back(_root);
+	while(!_stack.empty())
+	{
+		const auto current = _stack.back();
+		_stack.pop_back();
+
+		const auto& n = _nodes[current];
+		if(!n.bounds.intersect(bounds))
+			continue;
+
+		if(n.is_leaf())
+		{
+			visit(n.user_data);
+		}
+		else
+		{
+			_stack.push_back(n.left);
+			_stack.push_back(n.right);
+		}
+	}
+}
+}
@@ -1,4 +1,12 @@
 #include "frustum.h"
+#include <algorithm>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define ETHEREAL_FRUSTUM_SSE 1
+#else
+#define ETHEREAL_FRUSTUM_SSE 0
+#endif
 
 namespace math
 {
@@ -483,13 +491,32 @@ bool frustum::test_aabb(const bbox& AABB) const
 /// Determine whether or not the box passed is within the frustum.
 /// </summary>
 //-----------------------------------------------------------------------------
-bool frustum::test_obb(frustum frustum, const bbox& AABB, const transform& t)
+bool frustum::test_obb(const frustum& frustum, const bbox& AABB, const transform& t)
 {
-	transform invTransform = inverse(t);
+	// Test the box in world space instead of moving the frustum into box space.
+	// Per plane, the box is outside when its center is further out than the
+	// box's extent projected on the plane normal.
+	const vec3 center = AABB.get_center();
+	const vec3 extents = AABB.get_extents();
+	const vec3 world_center = vec3(t[0]) * center.x + vec3(t[1]) * center.y + vec3(t[2]) * center.z + vec3(t[3]);
+	const vec3 axis_x = vec3(t[0]) * extents.x;
+	const vec3 axis_y = vec3(t[1]) * extents.y;
+	const vec3 axis_z = vec3(t[2]) * extents.z;
 
-	frustum.mul(invTransform);
+	for(size_t i = 0; i < 6; i++)
+	{
+		const plane& plane = frustum.planes[i];
+		const vec3 normal(plane.data);
+		const float radius =
+			glm::abs(dot(normal, axis_x)) + glm::abs(dot(normal, axis_y)) + glm::abs(dot(normal, axis_z));
+
+		if(plane::dotCoord(plane, world_center) - radius > 0.0f)
+			return false;
+
+	} // Next plane
 
-	return frustum.test_aabb(AABB);
+	// Intersecting / inside
+	return true;
 }
 
 //-----------------------------------------------------------------------------
@@ -628,6 +655,113 @@ bool frustum::test_sphere(const vec3& vecCenter, float fRadius) const
 	return true;
 }
 
+//-----------------------------------------------------------------------------
+//  Name : test_aabbs ()
+/// <summary>
+/// Batch version of test_aabb writing a visibility bitmask.
+/// </summary>
+//-----------------------------------------------------------------------------
+void frustum::test_aabbs(const bbox* boxes, std::size_t count, std::uint32_t* visible) const
+{
+	std::fill(visible, visible + (count + 31) / 32, 0u);
+
+	std::size_t i = 0;
+#if ETHEREAL_FRUSTUM_SSE
+	// Four boxes at a time. Each box is read as (min.x min.y min.z max.x) and
+	// (min.z max.x max.y max.z), transposing those gives every component of
+	// the four boxes in its own register.
+	for(; i + 4 <= count; i += 4)
+	{
+		const float* b0 = &boxes[i + 0].min.x;
+		const float* b1 = &boxes[i + 1].min.x;
+		const float* b2 = &boxes[i + 2].min.x;
+		const float* b3 = &boxes[i + 3].min.x;
+
+		__m128 min_x = _mm_loadu_ps(b0);
+		__m128 min_y = _mm_loadu_ps(b1);
+		__m128 min_z = _mm_loadu_ps(b2);
+		__m128 max_x = _mm_loadu_ps(b3);
+		_MM_TRANSPOSE4_PS(min_x, min_y, min_z, max_x);
+
+		__m128 unused = _mm_loadu_ps(b0 + 2);
+		__m128 max_x2 = _mm_loadu_ps(b1 + 2);
+		__m128 max_y = _mm_loadu_ps(b2 + 2);
+		__m128 max_z = _mm_loadu_ps(b3 + 2);
+		_MM_TRANSPOSE4_PS(unused, max_x2, max_y, max_z);
+
+		__m128 outside = _mm_setzero_ps();
+		for(size_t p = 0; p < 6; p++)
+		{
+			const vec4& data = planes[p].data;
+
+			// Nearest corner along the plane normal.
+			const __m128 near_x = data.x > 0.0f ? min_x : max_x;
+			const __m128 near_y = data.y > 0.0f ? min_y : max_y;
+			const __m128 near_z = data.z > 0.0f ? min_z : max_z;
+
+			__m128 dist = _mm_add_ps(_mm_mul_ps(near_x, _mm_set1_ps(data.x)), _mm_set1_ps(data.w));
+			dist = _mm_add_ps(dist, _mm_mul_ps(near_y, _mm_set1_ps(data.y)));
+			dist = _mm_add_ps(dist, _mm_mul_ps(near_z, _mm_set1_ps(data.z)));
+
+			outside = _mm_or_ps(outside, _mm_cmpgt_ps(dist, _mm_setzero_ps()));
+		}
+
+		const auto bits = static_cast<std::uint32_t>(~_mm_movemask_ps(outside) & 0xf);
+		visible[i / 32] |= bits << (i % 32);
+	}
+#endif
+
+	for(; i < count; ++i)
+	{
+		if(test_aabb(boxes[i]))
+			visible[i / 32] |= 1u << (i % 32);
+	}
+}
+
+//-----------------------------------------------------------------------------
+//  Name : test_spheres ()
+/// <summary>
+/// Batch version of test_sphere writing a visibility bitmask.
+/// </summary>
+//-----------------------------------------------------------------------------
+void frustum::test_spheres(const vec3* centers, const float* radii, std::size_t count,
+						   std::uint32_t* visible) const
+{
+	std::fill(visible, visible + (count + 31) / 32, 0u);
+
+	std::size_t i = 0;
+#if ETHEREAL_FRUSTUM_SSE
+	for(; i + 4 <= count; i += 4)
+	{
+		const __m128 x = _mm_setr_ps(centers[i].x, centers[i + 1].x, centers[i + 2].x, centers[i + 3].x);
+		const __m128 y = _mm_setr_ps(centers[i].y, centers[i + 1].y, centers[i + 2].y, centers[i + 3].y);
+		const __m128 z = _mm_setr_ps(centers[i].z, centers[i + 1].z, centers[i + 2].z, centers[i + 3].z);
+		const __m128 radius = _mm_loadu_ps(radii + i);
+
+		__m128 outside = _mm_setzero_ps();
+		for(size_t p = 0; p < 6; p++)
+		{
+			const vec4& data = planes[p].data;
+
+			__m128 dist = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(data.x)), _mm_set1_ps(data.w));
+			dist = _mm_add_ps(dist, _mm_mul_ps(y, _mm_set1_ps(data.y)));
+			dist = _mm_add_ps(dist, _mm_mul_ps(z, _mm_set1_ps(data.z)));
+
+			outside = _mm_or_ps(outside, _mm_cmpge_ps(dist, radius));
+		}
+
+		const auto bits = static_cast<std::uint32_t>(~_mm_movemask_ps(outside) & 0xf);
+		visible[i / 32] |= bits << (i % 32);
+	}
+#endif
+
+	for(; i < count; ++i)
+	{
+		if(test_sphere(centers[i], radii[i]))
+			visible[i / 32] |= 1u << (i % 32);
+	}
+}
+
 //-----------------------------------------------------------------------------
 //  Name : sweptSphereIntersectPlane () (Private, Static)
 /// <summary>
@@ -5,6 +5,8 @@
 #include "math_types.h"
 #include "plane.h"
 #include "transform.h"
+#include <cstddef>
+#include <cstdint>
 
 namespace math
 {
@@ -48,11 +50,18 @@ public:
 	bool test_frustum(const frustum& frustum) const;
 	bool test_line(const vec3& v1, const vec3& v2) const;
 	frustum& mul(const transform& t);
+
+	// Batch tests. Bit i of visible (32 items per word) is set when item i is
+	// not completely outside the frustum, visible must hold (count + 31) / 32
+	// words. Uses SSE when available.
+	void test_aabbs(const bbox* boxes, std::size_t count, std::uint32_t* visible) const;
+	void test_spheres(const vec3* centers, const float* radii, std::size_t count,
+					  std::uint32_t* visible) const;
 	//-------------------------------------------------------------------------
 	// Public Static Functions
 	//-------------------------------------------------------------------------
 	static frustum mul(frustum f, const transform& t);
-	static bool test_obb(frustum f, const bbox& bounds, const transform& t);
+	static bool test_obb(const frustum& f, const bbox& bounds, const transform& t);
 	static bool test_extruded_obb(frustum f, const bbox_extruded& bounds, const transform& t);
 	static volume_query classify_obb(frustum f, const bbox& bounds, const transform& t);
 	static volume_query classify_obb(frustum f, const bbox& bounds, const transform& t,
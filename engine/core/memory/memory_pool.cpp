@@ -1,5 +1,7 @@
 #include "memory_pool.hpp"
+#include <algorithm>
 #include <cstdlib>
+#include <functional>
 #include <cstring>
 
 namespace core
@@ -43,18 +45,22 @@ void* memory_pool::malloc()
 
 void memory_pool::free(void* block)
 {
-	// find block index of the element
+	// find block index of the element, the owning chunk is the last one
+	// starting at or before the block
 	std::size_t index = invalid;
 	std::size_t offset = _chunk_entries_size * _block_size;
 
-	for(std::size_t i = 0; i < _chunks.size(); ++i)
+	auto address = static_cast<uint8_t*>(block);
+	auto found = std::upper_bound(_sorted_chunks.begin(), _sorted_chunks.end(), address,
+								  [](uint8_t* a, const std::pair<uint8_t*, std::size_t>& chunk) {
+									  return std::less<uint8_t*>()(a, chunk.first);
+								  });
+	if(found != _sorted_chunks.begin())
 	{
-		if((std::size_t)block >= (std::size_t)_chunks[i] &&
-		   (std::size_t)block < (std::size_t)_chunks[i] + offset)
-		{
-			index = i * _chunk_entries_size + ((std::size_t)block - (std::size_t)_chunks[i]) / _block_size;
-			break;
-		}
+		--found;
+		const auto distance = (std::size_t)address - (std::size_t)found->first;
+		if(distance < offset)
+			index = found->second * _chunk_entries_size + distance / _block_size;
 	}
 
 	if(index == invalid)
@@ -78,6 +84,7 @@ void memory_pool::free_all()
 		::free(chunk);
 
 	_chunks.clear();
+	_sorted_chunks.clear();
 	_available = 0;
 	_first_free_block = invalid;
 }
@@ -85,11 +92,11 @@ void memory_pool::free_all()
 std::size_t memory_pool::grow()
 {
 	auto chunk = static_cast<uint8_t*>(::malloc(_chunk_entries_size * _block_size));
-	memset(chunk, 0xCC, _chunk_entries_size * _block_size);
-
 	if(chunk == nullptr)
 		return invalid;
 
+	memset(chunk, 0xCC, _chunk_entries_size * _block_size);
+
 	auto iterator = chunk;
 	auto offset = _chunk_entries_size * _chunks.size();
 	for(std::size_t i = 1; i < _chunk_entries_size; ++i, iterator += _block_size)
@@ -98,6 +105,9 @@ std::size_t memory_pool::grow()
 
 	_available += _chunk_entries_size;
 	_chunks.push_back(chunk);
+
+	auto entry = std::make_pair(chunk, _chunks.size() - 1);
+	_sorted_chunks.insert(std::upper_bound(_sorted_chunks.begin(), _sorted_chunks.end(), entry), entry);
 	return offset;
 }
 }
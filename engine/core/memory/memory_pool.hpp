@@ -3,6 +3,7 @@
 #include <cstdint>
 #include <limits>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace core
@@ -39,6 +40,8 @@ protected:
 	std::size_t grow();
 
 	std::vector<uint8_t*> _chunks;
+	// chunk start addresses with their index in _chunks, sorted by address
+	std::vector<std::pair<uint8_t*, std::size_t>> _sorted_chunks;
 
 	std::size_t _available;
 	std::size_t _first_free_block;
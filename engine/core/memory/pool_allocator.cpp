@@ -0,0 +1,85 @@
+#include "pool_allocator.hpp"
+#include <vector>
+
+namespace core
+{
+namespace
+{
+struct pool_registry
+{
+	std::mutex mutex;
+	std::vector<const detail::tagged_pool*> pools;
+};
+
+pool_registry& get_registry()
+{
+	// never destroyed, same as the pools it refers to
+	static auto registry = new pool_registry();
+	return *registry;
+}
+}
+
+namespace detail
+{
+tagged_pool::tagged_pool(const rtti::type_index_t& tag, std::size_t block_size, std::size_t chunk_size)
+	: tag(tag)
+	, _pool(block_size, chunk_size)
+	, _block_size(block_size)
+{
+	auto& registry = get_registry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	registry.pools.push_back(this);
+}
+
+void* tagged_pool::malloc()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _pool.malloc();
+}
+
+void tagged_pool::free(void* block)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_pool.free(block);
+}
+
+pool_stats tagged_pool::stats() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	pool_stats result;
+	result.size = _pool.size();
+	result.capacity = _pool.capacity();
+	result.bytes = result.capacity * _block_size;
+	return result;
+}
+}
+
+static pool_stats collect_stats(const rtti::type_index_t* tag)
+{
+	auto& registry = get_registry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+
+	pool_stats result;
+	for(auto pool : registry.pools)
+	{
+		if(tag && pool->tag != *tag)
+			continue;
+
+		const auto stats = pool->stats();
+		result.size += stats.size;
+		result.capacity += stats.capacity;
+		result.bytes += stats.bytes;
+	}
+	return result;
+}
+
+pool_stats get_pool_stats(const rtti::type_index_t& tag)
+{
+	return collect_stats(&tag);
+}
+
+pool_stats get_pool_stats()
+{
+	return collect_stats(nullptr);
+}
+}
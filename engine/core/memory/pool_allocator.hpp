@@ -0,0 +1,117 @@
+#pragma once
+
+#include "../common/nonstd/type_traits.hpp"
+#include "memory_pool.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+
+namespace core
+{
+
+struct pool_stats
+{
+	// blocks currently handed out
+	std::size_t size = 0;
+	// blocks allocated from the system
+	std::size_t capacity = 0;
+	// bytes allocated from the system
+	std::size_t bytes = 0;
+};
+
+namespace detail
+{
+// a memory pool guarded by a mutex, registered for statistics under a tag type
+struct tagged_pool
+{
+	tagged_pool(const rtti::type_index_t& tag, std::size_t block_size, std::size_t chunk_size);
+
+	void* malloc();
+	void free(void* block);
+	pool_stats stats() const;
+
+	const rtti::type_index_t& tag;
+
+private:
+	mutable std::mutex _mutex;
+	memory_pool _pool;
+	std::size_t _block_size;
+};
+
+// the pool serving blocks of T for allocators tagged with Tag, never destroyed
+// since blocks may be returned during static destruction.
+template <typename T, typename Tag, std::size_t Growth>
+tagged_pool& get_tagged_pool()
+{
+	using storage_t = typename memory_pool_t<T, Growth>::aligned_storage_t;
+	static auto pool = new tagged_pool(rtti::type_id<Tag>(), sizeof(storage_t), Growth);
+	return *pool;
+}
+}
+
+// statistics of all pools used by pool_allocators tagged with tag
+pool_stats get_pool_stats(const rtti::type_index_t& tag);
+
+// statistics of every pool used by pool_allocators
+pool_stats get_pool_stats();
+
+// a std allocator handing out single objects from a memory_pool_t per type,
+// arrays and over-aligned types go to the global heap. it is meant for
+// std::allocate_shared, where the rebound type holds both the control block
+// and the object. allocators with the same Tag report into the same stats.
+template <typename T, typename Tag = T, std::size_t Growth = 256>
+struct pool_allocator
+{
+	using value_type = T;
+
+	template <typename U>
+	struct rebind
+	{
+		using other = pool_allocator<U, Tag, Growth>;
+	};
+
+	pool_allocator() = default;
+
+	template <typename U>
+	pool_allocator(const pool_allocator<U, Tag, Growth>&) noexcept
+	{
+	}
+
+	T* allocate(std::size_t n)
+	{
+		if(n != 1 || alignof(T) > alignof(std::max_align_t))
+			return static_cast<T*>(::operator new(n * sizeof(T)));
+
+		auto block = detail::get_tagged_pool<T, Tag, Growth>().malloc();
+		if(!block)
+			throw std::bad_alloc();
+
+		return static_cast<T*>(block);
+	}
+
+	void deallocate(T* p, std::size_t n) noexcept
+	{
+		if(n != 1 || alignof(T) > alignof(std::max_align_t))
+		{
+			::operator delete(p);
+			return;
+		}
+
+		detail::get_tagged_pool<T, Tag, Growth>().free(p);
+	}
+
+	template <typename U>
+	bool operator==(const pool_allocator<U, Tag, Growth>&) const noexcept
+	{
+		return true;
+	}
+
+	template <typename U>
+	bool operator!=(const pool_allocator<U, Tag, Growth>&) const noexcept
+	{
+		return false;
+	}
+};
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+namespace core
+{
+
+// an eventcount lets threads park on a condition without the notifier
+// paying for a lock when nobody is waiting.
+// usage on the waiting side:
+//     auto key = ec.prepare_wait();
+//     if(condition_satisfied()) { ec.cancel_wait(); return; }
+//     ec.commit_wait(key);
+// the notifying side makes the condition true and then calls notify_*.
+class event_count
+{
+public:
+	using key_t = std::uint64_t;
+
+	key_t prepare_wait() noexcept
+	{
+		_waiters.fetch_add(1, std::memory_order_seq_cst);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		return _epoch.load(std::memory_order_acquire);
+	}
+
+	void cancel_wait() noexcept
+	{
+		_waiters.fetch_sub(1, std::memory_order_seq_cst);
+	}
+
+	void commit_wait(key_t key)
+	{
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_cv.wait(lock, [&]() { return _epoch.load(std::memory_order_acquire) != key; });
+		}
+		_waiters.fetch_sub(1, std::memory_order_seq_cst);
+	}
+
+	// like commit_wait but gives up after the timeout, returns false when
+	// nothing was notified in the meantime.
+	template <typename Rep, typename Period>
+	bool commit_wait_for(key_t key, const std::chrono::duration<Rep, Period>& timeout)
+	{
+		bool notified = false;
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			notified = _cv.wait_for(lock, timeout,
+									[&]() { return _epoch.load(std::memory_order_acquire) != key; });
+		}
+		_waiters.fetch_sub(1, std::memory_order_seq_cst);
+		return notified;
+	}
+
+	void notify_one()
+	{
+		if(!has_waiters())
+			return;
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_epoch.fetch_add(1, std::memory_order_release);
+		}
+		_cv.notify_one();
+	}
+
+	void notify_all()
+	{
+		if(!has_waiters())
+			return;
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_epoch.fetch_add(1, std::memory_order_release);
+		}
+		_cv.notify_all();
+	}
+
+private:
+	bool has_waiters() const noexcept
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		return _waiters.load(std::memory_order_seq_cst) != 0;
+	}
+
+	std::atomic<key_t> _epoch{0};
+	std::atomic<std::uint32_t> _waiters{0};
+	std::mutex _mutex;
+	std::condition_variable _cv;
+};
+}
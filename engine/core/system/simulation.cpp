@@ -4,6 +4,7 @@
 
 namespace core
 {
+std::atomic<std::uint64_t> simulation::_frame_epoch{0};
 
 bool simulation::initialize()
 {
@@ -76,6 +77,7 @@ void simulation::run_one_frame()
 	}
 
 	++_frame;
+	_frame_epoch.store(_frame, std::memory_order_release);
 }
 
 void simulation::set_min_fps(unsigned int fps)
@@ -1,7 +1,9 @@
 #pragma once
 
 #include "subsystem.h"
+#include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <vector>
 
 namespace core
@@ -62,6 +64,19 @@ struct simulation : public subsystem
 		return _frame;
 	}
 
+	//-----------------------------------------------------------------------------
+	//  Name : get_frame_epoch (static)
+	/// <summary>
+	/// Same value as get_frame() of the running simulation, published at the
+	/// end of run_one_frame. Cheap enough for hot paths and safe to read from
+	/// any thread.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	static inline std::uint64_t get_frame_epoch()
+	{
+		return _frame_epoch.load(std::memory_order_acquire);
+	}
+
 	//-----------------------------------------------------------------------------
 	//  Name : set_min_fps ()
 	/// <summary>
@@ -136,6 +151,8 @@ protected:
 	duration_t _timestep = duration_t::zero();
 	/// current frame
 	std::uint64_t _frame = 0;
+	/// current frame as seen from get_frame_epoch
+	static std::atomic<std::uint64_t> _frame_epoch;
 	/// how many frames to average for the smoothed time step
 	unsigned int _smoothing_step = 11;
 	/// frame update timer
@@ -13,16 +13,15 @@ void subsystem_context::dispose()
 {
 	for(auto iter = _orders.rbegin(); iter != _orders.rend(); iter++)
 	{
-		auto found = _subsystems.find(*iter);
-		ensures(found != _subsystems.end());
+		auto& found = _subsystems[*iter];
+		ensures(found != nullptr);
 
-		found->second->dispose();
-		found->second.reset();
-		_subsystems.erase(found);
+		found->dispose();
+		found.reset();
 	}
 
 	_orders.clear();
-	ensures(_subsystems.size() == 0);
+	_subsystems.clear();
 }
 
 namespace details
@@ -3,9 +3,9 @@
 #include "../common/assert.hpp"
 #include "../common/nonstd/type_traits.hpp"
 
+#include <algorithm>
 #include <chrono>
 #include <memory>
-#include <unordered_map>
 #include <vector>
 
 namespace core
@@ -112,10 +112,22 @@ struct subsystem_context
 	bool has_subsystems() const;
 
 protected:
-	///
+	//-----------------------------------------------------------------------------
+	//  Name : get_slot (static)
+	/// <summary>
+	/// Sequential slot of the subsystem type, assigned on first use.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	template <typename S>
+	static std::size_t get_slot()
+	{
+		return rtti::type_index_sequential_t::id<subsystem, S>();
+	}
+
+	/// slots in order of creation
 	std::vector<std::size_t> _orders;
-	///
-	std::unordered_map<std::size_t, std::unique_ptr<subsystem>> _subsystems;
+	/// subsystems indexed by their slot, empty slots are null
+	std::vector<std::unique_ptr<subsystem>> _subsystems;
 };
 
 //
@@ -123,12 +135,15 @@ protected:
 template <typename S, typename... Args>
 S& subsystem_context::add_subsystem(Args&&... args)
 {
-	auto index = rtti::type_id<S>().hash_code();
+	const auto index = get_slot<S>();
 	expects(!has_subsystems<S>() && "duplicated subsystem");
 
 	// auto sys = new (std::nothrow) S(std::forward<Args>(args)...);
+	if(_subsystems.size() <= index)
+		_subsystems.resize(index + 1);
+
 	_orders.push_back(index);
-	_subsystems.emplace(std::make_pair(index, std::make_unique<S>(std::forward<Args>(args)...)));
+	_subsystems[index] = std::make_unique<S>(std::forward<Args>(args)...);
 	auto& sys = static_cast<S&>(*_subsystems[index].get());
 	expects(sys.initialize() && "failed to initialize subsystem.");
 
@@ -139,7 +154,7 @@ template <typename S>
 S& subsystem_context::get_subsystem()
 {
 	expects(has_subsystems<S>() && "failed to find system");
-	const auto index = rtti::type_id<S>().hash_code();
+	const auto index = get_slot<S>();
 	return static_cast<S&>(*_subsystems[index].get());
 }
 
@@ -147,16 +162,16 @@ template <typename S>
 void subsystem_context::remove_subsystem()
 {
 	expects(has_subsystems<S>() && "failed to find system");
-	const auto index = rtti::type_id<S>().hash_code();
-	_subsystems.erase(index);
-	_orders.erase(index);
+	const auto index = get_slot<S>();
+	_subsystems[index].reset();
+	_orders.erase(std::remove(std::begin(_orders), std::end(_orders), index), std::end(_orders));
 }
 
 template <typename S>
 bool subsystem_context::has_subsystems() const
 {
-	const auto index = rtti::type_id<S>().hash_code();
-	return _subsystems.find(index) != _subsystems.end();
+	const auto index = get_slot<S>();
+	return index < _subsystems.size() && _subsystems[index] != nullptr;
 }
 
 template <typename S1, typename S2, typename... Args>
@@ -2,15 +2,34 @@
 
 namespace core
 {
+namespace
+{
+thread_local const task_system* tls_owner = nullptr;
+thread_local std::size_t tls_worker_index = task_system::invalid_index;
+thread_local std::uint32_t tls_steal_seed = 0;
+
+std::uint32_t next_victim_seed()
+{
+	// xorshift32
+	auto x = tls_steal_seed;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	tls_steal_seed = x;
+	return x;
+}
+}
+
 awaitable_task::task_concept::~task_concept() noexcept = default;
 
 void task_system::task_queue::rotate_()
 {
 	/* zero or one element list -- trivial to rotate */
-	if(tasks_.empty())
+	if(tasks_.size() < 2)
 		return;
 
-	std::rotate(tasks_.begin(), tasks_.begin() + 1, tasks_.end());
+	tasks_.emplace_back(std::move(tasks_.front()));
+	tasks_.pop_front();
 }
 
 task_system::task_queue::task_queue()
@@ -158,6 +177,257 @@ void task_system::run(std::size_t idx)
 	}
 }
 
+void task_system::run_stealing(std::size_t idx)
+{
+	tls_owner = this;
+	tls_worker_index = idx;
+	tls_steal_seed = static_cast<std::uint32_t>(idx * 2654435761u) | 1u;
+
+	while(true)
+	{
+		if(try_run_one(idx))
+			continue;
+
+		auto key = parker_.prepare_wait();
+		if(done_)
+		{
+			parker_.cancel_wait();
+			return;
+		}
+
+		if(try_run_one(idx))
+		{
+			parker_.cancel_wait();
+			continue;
+		}
+
+		// what is left in the injected queue waits on futures we could not
+		// hook into. Nothing notifies us when they become ready, so sleep
+		// only for a while and poll them again.
+		if(!injected_.is_empty())
+		{
+			parker_.commit_wait_for(key, std::chrono::milliseconds(1));
+			continue;
+		}
+
+		parker_.commit_wait(key);
+	}
+}
+
+bool task_system::try_run_one(std::size_t idx)
+{
+	awaitable_task task;
+	if(!try_get_task(idx, task))
+		return false;
+
+	task();
+	return true;
+}
+
+bool task_system::try_get_task(std::size_t idx, awaitable_task& task)
+{
+	awaitable_task::task_concept* item = nullptr;
+
+	auto& own = *deques_[idx - 1];
+	if(own.pop(item))
+	{
+		task._t.reset(item);
+		if(task.ready())
+			return true;
+
+		// not ready yet, park it where everybody can poll it
+		injected_.push(std::move(task));
+	}
+
+	auto p = injected_.try_pop();
+	if(p.first)
+	{
+		task = std::move(p.second);
+		return true;
+	}
+
+	const auto count = deques_.size();
+	const auto start = next_victim_seed() % count;
+	for(std::size_t k = 0; k < count; ++k)
+	{
+		const auto victim = (start + k) % count;
+		if(victim == idx - 1)
+			continue;
+
+		if(deques_[victim]->steal(item))
+		{
+			task._t.reset(item);
+			if(task.ready())
+				return true;
+
+			injected_.push(std::move(task));
+		}
+	}
+
+	return false;
+}
+
+void task_system::schedule(awaitable_task task)
+{
+	const auto worker_index = get_worker_idx();
+	if(worker_index != invalid_index)
+		deques_[worker_index - 1]->push(task._t.release());
+	else
+		injected_.push(std::move(task));
+
+	parker_.notify_one();
+}
+
+void task_system::enqueue(awaitable_task task)
+{
+	if(nthreads_ == 0)
+	{
+		enqueue_on_main(std::move(task));
+		return;
+	}
+
+	if(mode_ == scheduling_mode::work_stealing)
+	{
+		schedule(std::move(task));
+		return;
+	}
+
+	auto const idx = current_index_++;
+	for(std::size_t k = 0; k < 10 * nthreads_; ++k)
+	{
+		const auto queue_index = get_thread_queue_idx(idx, k);
+		if(queues_[queue_index].try_push(task))
+			return;
+	}
+
+	const auto queue_index = get_thread_queue_idx(idx);
+	queues_[queue_index].push(std::move(task));
+}
+
+void task_system::enqueue_on_main(awaitable_task task)
+{
+	const auto queue_index = get_main_thread_queue_idx();
+	for(std::size_t k = 0; k < 10; ++k)
+	{
+		if(queues_[queue_index].try_push(task))
+			return;
+	}
+
+	queues_[queue_index].push(std::move(task));
+}
+
+bool task_system::defer_until_ready(awaitable_task& task, bool on_main)
+{
+	std::vector<std::shared_ptr<detail::task_state>> dependencies;
+	if(!task.get_dependencies(dependencies))
+	{
+		// awaits something we cannot hook into, fall back to polling
+		polled_count_++;
+		return false;
+	}
+
+	if(dependencies.empty())
+		return false;
+
+	struct deferred_task
+	{
+		std::atomic<std::size_t> pending{0};
+		awaitable_task task;
+		bool on_main = false;
+	};
+
+	auto deferred = std::make_shared<deferred_task>();
+	// +1 keeps the task from being scheduled while we are still registering
+	deferred->pending = dependencies.size() + 1;
+	deferred->task = std::move(task);
+	deferred->on_main = on_main;
+
+	auto release = [this, deferred]() {
+		if(--deferred->pending != 0)
+			return;
+
+		resolved_count_++;
+		if(deferred->on_main)
+			enqueue_on_main(std::move(deferred->task));
+		else
+			enqueue(std::move(deferred->task));
+	};
+
+	for(auto& dependency : dependencies)
+	{
+		if(!dependency->add_continuation(release))
+			release();
+	}
+	release();
+
+	return true;
+}
+
+task_system::stats task_system::get_stats() const
+{
+	stats result;
+	result.resolved = resolved_count_.load();
+	result.polled = polled_count_.load();
+	return result;
+}
+
+std::size_t task_system::get_worker_idx() const
+{
+	return tls_owner == this ? tls_worker_index : invalid_index;
+}
+
+bool task_system::try_help_workers()
+{
+	if(mode_ == scheduling_mode::work_stealing)
+	{
+		auto p = injected_.try_pop();
+		if(p.first)
+		{
+			p.second();
+			return true;
+		}
+
+		for(auto& deque : deques_)
+		{
+			awaitable_task::task_concept* item = nullptr;
+			if(deque->steal(item))
+			{
+				awaitable_task task;
+				task._t.reset(item);
+				if(!task.ready())
+				{
+					injected_.push(std::move(task));
+					continue;
+				}
+
+				task();
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	for(std::size_t idx = 1; idx < queues_.size(); ++idx)
+	{
+		auto p = queues_[idx].try_pop();
+		if(p.first)
+		{
+			p.second();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+std::size_t task_system::get_auto_grain(std::size_t count) const
+{
+	// a few chunks per thread leaves room for balancing uneven work
+	const auto chunks = 4 * (nthreads_ + 1);
+	return std::max<std::size_t>(1, count / chunks);
+}
+
 std::size_t task_system::get_thread_queue_idx(std::size_t idx, std::size_t seed)
 {
 	return ((idx + seed) % nthreads_) + 1;
@@ -174,11 +444,33 @@ task_system::task_system()
 }
 
 task_system::task_system(std::size_t nthreads, const task_system::Allocator& alloc)
+	: task_system(nthreads, scheduling_mode::shared_queues, alloc)
+{
+}
+
+task_system::task_system(std::size_t nthreads, scheduling_mode mode, const task_system::Allocator& alloc)
 	: queues_{}
 	, threads_{}
 	, alloc_(alloc)
 	, nthreads_{nthreads}
+	, mode_{mode}
 {
+	if(mode_ == scheduling_mode::work_stealing)
+	{
+		// only the main thread keeps a locked queue
+		queues_.emplace_back();
+
+		deques_.reserve(nthreads);
+		for(std::size_t th = 0; th < nthreads; ++th)
+			deques_.emplace_back(std::make_unique<task_deque>());
+
+		threads_.reserve(nthreads);
+		for(std::size_t th = 1; th < nthreads + 1; ++th)
+			threads_.emplace_back(&task_system::run_stealing, this, th);
+
+		return;
+	}
+
 	// +1 for the main thread's queue
 	queues_.reserve(nthreads + 1);
 	queues_.emplace_back();
@@ -198,12 +490,23 @@ task_system::~task_system()
 		if(th.joinable())
 			th.join();
 	}
+
+	// release whatever never got the chance to run
+	for(auto& deque : deques_)
+	{
+		awaitable_task::task_concept* item = nullptr;
+		while(deque->steal(item))
+			delete item;
+	}
 }
 
 void core::task_system::dispose()
 {
 	for(auto& q : queues_)
 		q.set_done();
+
+	done_ = true;
+	parker_.notify_all();
 }
 
 void task_system::run_on_main()
@@ -4,7 +4,9 @@
 #include "../common/nonstd/function_traits.hpp"
 #include "../common/nonstd/sequence.hpp"
 #include "../common/nonstd/type_traits.hpp"
+#include "event_count.hpp"
 #include "subsystem.h"
+#include "work_stealing_deque.hpp"
 #include <algorithm>
 #include <atomic>
 #include <chrono>
@@ -13,6 +15,7 @@
 #include <cstdint>
 #include <deque>
 #include <exception>
+#include <functional>
 #include <future>
 #include <memory>
 #include <mutex>
@@ -57,6 +60,58 @@ inline bool is_main_thread()
 {
 	return get_main_thread_id() == std::this_thread::get_id();
 }
+
+/*
+ * task_state; completion state shared between a task and its futures.
+ * Tasks that await the result register continuations here instead of
+ * polling the future.
+ */
+class task_state
+{
+public:
+	using continuation_t = std::function<void()>;
+
+	//-----------------------------------------------------------------------------
+	//  Name : add_continuation ()
+	/// <summary>
+	/// Registers a continuation to run once the task completes. Returns false
+	/// without registering if the task has already completed.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	bool add_continuation(continuation_t continuation)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if(_done)
+			return false;
+
+		_continuations.emplace_back(std::move(continuation));
+		return true;
+	}
+
+	//-----------------------------------------------------------------------------
+	//  Name : set_done ()
+	/// <summary>
+	/// Marks the task as completed and runs all registered continuations.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void set_done()
+	{
+		std::vector<continuation_t> continuations;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_done = true;
+			continuations.swap(_continuations);
+		}
+
+		for(auto& continuation : continuations)
+			continuation();
+	}
+
+private:
+	std::mutex _mutex;
+	std::vector<continuation_t> _continuations;
+	bool _done = false;
+};
 }
 
 template <typename T>
@@ -98,7 +153,45 @@ public:
 
 private:
 	friend class task_system;
+	friend class awaitable_task;
+	template <typename>
+	friend class task_promise;
 	task_system* _system = nullptr;
+	std::shared_ptr<detail::task_state> _state;
+};
+
+/*
+ * task_promise; a result set by hand rather than by running a task.
+ * Its future can be awaited like the future of any task, tasks awaiting
+ * it are scheduled once the value is set.
+ */
+template <typename T>
+class task_promise
+{
+public:
+	task_promise(task_system* system = nullptr)
+		: _state(std::make_shared<detail::task_state>())
+	{
+		_future.future = _promise.get_future().share();
+		_future._system = system;
+		_future._state = _state;
+	}
+
+	task_future<T> get_future() const
+	{
+		return _future;
+	}
+
+	void set_value(T value)
+	{
+		_promise.set_value(std::move(value));
+		_state->set_done();
+	}
+
+private:
+	std::promise<T> _promise;
+	std::shared_ptr<detail::task_state> _state;
+	task_future<T> _future;
 };
 
 template <class>
@@ -328,6 +421,22 @@ public:
 			throw std::logic_error("bad task access");
 	}
 
+	//-----------------------------------------------------------------------------
+	//  Name : get_dependencies ()
+	/// <summary>
+	/// Collects the completion states of the unresolved task_future arguments.
+	/// Returns false if some unresolved argument is not backed by a task and
+	/// can therefore only be polled.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	bool get_dependencies(std::vector<std::shared_ptr<detail::task_state>>& dependencies) const
+	{
+		if(_t)
+			return _t->dependencies_(dependencies);
+		else
+			throw std::logic_error("bad task access");
+	}
+
 private:
 	template <class F, class... Args>
 	awaitable_task(ready_task_tag, F&& f, Args&&... args)
@@ -364,8 +473,13 @@ private:
 		virtual ~task_concept() noexcept;
 		virtual void invoke_() = 0;
 		virtual bool ready_() const noexcept = 0;
+		virtual bool dependencies_(std::vector<std::shared_ptr<detail::task_state>>&) const
+		{
+			return true;
+		}
 
 		const std::uint64_t id = get_next_id();
+		const std::shared_ptr<detail::task_state> state = std::make_shared<detail::task_state>();
 	};
 
 	template <class>
@@ -399,12 +513,14 @@ private:
 		{
 			task_future<R> result;
 			result.future = _f.get_future().share();
+			result._state = state;
 			return result;
 		}
 
 		void invoke_() override
 		{
 			nonstd::apply(_f, _args);
+			state->set_done();
 		}
 
 		bool ready_() const noexcept override
@@ -447,6 +563,7 @@ private:
 		{
 			task_future<R> result;
 			result.future = _f.get_future().share();
+			result._state = state;
 			return result;
 		}
 
@@ -454,6 +571,7 @@ private:
 		{
 			constexpr const std::size_t arity = sizeof...(FutArgs);
 			do_invoke_(nonstd::make_index_sequence<arity>());
+			state->set_done();
 		}
 
 		bool ready_() const noexcept override
@@ -462,6 +580,12 @@ private:
 			return do_ready_(nonstd::make_index_sequence<arity>());
 		}
 
+		bool dependencies_(std::vector<std::shared_ptr<detail::task_state>>& dependencies) const override
+		{
+			constexpr const std::size_t arity = sizeof...(FutArgs);
+			return do_dependencies_(dependencies, nonstd::make_index_sequence<arity>());
+		}
+
 	private:
 		template <class T>
 		static inline auto call_get(T&& t) noexcept -> decltype(std::forward<T>(t))
@@ -526,6 +650,47 @@ private:
 			return nonstd::check_all_true(call_ready(std::get<I>(_args))...);
 		}
 
+		template <class T>
+		static inline bool call_dependencies(std::vector<std::shared_ptr<detail::task_state>>&, const T&)
+		{
+			return true;
+		}
+
+		template <class T>
+		static inline bool call_dependencies(std::vector<std::shared_ptr<detail::task_state>>& dependencies,
+											 const task_future<T>& t)
+		{
+			if(call_ready(t))
+				return true;
+
+			if(!t._state)
+				return false;
+
+			dependencies.emplace_back(t._state);
+			return true;
+		}
+
+		template <class T>
+		static inline bool call_dependencies(std::vector<std::shared_ptr<detail::task_state>>&,
+											 const std::future<T>& t)
+		{
+			return call_ready(t);
+		}
+
+		template <class T>
+		static inline bool call_dependencies(std::vector<std::shared_ptr<detail::task_state>>&,
+											 const std::shared_future<T>& t)
+		{
+			return call_ready(t);
+		}
+
+		template <std::size_t... I>
+		inline bool do_dependencies_(std::vector<std::shared_ptr<detail::task_state>>& dependencies,
+									 nonstd::index_sequence<I...>) const
+		{
+			return nonstd::check_all_true(call_dependencies(dependencies, std::get<I>(_args))...);
+		}
+
 		std::packaged_task<R(CallArgs...)> _f;
 		std::tuple<nonstd::special_decay_t<FutArgs>...> _args;
 	};
@@ -559,14 +724,136 @@ class task_system : public core::subsystem
 		void push(awaitable_task t);
 	};
 
+public:
+	enum class scheduling_mode
+	{
+		/// one locked queue per thread, pushes are spread round-robin
+		shared_queues,
+		/// one lock-free deque per worker, idle workers steal from each other
+		work_stealing
+	};
+
+private:
+	using task_deque = work_stealing_deque<awaitable_task::task_concept*>;
+
 	std::vector<task_queue> queues_;
 	std::vector<std::thread> threads_;
 	typename Allocator::template rebind<awaitable_task::task_concept>::other alloc_;
 	std::size_t nthreads_;
 	std::atomic<std::size_t> current_index_{1};
 
+	scheduling_mode mode_ = scheduling_mode::shared_queues;
+	/// work_stealing only: per worker deques, indexed by worker index - 1
+	std::vector<std::unique_ptr<task_deque>> deques_;
+	/// work_stealing only: tasks pushed from threads that own no deque
+	task_queue injected_;
+	/// work_stealing only: idle workers park here
+	event_count parker_;
+	std::atomic_bool done_{false};
+
+	/// tasks scheduled by a continuation once their dependencies resolved
+	std::atomic<std::uint64_t> resolved_count_{0};
+	/// tasks that had to be queued and polled for readiness
+	std::atomic<std::uint64_t> polled_count_{0};
+
 	void run(std::size_t idx);
 
+	void run_stealing(std::size_t idx);
+
+	bool try_run_one(std::size_t idx);
+
+	bool try_get_task(std::size_t idx, awaitable_task& task);
+
+	void schedule(awaitable_task task);
+
+	void enqueue(awaitable_task task);
+
+	void enqueue_on_main(awaitable_task task);
+
+	bool defer_until_ready(awaitable_task& task, bool on_main);
+
+	std::size_t get_worker_idx() const;
+
+	bool try_help_workers();
+
+	std::size_t get_auto_grain(std::size_t count) const;
+
+	template <typename F>
+	void parallel_for_range(std::size_t begin, std::size_t end, std::size_t grain, const F& f)
+	{
+		// split off the upper half until the chunk is small enough, the
+		// spawned halves keep splitting on whichever thread picks them up
+		std::vector<task_future<void>> spawned;
+		while(end - begin > grain)
+		{
+			const auto mid = begin + (end - begin) / 2;
+			spawned.emplace_back(
+				push_ready([this, mid, end, grain, &f]() { parallel_for_range(mid, end, grain, f); }));
+			end = mid;
+		}
+
+		f(begin, end);
+
+		for(auto& task : spawned)
+		{
+			wait_for_chunk(task);
+			task.get();
+		}
+	}
+
+	template <typename T, typename F, typename R>
+	T parallel_reduce_range(std::size_t begin, std::size_t end, std::size_t grain, const F& f,
+							const R& reduce)
+	{
+		std::vector<task_future<T>> spawned;
+		while(end - begin > grain)
+		{
+			const auto mid = begin + (end - begin) / 2;
+			spawned.emplace_back(push_ready([this, mid, end, grain, &f, &reduce]() {
+				return parallel_reduce_range<T>(mid, end, grain, f, reduce);
+			}));
+			end = mid;
+		}
+
+		T result = f(begin, end);
+
+		// the last spawned range is the one right next to ours
+		for(auto it = spawned.rbegin(); it != spawned.rend(); ++it)
+		{
+			wait_for_chunk(*it);
+			result = reduce(result, it->get());
+		}
+
+		return result;
+	}
+
+	//-----------------------------------------------------------------------------
+	//  Name : wait_for_chunk ()
+	/// <summary>
+	/// Waits for a chunk spawned by parallel_for or parallel_reduce, running
+	/// worker tasks meanwhile. Main thread tasks are left alone even on the
+	/// main thread, they may change what the chunks are reading.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	template <typename T>
+	void wait_for_chunk(const task_future<T>& task)
+	{
+		// without workers the chunks already ran inline
+		if(nthreads_ == 0)
+		{
+			task.wait();
+			return;
+		}
+
+		const auto worker_index = get_worker_idx();
+		while(!task.is_ready())
+		{
+			const bool ran = worker_index != invalid_index ? try_run_one(worker_index) : try_help_workers();
+			if(!ran)
+				std::this_thread::yield();
+		}
+	}
+
 	std::size_t get_thread_queue_idx(std::size_t idx, std::size_t seed = 0);
 
 	std::size_t get_main_thread_queue_idx();
@@ -576,6 +863,8 @@ public:
 
 	task_system(std::size_t nthreads, Allocator const& alloc = Allocator());
 
+	task_system(std::size_t nthreads, scheduling_mode mode, Allocator const& alloc = Allocator());
+
 	//-----------------------------------------------------------------------------
 	//  Name : ~task_system ()
 	/// <summary>
@@ -630,16 +919,7 @@ public:
 			auto t = make_ready_task(std::allocator_arg_t{}, alloc_, std::forward<F>(f),
 									 std::forward<Args>(args)...);
 			t.second._system = this;
-			auto const idx = current_index_++;
-			for(std::size_t k = 0; k < 10 * nthreads_; ++k)
-			{
-				const auto queue_index = get_thread_queue_idx(idx, k);
-				if(queues_[queue_index].try_push(t.first))
-					return std::move(t.second);
-			}
-
-			const auto queue_index = get_thread_queue_idx(idx);
-			queues_[queue_index].push(std::move(t.first));
+			enqueue(std::move(t.first));
 			return std::move(t.second);
 		}
 	}
@@ -667,16 +947,8 @@ public:
 			auto t = make_awaitable_task(std::allocator_arg_t{}, alloc_, std::forward<F>(f),
 										 std::forward<Args>(args)...);
 			t.second._system = this;
-			auto const idx = current_index_++;
-			for(std::size_t k = 0; k < 10 * nthreads_; ++k)
-			{
-				const auto queue_index = get_thread_queue_idx(idx, k);
-				if(queues_[queue_index].try_push(t.first))
-					return std::move(t.second);
-			}
-
-			const auto queue_index = get_thread_queue_idx(idx);
-			queues_[queue_index].push(std::move(t.first));
+			if(!defer_until_ready(t.first, false))
+				enqueue(std::move(t.first));
 			return std::move(t.second);
 		}
 	}
@@ -709,14 +981,7 @@ public:
 		}
 		else
 		{
-			const auto queue_index = get_main_thread_queue_idx();
-			for(std::size_t k = 0; k < 10 * nthreads_; ++k)
-			{
-				if(queues_[queue_index].try_push(t.first))
-					return std::move(t.second);
-			}
-
-			queues_[queue_index].push(std::move(t.first));
+			enqueue_on_main(std::move(t.first));
 			return std::move(t.second);
 		}
 	}
@@ -747,15 +1012,8 @@ public:
 		}
 		else
 		{
-
-			const auto queue_index = get_main_thread_queue_idx();
-			for(std::size_t k = 0; k < 10; ++k)
-			{
-				if(queues_[queue_index].try_push(t.first))
-					return std::move(t.second);
-			}
-
-			queues_[queue_index].push(std::move(t.first));
+			if(!defer_until_ready(t.first, true))
+				enqueue_on_main(std::move(t.first));
 			return std::move(t.second);
 		}
 	}
@@ -768,6 +1026,64 @@ public:
 	//-----------------------------------------------------------------------------
 	void run_on_main();
 
+	struct stats
+	{
+		/// tasks scheduled by a continuation once their dependencies resolved
+		std::uint64_t resolved = 0;
+		/// tasks that had to be queued and polled for readiness
+		std::uint64_t polled = 0;
+	};
+
+	//-----------------------------------------------------------------------------
+	//  Name : get_stats ()
+	/// <summary>
+	/// Returns how awaitable tasks got scheduled so far.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	stats get_stats() const;
+
+	//-----------------------------------------------------------------------------
+	//  Name : parallel_for ()
+	/// <summary>
+	/// Invokes f(chunk_begin, chunk_end) over [begin, end) split into chunks of
+	/// at most grain elements. A grain of 0 picks one from the thread count.
+	/// The range is split recursively so idle threads pick up the larger
+	/// halves, the calling thread works on its own chunk and helps out while
+	/// waiting for the rest.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	template <typename F>
+	void parallel_for(std::size_t begin, std::size_t end, std::size_t grain, F&& f)
+	{
+		if(begin >= end)
+			return;
+
+		if(grain == 0)
+			grain = get_auto_grain(end - begin);
+
+		parallel_for_range(begin, end, grain, f);
+	}
+
+	//-----------------------------------------------------------------------------
+	//  Name : parallel_reduce ()
+	/// <summary>
+	/// Computes f(chunk_begin, chunk_end) over [begin, end) split like
+	/// parallel_for and combines the partial results left to right with
+	/// reduce(lhs, rhs). Returns identity for an empty range.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	template <typename T, typename F, typename R>
+	T parallel_reduce(std::size_t begin, std::size_t end, std::size_t grain, T identity, F&& f, R&& reduce)
+	{
+		if(begin >= end)
+			return identity;
+
+		if(grain == 0)
+			grain = get_auto_grain(end - begin);
+
+		return parallel_reduce_range<T>(begin, end, grain, f, reduce);
+	}
+
 	static constexpr std::size_t invalid_index = 77777;
 
 	template <typename T>
@@ -783,6 +1099,21 @@ public:
 		{
 			queue_index = get_main_thread_queue_idx();
 		}
+		else if(mode_ == scheduling_mode::work_stealing)
+		{
+			const auto worker_index = get_worker_idx();
+			if(worker_index == invalid_index)
+				return false;
+
+			// help out with other work until the result is there
+			while(!task.is_ready())
+			{
+				if(!try_run_one(worker_index))
+					std::this_thread::yield();
+			}
+
+			return true;
+		}
 		else
 		{
 			for(std::size_t i = 0; i < threads_.size(); ++i)
@@ -803,17 +1134,31 @@ public:
 
 		auto& queue = queues_[queue_index];
 
-		while(!queue.is_empty())
+		if(detail::is_main_thread())
 		{
-			p = queue.pop(!detail::is_main_thread());
-			if(!p.first)
-				continue;
+			// continuations of the awaited task may still land on our queue
+			// so keep serving it until the result is there
+			while(!task.is_ready())
+			{
+				p = queue.pop(false);
+				if(p.first)
+					p.second();
+				else if(!try_help_workers())
+					std::this_thread::yield();
+			}
+
+			return true;
+		}
 
+		// the awaited task, or what it waits on, may sit in any of the
+		// queues so help with all of them instead of blocking
+		while(!task.is_ready())
+		{
+			p = queue.try_pop();
 			if(p.first)
 				p.second();
-
-			if(task.is_ready())
-				break;
+			else if(!try_help_workers())
+				std::this_thread::yield();
 		}
 
 		return true;
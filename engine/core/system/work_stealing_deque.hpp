@@ -0,0 +1,144 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace core
+{
+
+// a lock-free single-producer/multi-consumer deque (Chase-Lev).
+// the owning thread pushes and pops at the bottom (LIFO) while any other
+// thread may steal from the top (FIFO). the ring buffer grows on demand
+// and retired rings are kept alive until the deque is destroyed so that
+// concurrent thieves never read freed memory.
+// T must be trivially copyable (typically a raw pointer).
+template <typename T>
+class work_stealing_deque
+{
+	struct ring
+	{
+		explicit ring(std::int64_t cap)
+			: capacity(cap)
+			, mask(cap - 1)
+			, items(new std::atomic<T>[static_cast<std::size_t>(cap)])
+		{
+		}
+
+		T get(std::int64_t i) const noexcept
+		{
+			return items[static_cast<std::size_t>(i & mask)].load(std::memory_order_relaxed);
+		}
+
+		void put(std::int64_t i, T item) noexcept
+		{
+			items[static_cast<std::size_t>(i & mask)].store(item, std::memory_order_relaxed);
+		}
+
+		std::unique_ptr<ring> grow(std::int64_t bottom, std::int64_t top) const
+		{
+			std::unique_ptr<ring> result(new ring(capacity * 2));
+			for(std::int64_t i = top; i != bottom; ++i)
+				result->put(i, get(i));
+			return result;
+		}
+
+		const std::int64_t capacity;
+		const std::int64_t mask;
+		std::unique_ptr<std::atomic<T>[]> items;
+	};
+
+public:
+	// capacity must be a power of two
+	explicit work_stealing_deque(std::int64_t capacity = 1024)
+	{
+		_rings.emplace_back(new ring(capacity));
+		_ring.store(_rings.back().get(), std::memory_order_relaxed);
+	}
+
+	work_stealing_deque(const work_stealing_deque&) = delete;
+	work_stealing_deque& operator=(const work_stealing_deque&) = delete;
+
+	// owner only
+	void push(T item)
+	{
+		const auto b = _bottom.load(std::memory_order_relaxed);
+		const auto t = _top.load(std::memory_order_acquire);
+		auto r = _ring.load(std::memory_order_relaxed);
+
+		if(b - t > r->capacity - 1)
+		{
+			_rings.emplace_back(r->grow(b, t));
+			r = _rings.back().get();
+			_ring.store(r, std::memory_order_release);
+		}
+
+		r->put(b, item);
+		_bottom.store(b + 1, std::memory_order_release);
+	}
+
+	// owner only
+	bool pop(T& item)
+	{
+		const auto b = _bottom.load(std::memory_order_relaxed) - 1;
+		auto r = _ring.load(std::memory_order_relaxed);
+		_bottom.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		auto t = _top.load(std::memory_order_relaxed);
+
+		if(t > b)
+		{
+			// empty
+			_bottom.store(b + 1, std::memory_order_relaxed);
+			return false;
+		}
+
+		item = r->get(b);
+		if(t == b)
+		{
+			// last element, race against thieves
+			const bool won =
+				_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+			_bottom.store(b + 1, std::memory_order_relaxed);
+			return won;
+		}
+
+		return true;
+	}
+
+	// any thread
+	bool steal(T& item)
+	{
+		auto t = _top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		const auto b = _bottom.load(std::memory_order_acquire);
+
+		if(t >= b)
+			return false;
+
+		auto r = _ring.load(std::memory_order_acquire);
+		item = r->get(t);
+		return _top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+	}
+
+	bool empty() const
+	{
+		return size() == 0;
+	}
+
+	std::size_t size() const
+	{
+		const auto b = _bottom.load(std::memory_order_relaxed);
+		const auto t = _top.load(std::memory_order_relaxed);
+		return b > t ? static_cast<std::size_t>(b - t) : 0;
+	}
+
+private:
+	std::atomic<std::int64_t> _top{0};
+	std::atomic<std::int64_t> _bottom{0};
+	std::atomic<ring*> _ring{nullptr};
+	// every ring ever allocated, only touched by the owner
+	std::vector<std::unique_ptr<ring>> _rings;
+};
+}
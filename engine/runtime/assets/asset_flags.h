@@ -15,4 +15,15 @@ enum class load_flags
 	reload,
 	do_not_unload
 };
+
+enum class load_priority
+{
+	/// Needed for the current frame.
+	visible_now,
+	/// Needed soon.
+	prefetch,
+	/// Whenever there is time left.
+	background,
+	count
+};
 }
@@ -1,6 +1,7 @@
 #include "asset_manager.h"
 #include "asset_extensions.h"
 #include "asset_reader.h"
+#include "asset_residency.h"
 #include "asset_writer.h"
 #include "core/graphics/graphics.h"
 
@@ -9,16 +10,20 @@
 #include "../rendering/material.h"
 #include "../rendering/mesh.h"
 #include "../rendering/shader.h"
+#include "../system/engine.h"
 
 namespace runtime
 {
 bool asset_manager::initialize()
 {
+	on_frame_end.connect(this, &asset_manager::frame_end);
+
 	{
 		auto& storage = add_storage<shader>();
 		storage.load_from_file = asset_reader::load_from_file<shader>;
 		storage.load_from_memory = asset_reader::load_from_memory<shader>;
 		storage.load_from_instance = asset_reader::load_from_instance<shader>;
+		storage.get_size = asset_residency::get_size<shader>;
 		storage.rename_asset_file = asset_writer::rename_asset_file<shader>;
 		storage.delete_asset_file = asset_writer::delete_asset_file<shader>;
 	}
@@ -26,6 +31,7 @@ bool asset_manager::initialize()
 		auto& storage = add_storage<texture>();
 		storage.load_from_file = asset_reader::load_from_file<texture>;
 		storage.load_from_instance = asset_reader::load_from_instance<texture>;
+		storage.get_size = asset_residency::get_size<texture>;
 		storage.rename_asset_file = asset_writer::rename_asset_file<texture>;
 		storage.delete_asset_file = asset_writer::delete_asset_file<texture>;
 	}
@@ -33,6 +39,7 @@ bool asset_manager::initialize()
 		auto& storage = add_storage<mesh>();
 		storage.load_from_file = asset_reader::load_from_file<mesh>;
 		storage.load_from_instance = asset_reader::load_from_instance<mesh>;
+		storage.get_size = asset_residency::get_size<mesh>;
 		storage.rename_asset_file = asset_writer::rename_asset_file<mesh>;
 		storage.delete_asset_file = asset_writer::delete_asset_file<mesh>;
 		{
@@ -126,6 +133,7 @@ bool asset_manager::initialize()
 		auto& storage = add_storage<material>();
 		storage.load_from_file = asset_reader::load_from_file<material>;
 		storage.load_from_instance = asset_reader::load_from_instance<material>;
+		storage.get_size = asset_residency::get_size<material>;
 		storage.save_to_file = asset_writer::save_to_file<material>;
 		storage.rename_asset_file = asset_writer::rename_asset_file<material>;
 		storage.delete_asset_file = asset_writer::delete_asset_file<material>;
@@ -139,6 +147,7 @@ bool asset_manager::initialize()
 		auto& storage = add_storage<prefab>();
 		storage.load_from_file = asset_reader::load_from_file<prefab>;
 		storage.load_from_instance = asset_reader::load_from_instance<prefab>;
+		storage.get_size = asset_residency::get_size<prefab>;
 		storage.rename_asset_file = asset_writer::rename_asset_file<prefab>;
 		storage.delete_asset_file = asset_writer::delete_asset_file<prefab>;
 	}
@@ -146,10 +155,26 @@ bool asset_manager::initialize()
 		auto& storage = add_storage<scene>();
 		storage.load_from_file = asset_reader::load_from_file<scene>;
 		storage.load_from_instance = asset_reader::load_from_instance<scene>;
+		storage.get_size = asset_residency::get_size<scene>;
 		storage.rename_asset_file = asset_writer::rename_asset_file<scene>;
 		storage.delete_asset_file = asset_writer::delete_asset_file<scene>;
 	}
 
 	return true;
 }
+
+void asset_manager::dispose()
+{
+	on_frame_end.disconnect(this, &asset_manager::frame_end);
+}
+
+void asset_manager::frame_end(std::chrono::duration<float>)
+{
+	const auto frame = ++_frame;
+	for(auto& pair : _storages)
+	{
+		auto& storage = pair.second;
+		storage->update_residency(frame);
+	}
+}
 }
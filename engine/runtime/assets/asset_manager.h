@@ -1,6 +1,8 @@
 #pragma once
 
+#include <atomic>
 #include <functional>
+#include <queue>
 #include <unordered_map>
 
 #include "core/common/nonstd/type_traits.hpp"
@@ -11,6 +13,8 @@
 #include "asset_extensions.h"
 #include "asset_flags.h"
 #include "asset_handle.h"
+#include "asset_residency.h"
+#include "asset_streamer.h"
 
 namespace runtime
 {
@@ -49,6 +53,15 @@ struct base_storage
 	/// </summary>
 	//-----------------------------------------------------------------------------
 	virtual void clear(const std::string& protocol) = 0;
+
+	//-----------------------------------------------------------------------------
+	//  Name : update_residency (virtual )
+	/// <summary>
+	/// Does one frame worth of residency work, measuring and checking a few
+	/// entries and evicting a few if over budget.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	virtual void update_residency(std::uint64_t frame) = 0;
 };
 
 template <typename T>
@@ -75,7 +88,19 @@ struct asset_storage : public base_storage
 	void clear()
 	{
 		std::lock_guard<std::recursive_mutex> lock(container_mutex);
+		auto& streamer = core::get_subsystem<asset_streamer>();
+		for(const auto& pair : container)
+		{
+			if(!pair.second.is_ready())
+				streamer.cancel(pair.first);
+		}
 		container.clear();
+
+		residency.clear();
+		scan_keys.clear();
+		candidates = candidate_queue_t();
+		stats.cpu_bytes = 0;
+		stats.gpu_bytes = 0;
 	}
 
 	//-----------------------------------------------------------------------------
@@ -89,26 +114,106 @@ struct asset_storage : public base_storage
 	void clear(const std::string& protocol)
 	{
 		std::lock_guard<std::recursive_mutex> lock(container_mutex);
-		auto container_copy = container;
-		for(const auto& pair : container_copy)
+		auto& streamer = core::get_subsystem<asset_streamer>();
+		for(auto it = container.begin(); it != container.end();)
 		{
-			const auto& id = pair.first;
-			const auto& task = pair.second;
+			const auto& id = it->first;
+			const auto& task = it->second;
 
 			if(string_utils::begins_with(id, protocol, true))
 			{
-				task.wait();
-				container.erase(id);
+				// Loads still running finish for whoever holds their
+				// future, nobody gets them from here anymore.
+				if(!task.is_ready())
+					streamer.cancel(id);
+
+				untrack(id);
+				it = container.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+	}
+
+	//-----------------------------------------------------------------------------
+	//  Name : track ()
+	/// <summary>
+	/// Starts tracking the residency of an entry or marks it as used. A
+	/// reloaded entry is measured again once its load completes.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void track(const std::string& key, bool pinned, bool reload, std::uint64_t frame)
+	{
+		std::lock_guard<std::recursive_mutex> lock(container_mutex);
+		auto& entry = residency[key];
+		if(reload && entry.measured)
+		{
+			stats.cpu_bytes -= entry.size.cpu_bytes;
+			stats.gpu_bytes -= entry.size.gpu_bytes;
+			entry.size = asset_size();
+			entry.measured = false;
+		}
+		entry.pinned |= pinned;
+		entry.last_use_frame = frame;
+	}
+
+	//-----------------------------------------------------------------------------
+	//  Name : untrack ()
+	/// <summary>
+	/// Stops tracking the residency of an entry.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void untrack(const std::string& key)
+	{
+		std::lock_guard<std::recursive_mutex> lock(container_mutex);
+		auto it = residency.find(key);
+		if(it != residency.end())
+		{
+			stats.cpu_bytes -= it->second.size.cpu_bytes;
+			stats.gpu_bytes -= it->second.size.gpu_bytes;
+			residency.erase(it);
+		}
+	}
+
+	//-----------------------------------------------------------------------------
+	//  Name : update_residency ()
+	/// <summary>
+	/// Visits the next entries of the current pass over the residency and
+	/// evicts the least recently used unreferenced entries while the type is
+	/// over its budget. Work is bounded per frame, a full pass over many
+	/// assets takes a few frames.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void update_residency(std::uint64_t frame)
+	{
+		std::lock_guard<std::recursive_mutex> lock(container_mutex);
+		if(scan_keys.empty())
+		{
+			scan_keys.reserve(residency.size());
+			for(const auto& pair : residency)
+			{
+				scan_keys.push_back(pair.first);
 			}
 		}
+
+		for(std::size_t i = 0; i < scan_per_frame && !scan_keys.empty(); ++i)
+		{
+			visit(scan_keys.back(), frame);
+			scan_keys.pop_back();
+		}
+
+		evict(frame);
 	}
 
 	/// key, data, size
 	std::function<core::task_future<asset_handle<T>>(const std::string&, const std::uint8_t*, std::uint32_t)>
 		load_from_memory;
 
-	/// key, mode
-	std::function<core::task_future<asset_handle<T>>(const std::string&, asset_handle<T>)> load_from_file;
+	/// key, original, priority
+	std::function<core::task_future<asset_handle<T>>(const std::string&, asset_handle<T>, load_priority)>
+		load_from_file;
 
 	/// key, mode
 	std::function<core::task_future<asset_handle<T>>(const std::string&, std::shared_ptr<T>)>
@@ -123,11 +228,133 @@ struct asset_storage : public base_storage
 	/// key
 	std::function<void(const std::string&)> delete_asset_file;
 
+	/// asset
+	std::function<asset_size(const T&)> get_size;
+
 	/// Storage container
 	request_container_t<T> container;
 
 	/// Mutex
 	std::recursive_mutex container_mutex;
+
+	/// Residency of the entries
+	std::unordered_map<std::string, residency_entry> residency;
+
+	/// Residency totals and budget
+	residency_stats stats;
+
+	/// Entries visited each frame
+	std::size_t scan_per_frame = 64;
+
+	/// Entries evicted at most each frame
+	std::size_t evictions_per_frame = 16;
+
+private:
+	/// last use frame, key
+	using candidate_t = std::pair<std::uint64_t, std::string>;
+	using candidate_queue_t =
+		std::priority_queue<candidate_t, std::vector<candidate_t>, std::greater<candidate_t>>;
+
+	//-----------------------------------------------------------------------------
+	//  Name : is_referenced ()
+	/// <summary>
+	/// Checks if anyone besides the container holds the handle or the asset.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	static bool is_referenced(const asset_handle<T>& handle)
+	{
+		return handle.use_count() > 1 || handle.link->asset.use_count() > 1;
+	}
+
+	//-----------------------------------------------------------------------------
+	//  Name : visit ()
+	/// <summary>
+	/// Measures a completed entry and updates its last use, unreferenced
+	/// entries become eviction candidates.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void visit(const std::string& key, std::uint64_t frame)
+	{
+		auto it = residency.find(key);
+		auto task_it = container.find(key);
+		if(it == residency.end() || task_it == container.end() || !task_it->second.is_ready())
+			return;
+
+		auto& entry = it->second;
+		const auto& handle = task_it->second.get();
+		if(!entry.measured)
+		{
+			if(get_size && handle.link->asset)
+				entry.size = get_size(*handle.link->asset);
+
+			stats.cpu_bytes += entry.size.cpu_bytes;
+			stats.gpu_bytes += entry.size.gpu_bytes;
+			entry.measured = true;
+		}
+
+		if(is_referenced(handle))
+		{
+			entry.last_use_frame = frame;
+		}
+		else if(!entry.pinned && !entry.candidate)
+		{
+			entry.candidate = true;
+			candidates.emplace(entry.last_use_frame, key);
+		}
+	}
+
+	//-----------------------------------------------------------------------------
+	//  Name : evict ()
+	/// <summary>
+	/// Evicts the oldest candidates that are still unreferenced while over
+	/// budget, a few per frame.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void evict(std::uint64_t frame)
+	{
+		std::size_t checked = 0;
+		while(stats.budget > 0 && stats.get_resident_bytes() > stats.budget && !candidates.empty() &&
+			  checked < evictions_per_frame)
+		{
+			const auto candidate = candidates.top();
+			candidates.pop();
+			++checked;
+
+			auto it = residency.find(candidate.second);
+			if(it == residency.end())
+				continue;
+
+			auto& entry = it->second;
+			entry.candidate = false;
+
+			// used again since it became a candidate
+			if(entry.last_use_frame != candidate.first)
+				continue;
+
+			auto task_it = container.find(candidate.second);
+			if(task_it == container.end() || !task_it->second.is_ready())
+				continue;
+
+			if(is_referenced(task_it->second.get()))
+			{
+				entry.last_use_frame = frame;
+				continue;
+			}
+
+			// The asset goes with the last future holding it, a later load
+			// reads it again.
+			++stats.evicted_assets;
+			stats.evicted_bytes += entry.size.cpu_bytes + entry.size.gpu_bytes;
+			untrack(candidate.second);
+			container.erase(task_it);
+		}
+	}
+
+	/// Keys left to visit in the current pass
+	std::vector<std::string> scan_keys;
+
+	/// Unreferenced entries, least recently used first
+	candidate_queue_t candidates;
 };
 
 class asset_manager : public core::subsystem
@@ -135,6 +362,8 @@ class asset_manager : public core::subsystem
 public:
 	bool initialize();
 
+	void dispose();
+
 	//-----------------------------------------------------------------------------
 	//  Name : clear ()
 	/// <summary>
@@ -183,9 +412,32 @@ public:
 		return static_cast<asset_storage<S>&>(*operation.first->second);
 	}
 
+	//-----------------------------------------------------------------------------
+	//  Name : load ()
+	/// <summary>
+	/// Loads an asset, sync loads are streamed as needed right now and async
+	/// ones as prefetches.
+	/// </summary>
+	//-----------------------------------------------------------------------------
 	template <typename T>
 	core::task_future<asset_handle<T>> load(const std::string& key, load_mode mode = load_mode::sync,
 											load_flags flags = load_flags::standard)
+	{
+		const auto priority = mode == load_mode::sync ? load_priority::visible_now : load_priority::prefetch;
+		return load<T>(key, mode, flags, priority);
+	}
+
+	//-----------------------------------------------------------------------------
+	//  Name : load ()
+	/// <summary>
+	/// Loads an asset with the given streaming priority. Loading an asset
+	/// that is still streaming in raises its priority if the new one is
+	/// higher, sync loads always raise it to visible_now.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	template <typename T>
+	core::task_future<asset_handle<T>> load(const std::string& key, load_mode mode, load_flags flags,
+											load_priority priority)
 	{
 		auto& storage = get_storage<T>();
 		// if embedded resource
@@ -195,8 +447,65 @@ public:
 		}
 		else
 		{
-			return load_asset_from_file_impl<T>(key, mode, flags, storage.container_mutex, storage.container,
-												storage.load_from_file);
+			std::lock_guard<std::recursive_mutex> lock(storage.container_mutex);
+			auto& future = load_asset_from_file_impl<T>(key, mode, flags, priority, storage.container_mutex,
+														storage.container, storage.load_from_file);
+			storage.track(key, flags == load_flags::do_not_unload, flags == load_flags::reload, _frame);
+			return future;
+		}
+	}
+
+	//-----------------------------------------------------------------------------
+	//  Name : set_budget ()
+	/// <summary>
+	/// Sets how many bytes over CPU and GPU the assets of a type may take
+	/// before the least recently used unreferenced ones get evicted, 0 for no
+	/// limit. Eviction is spread over frames.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	template <typename T>
+	void set_budget(std::uint64_t bytes)
+	{
+		auto& storage = get_storage<T>();
+
+		std::lock_guard<std::recursive_mutex> lock(storage.container_mutex);
+		storage.stats.budget = bytes;
+	}
+
+	//-----------------------------------------------------------------------------
+	//  Name : get_residency_stats ()
+	/// <summary>
+	/// Returns the residency of the assets of a type.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	template <typename T>
+	residency_stats get_residency_stats()
+	{
+		auto& storage = get_storage<T>();
+
+		std::lock_guard<std::recursive_mutex> lock(storage.container_mutex);
+		auto stats = storage.stats;
+		stats.assets = static_cast<std::uint32_t>(storage.residency.size());
+		return stats;
+	}
+
+	//-----------------------------------------------------------------------------
+	//  Name : set_priority ()
+	/// <summary>
+	/// Changes the streaming priority of an asset that is still loading, e.g.
+	/// lowers it once nothing needs the asset soon anymore.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	template <typename T>
+	void set_priority(const std::string& key, load_priority priority)
+	{
+		auto& storage = get_storage<T>();
+
+		std::lock_guard<std::recursive_mutex> lock(storage.container_mutex);
+		auto it = storage.container.find(key);
+		if(it != storage.container.end() && !it->second.is_ready())
+		{
+			core::get_subsystem<asset_streamer>().set_priority(key, priority);
 		}
 	}
 
@@ -214,8 +523,13 @@ public:
 							 load_mode mode = load_mode::sync, load_flags flags = load_flags::standard)
 	{
 		auto& storage = get_storage<T>();
-		return create_asset_from_memory_impl<T>(key, data, size, mode, flags, storage.container_mutex,
-												storage.container, storage.load_from_memory);
+
+		// there is no file to load it from again
+		std::lock_guard<std::recursive_mutex> lock(storage.container_mutex);
+		auto& future = create_asset_from_memory_impl<T>(key, data, size, mode, flags, storage.container_mutex,
+														storage.container, storage.load_from_memory);
+		storage.track(key, true, false, _frame);
+		return future;
 	}
 
 	template <typename T>
@@ -230,8 +544,13 @@ public:
 																std::shared_ptr<T> entry)
 	{
 		auto& storage = get_storage<T>();
-		return load_asset_from_instance_impl(key, entry, storage.container_mutex, storage.container,
-											 storage.load_from_instance);
+
+		// there is no file to load it from again
+		std::lock_guard<std::recursive_mutex> lock(storage.container_mutex);
+		auto& future = load_asset_from_instance_impl(key, entry, storage.container_mutex, storage.container,
+													 storage.load_from_instance);
+		storage.track(key, true, true, _frame);
+		return future;
 	}
 
 	template <typename T>
@@ -246,10 +565,22 @@ public:
 		if(it != storage.container.end())
 		{
 			auto& future = it->second;
+			if(!future.is_ready())
+				core::get_subsystem<asset_streamer>().promote(key, load_priority::visible_now);
+
 			auto asset = future.get();
 			asset.link->id = new_key;
 			storage.container[new_key] = future;
 			storage.container.erase(it);
+
+			auto residency_it = storage.residency.find(key);
+			if(residency_it != storage.residency.end())
+			{
+				auto entry = residency_it->second;
+				entry.candidate = false;
+				storage.residency.erase(residency_it);
+				storage.residency[new_key] = entry;
+			}
 		}
 	}
 
@@ -263,12 +594,15 @@ public:
 		if(it != storage.container.end())
 		{
 			auto& future = it->second;
+			if(!future.is_ready())
+				core::get_subsystem<asset_streamer>().cancel(key);
 
 			auto asset = future.get();
 			asset.link->asset.reset();
 			asset.link->id.clear();
 
 			storage.container.erase(it);
+			storage.untrack(key);
 		}
 	}
 	//-----------------------------------------------------------------------------
@@ -306,6 +640,14 @@ public:
 	}
 
 private:
+	//-----------------------------------------------------------------------------
+	//  Name : frame_end ()
+	/// <summary>
+	/// Advances the residency of all storages by a frame.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void frame_end(std::chrono::duration<float>);
+
 	//-----------------------------------------------------------------------------
 	//  Name : load_asset_from_file_impl ()
 	/// <summary>
@@ -317,8 +659,8 @@ private:
 	template <typename T, typename F>
 	core::task_future<asset_handle<T>>&
 	load_asset_from_file_impl(const std::string& key, load_mode mode, load_flags flags,
-							  std::recursive_mutex& container_mutex, request_container_t<T>& container,
-							  F&& load_func)
+							  load_priority priority, std::recursive_mutex& container_mutex,
+							  request_container_t<T>& container, F&& load_func)
 	{
 		std::lock_guard<std::recursive_mutex> lock(container_mutex);
 		auto it = container.find(key);
@@ -329,7 +671,16 @@ private:
 			{
 				asset_handle<T> original = future.get();
 				if(load_func)
-					future = load_func(key, original);
+					future = load_func(key, original, priority);
+			}
+			else if(!future.is_ready())
+			{
+				// uploads held back by the frame budget would never come
+				// while we wait for them
+				if(mode == load_mode::sync)
+					priority = load_priority::visible_now;
+
+				core::get_subsystem<asset_streamer>().promote(key, priority);
 			}
 
 			if(mode == load_mode::sync)
@@ -345,7 +696,7 @@ private:
 			// Dispatch the loading
 			asset_handle<T> original;
 			if(load_func)
-				future = load_func(key, original);
+				future = load_func(key, original, priority);
 
 			return future;
 		}
@@ -432,5 +783,7 @@ private:
 	}
 	/// Different storages
 	std::unordered_map<std::size_t, std::unique_ptr<base_storage>> _storages;
+	/// Frames since startup, the clock of the residency
+	std::atomic<std::uint64_t> _frame{0};
 };
 }
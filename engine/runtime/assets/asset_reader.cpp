@@ -11,38 +11,103 @@
 #include "../rendering/uniform.h"
 #include "../rendering/vertex_buffer.h"
 #include "asset_extensions.h"
+#include "asset_streamer.h"
+#include "core/filesystem/archive.h"
 #include "core/filesystem/filesystem.h"
+#include "core/filesystem/memory_stream.h"
 #include "core/serialization/associative_archive.h"
 #include "core/serialization/binary_archive.h"
 #include "core/serialization/serialization.h"
 #include "core/serialization/types/map.hpp"
 #include "core/serialization/types/vector.hpp"
+#include <atomic>
 #include <cstdint>
 
 namespace runtime
 {
 namespace asset_reader
 {
+namespace
+{
+struct loader_counters
+{
+	std::atomic<std::uint64_t> files{0};
+	std::atomic<std::uint64_t> bytes_read{0};
+	std::atomic<std::uint64_t> bytes_copied{0};
+};
+
+template <typename T>
+loader_counters& get_counters()
+{
+	static loader_counters counters;
+	return counters;
+}
+
+template <typename T>
+void count_read(std::uint64_t bytes_read, std::uint64_t bytes_copied)
+{
+	auto& counters = get_counters<T>();
+	++counters.files;
+	counters.bytes_read += bytes_read;
+	counters.bytes_copied += bytes_copied;
+}
+
+void release_bytes(void*, void* user_data)
+{
+	delete static_cast<fs::byte_array_t*>(user_data);
+}
+
+const gfx::Memory* make_ref(fs::byte_array_t&& bytes)
+{
+	// The renderer takes the bytes as they were read and frees them once
+	// it is done with them, from whatever thread it is on.
+	auto owned = new fs::byte_array_t(std::move(bytes));
+	return gfx::makeRef(owned->data(), static_cast<std::uint32_t>(owned->size()), release_bytes, owned);
+}
+}
+
+template <typename T>
+loader_stats get_stats()
+{
+	const auto& counters = get_counters<T>();
+	loader_stats stats;
+	stats.files = counters.files;
+	stats.bytes_read = counters.bytes_read;
+	stats.bytes_copied = counters.bytes_copied;
+	return stats;
+}
+
+template loader_stats get_stats<texture>();
+template loader_stats get_stats<shader>();
+template loader_stats get_stats<mesh>();
+template loader_stats get_stats<material>();
+template loader_stats get_stats<prefab>();
+template loader_stats get_stats<scene>();
+
 template <>
 core::task_future<asset_handle<texture>> load_from_file<texture>(const std::string& key,
-																 asset_handle<texture> original)
+																 asset_handle<texture> original,
+																 load_priority priority)
 {
-	fs::path absolute_key = fs::absolute(fs::resolve_protocol(key).string());
-	auto compiled_absolute_key = absolute_key.string() + extensions::get_compiled_format<texture>();
+	auto compiled_key = key + extensions::get_compiled_format<texture>();
 	auto read_memory = std::make_shared<fs::byte_array_t>();
 
-	auto read_memory_func = [read_memory, compiled_absolute_key]() {
+	auto read_memory_func = [read_memory, compiled_key](std::uint64_t& upload_size) {
 		if(!read_memory)
 			return false;
 
-		auto stream = std::ifstream{compiled_absolute_key, std::ios::in | std::ios::binary};
-		*read_memory = fs::read_stream(stream);
+		fs::read_file(compiled_key, *read_memory);
+		count_read<texture>(read_memory->size(), 0);
+		upload_size = read_memory->size();
 
 		return true;
 	};
 
 	auto create_resource_func = [ result = original, read_memory, key ](bool read_result) mutable
 	{
+		// if the read failed or was cancelled
+		if(!read_result)
+			return result;
 		// if someone destroyed our memory
 		if(!read_memory)
 			return result;
@@ -50,9 +115,7 @@ core::task_future<asset_handle<texture>> load_from_file<texture>(const std::stri
 		if(read_memory->empty())
 			return result;
 
-		const gfx::Memory* mem =
-			gfx::copy(read_memory->data(), static_cast<std::uint32_t>(read_memory->size()));
-		read_memory->clear();
+		const gfx::Memory* mem = make_ref(std::move(*read_memory));
 		read_memory.reset();
 
 		if(nullptr != mem)
@@ -65,32 +128,37 @@ core::task_future<asset_handle<texture>> load_from_file<texture>(const std::stri
 	};
 
 	auto& ts = core::get_subsystem<core::task_system>();
+	auto& streamer = core::get_subsystem<asset_streamer>();
 
-	auto ready_memory_task = ts.push_ready(read_memory_func);
+	auto ready_memory_task = streamer.push(key, priority, read_memory_func);
 	auto create_resource_task = ts.push_awaitable_on_main(create_resource_func, ready_memory_task);
 	return create_resource_task;
 }
 
 template <>
 core::task_future<asset_handle<shader>> load_from_file<shader>(const std::string& key,
-															   asset_handle<shader> original)
+															   asset_handle<shader> original,
+															   load_priority priority)
 {
-	fs::path absolute_key = fs::absolute(fs::resolve_protocol(key).string());
-	auto compiled_absolute_key = absolute_key.string() + extensions::get_compiled_format<shader>();
+	auto compiled_key = key + extensions::get_compiled_format<shader>();
 	auto read_memory = std::make_shared<fs::byte_array_t>();
 
-	auto read_memory_func = [read_memory, compiled_absolute_key]() {
+	auto read_memory_func = [read_memory, compiled_key](std::uint64_t& upload_size) {
 		if(!read_memory)
 			return false;
 
-		auto stream = std::ifstream{compiled_absolute_key, std::ios::in | std::ios::binary};
-		*read_memory = fs::read_stream(stream);
+		fs::read_file(compiled_key, *read_memory);
+		count_read<shader>(read_memory->size(), 0);
+		upload_size = read_memory->size();
 
 		return true;
 	};
 
 	auto create_resource_func = [ result = original, read_memory, key ](bool read_result) mutable
 	{
+		// if the read failed or was cancelled
+		if(!read_result)
+			return result;
 		// if someone destroyed our memory
 		if(!read_memory)
 			return result;
@@ -98,9 +166,7 @@ core::task_future<asset_handle<shader>> load_from_file<shader>(const std::string
 		if(read_memory->empty())
 			return result;
 
-		const gfx::Memory* mem =
-			gfx::copy(read_memory->data(), static_cast<std::uint32_t>(read_memory->size()));
-		read_memory->clear();
+		const gfx::Memory* mem = make_ref(std::move(*read_memory));
 		read_memory.reset();
 
 		if(nullptr != mem)
@@ -129,18 +195,19 @@ core::task_future<asset_handle<shader>> load_from_file<shader>(const std::string
 	};
 
 	auto& ts = core::get_subsystem<core::task_system>();
+	auto& streamer = core::get_subsystem<asset_streamer>();
 
-	auto ready_memory_task = ts.push_ready(read_memory_func);
+	auto ready_memory_task = streamer.push(key, priority, read_memory_func);
 	auto create_resource_task = ts.push_awaitable_on_main(create_resource_func, ready_memory_task);
 	return create_resource_task;
 }
 
 template <>
 core::task_future<asset_handle<mesh>> load_from_file<mesh>(const std::string& key,
-														   asset_handle<mesh> original)
+														   asset_handle<mesh> original,
+														   load_priority priority)
 {
-	fs::path absolute_key = fs::absolute(fs::resolve_protocol(key).string());
-	auto compiled_absolute_key = absolute_key.string() + extensions::get_compiled_format<mesh>();
+	auto compiled_key = key + extensions::get_compiled_format<mesh>();
 
 	struct wrapper_t
 	{
@@ -149,16 +216,28 @@ core::task_future<asset_handle<mesh>> load_from_file<mesh>(const std::string& ke
 
 	auto wrapper = std::make_shared<wrapper_t>();
 	wrapper->mesh = std::make_shared<mesh>();
-	auto read_memory_func = [wrapper, compiled_absolute_key]() mutable {
-		mesh::load_data data;
+	auto read_memory_func = [wrapper, compiled_key](std::uint64_t& upload_size) mutable {
+		fs::byte_array_t read_memory;
+		if(!fs::read_file(compiled_key, read_memory))
 		{
-			std::ifstream stream{compiled_absolute_key, std::ios::in | std::ios::binary};
+			return false;
+		}
+		upload_size = read_memory.size();
 
-			if(stream.bad())
-			{
-				return false;
-			}
+		// Compiled blobs are restored without any preparation.
+		const auto blob = reinterpret_cast<const std::uint8_t*>(read_memory.data());
+		if(mesh::is_blob(blob, read_memory.size()))
+		{
+			// The mesh keeps its own system copy of the buffers.
+			count_read<mesh>(read_memory.size(), read_memory.size());
+			return wrapper->mesh->read_blob(blob, read_memory.size());
+		}
 
+		// Assets compiled before the blob format.
+		mesh::load_data data;
+		{
+			count_read<mesh>(read_memory.size(), read_memory.size());
+			fs::memory_stream stream(std::move(read_memory));
 			cereal::iarchive_binary_t ar(stream);
 
 			try_load(ar, cereal::make_nvp("mesh", data));
@@ -194,18 +273,19 @@ core::task_future<asset_handle<mesh>> load_from_file<mesh>(const std::string& ke
 	};
 
 	auto& ts = core::get_subsystem<core::task_system>();
+	auto& streamer = core::get_subsystem<asset_streamer>();
 
-	auto ready_memory_task = ts.push_ready(read_memory_func);
+	auto ready_memory_task = streamer.push(key, priority, read_memory_func);
 	auto create_resource_task = ts.push_awaitable_on_main(create_resource_func, ready_memory_task);
 	return create_resource_task;
 }
 
 template <>
 core::task_future<asset_handle<material>> load_from_file<material>(const std::string& key,
-																   asset_handle<material> original)
+																   asset_handle<material> original,
+																   load_priority priority)
 {
-	fs::path absolute_key = fs::absolute(fs::resolve_protocol(key).string());
-	auto compiled_absolute_key = absolute_key.string() + extensions::get_compiled_format<material>();
+	auto compiled_key = key + extensions::get_compiled_format<material>();
 
 	struct wrapper_t
 	{
@@ -215,13 +295,15 @@ core::task_future<asset_handle<material>> load_from_file<material>(const std::st
 	auto wrapper = std::make_shared<wrapper_t>();
 	wrapper->material = std::make_shared<material>();
 
-	auto read_memory_func = [wrapper, compiled_absolute_key]() mutable {
-		std::ifstream stream{compiled_absolute_key, std::ios::in | std::ios::binary};
-
-		if(stream.bad())
+	auto read_memory_func = [wrapper, compiled_key](std::uint64_t&) mutable {
+		fs::byte_array_t read_memory;
+		if(!fs::read_file(compiled_key, read_memory))
 		{
 			return false;
 		}
+		count_read<material>(read_memory.size(), 0);
+
+		fs::memory_stream stream(std::move(read_memory));
 		cereal::iarchive_associative_t ar(stream);
 
 		try_load(ar, cereal::make_nvp("material", wrapper->material));
@@ -231,47 +313,52 @@ core::task_future<asset_handle<material>> load_from_file<material>(const std::st
 
 	auto create_resource_func = [ result = original, wrapper, key ](bool read_result) mutable
 	{
-		result.link->id = key;
-		result.link->asset = wrapper->material;
+		if(read_result)
+		{
+			result.link->id = key;
+			result.link->asset = wrapper->material;
+		}
 		wrapper.reset();
 
 		return result;
 	};
 
 	auto& ts = core::get_subsystem<core::task_system>();
+	auto& streamer = core::get_subsystem<asset_streamer>();
 
-	auto ready_memory_task = ts.push_ready(read_memory_func);
+	auto ready_memory_task = streamer.push(key, priority, read_memory_func);
 	auto create_resource_task = ts.push_awaitable_on_main(create_resource_func, ready_memory_task);
 	return create_resource_task;
 }
 
 template <>
 core::task_future<asset_handle<prefab>> load_from_file<prefab>(const std::string& key,
-															   asset_handle<prefab> original)
+															   asset_handle<prefab> original,
+															   load_priority priority)
 {
-	fs::path absolute_key = fs::absolute(fs::resolve_protocol(key).string());
-	auto compiled_absolute_key = absolute_key.string() + extensions::get_compiled_format<prefab>();
+	auto compiled_key = key + extensions::get_compiled_format<prefab>();
 
-	std::shared_ptr<std::istringstream> read_memory = std::make_shared<std::istringstream>();
-
-	auto read_memory_func = [read_memory, compiled_absolute_key]() {
-		if(!read_memory)
-			return false;
+	struct wrapper_t
+	{
+		std::shared_ptr<std::istream> data;
+	};
 
-		auto stream =
-			std::fstream{compiled_absolute_key, std::fstream::in | std::fstream::out | std::ios::binary};
-		auto mem = fs::read_stream(stream);
-		*read_memory = std::istringstream(std::string(mem.data(), mem.size()));
+	auto wrapper = std::make_shared<wrapper_t>();
+	auto read_memory_func = [wrapper, compiled_key](std::uint64_t&) {
+		fs::byte_array_t mem;
+		fs::read_file(compiled_key, mem);
+		count_read<prefab>(mem.size(), 0);
+		wrapper->data = std::make_shared<fs::memory_stream>(std::move(mem));
 
 		return true;
 	};
 
-	auto create_resource_func = [ result = original, read_memory, key ](bool read_result) mutable
+	auto create_resource_func = [ result = original, wrapper, key ](bool read_result) mutable
 	{
 		if(read_result)
 		{
 			auto pfab = std::make_shared<prefab>();
-			pfab->data = read_memory;
+			pfab->data = wrapper->data;
 
 			result.link->id = key;
 			result.link->asset = pfab;
@@ -281,39 +368,41 @@ core::task_future<asset_handle<prefab>> load_from_file<prefab>(const std::string
 	};
 
 	auto& ts = core::get_subsystem<core::task_system>();
+	auto& streamer = core::get_subsystem<asset_streamer>();
 
-	auto ready_memory_task = ts.push_ready(read_memory_func);
+	auto ready_memory_task = streamer.push(key, priority, read_memory_func);
 	auto create_resource_task = ts.push_awaitable_on_main(create_resource_func, ready_memory_task);
 	return create_resource_task;
 }
 
 template <>
 core::task_future<asset_handle<scene>> load_from_file<scene>(const std::string& key,
-															 asset_handle<scene> original)
+															 asset_handle<scene> original,
+															 load_priority priority)
 {
-	fs::path absolute_key = fs::absolute(fs::resolve_protocol(key).string());
-	auto compiled_absolute_key = absolute_key.string() + extensions::get_compiled_format<scene>();
+	auto compiled_key = key + extensions::get_compiled_format<scene>();
 
-	std::shared_ptr<std::istringstream> read_memory = std::make_shared<std::istringstream>();
-
-	auto read_memory_func = [read_memory, compiled_absolute_key]() {
-		if(!read_memory)
-			return false;
+	struct wrapper_t
+	{
+		std::shared_ptr<std::istream> data;
+	};
 
-		auto stream =
-			std::fstream{compiled_absolute_key, std::fstream::in | std::fstream::out | std::ios::binary};
-		auto mem = fs::read_stream(stream);
-		*read_memory = std::istringstream(std::string(mem.data(), mem.size()));
+	auto wrapper = std::make_shared<wrapper_t>();
+	auto read_memory_func = [wrapper, compiled_key](std::uint64_t&) {
+		fs::byte_array_t mem;
+		fs::read_file(compiled_key, mem);
+		count_read<scene>(mem.size(), 0);
+		wrapper->data = std::make_shared<fs::memory_stream>(std::move(mem));
 
 		return true;
 	};
 
-	auto create_resource_func = [ result = original, read_memory, key ](bool read_result) mutable
+	auto create_resource_func = [ result = original, wrapper, key ](bool read_result) mutable
 	{
 		if(read_result)
 		{
 			auto sc = std::make_shared<scene>();
-			sc->data = read_memory;
+			sc->data = wrapper->data;
 
 			result.link->id = key;
 			result.link->asset = sc;
@@ -323,8 +412,9 @@ core::task_future<asset_handle<scene>> load_from_file<scene>(const std::string&
 	};
 
 	auto& ts = core::get_subsystem<core::task_system>();
+	auto& streamer = core::get_subsystem<asset_streamer>();
 
-	auto ready_memory_task = ts.push_ready(read_memory_func);
+	auto ready_memory_task = streamer.push(key, priority, read_memory_func);
 	auto create_resource_task = ts.push_awaitable_on_main(create_resource_func, ready_memory_task);
 	return create_resource_task;
 }
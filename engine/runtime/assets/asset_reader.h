@@ -1,4 +1,5 @@
 #pragma once
+#include "asset_flags.h"
 #include "asset_handle.h"
 #include "core/filesystem/filesystem.h"
 #include "core/system/task_system.h"
@@ -7,8 +8,29 @@ namespace runtime
 {
 namespace asset_reader
 {
+//-----------------------------------------------------------------------------
+//  Name : loader_stats (Struct)
+/// <summary>
+/// Counters of the files loaded for an asset type since startup.
+/// </summary>
+//-----------------------------------------------------------------------------
+struct loader_stats
+{
+	/// Compiled files read.
+	std::uint64_t files = 0;
+	/// Bytes read from the files.
+	std::uint64_t bytes_read = 0;
+	/// Bytes copied again after reading, before the renderer or the
+	/// deserializer gets them.
+	std::uint64_t bytes_copied = 0;
+};
+
+template <typename T>
+extern loader_stats get_stats();
+
 template <typename T>
-extern core::task_future<asset_handle<T>> load_from_file(const std::string& key, asset_handle<T> original);
+extern core::task_future<asset_handle<T>> load_from_file(const std::string& key, asset_handle<T> original,
+														 load_priority priority);
 
 template <typename T>
 extern core::task_future<asset_handle<T>> load_from_memory(const std::string& key, const std::uint8_t* data,
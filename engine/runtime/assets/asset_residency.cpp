@@ -0,0 +1,80 @@
+#include "asset_residency.h"
+#include "../ecs/prefab.h"
+#include "../ecs/scene.h"
+#include "../rendering/material.h"
+#include "../rendering/mesh.h"
+#include "../rendering/shader.h"
+#include "../rendering/texture.h"
+#include "core/filesystem/memory_stream.h"
+
+namespace runtime
+{
+namespace asset_residency
+{
+namespace
+{
+std::uint64_t get_stream_size(const std::shared_ptr<std::istream>& data)
+{
+	// loaded data is read into a memory stream and kept until instantiated
+	auto stream = dynamic_cast<const fs::memory_stream*>(data.get());
+	return stream ? stream->size() : 0;
+}
+}
+
+template <>
+asset_size get_size<texture>(const texture& asset)
+{
+	asset_size size;
+	// the bytes read are handed to the renderer, only the texture remains
+	size.gpu_bytes = asset.info.storageSize;
+	return size;
+}
+
+template <>
+asset_size get_size<shader>(const shader& asset)
+{
+	asset_size size;
+	size.cpu_bytes = sizeof(shader) + asset.uniforms.size() * sizeof(uniform);
+	return size;
+}
+
+template <>
+asset_size get_size<mesh>(const mesh& asset)
+{
+	const std::uint64_t vertices =
+		std::uint64_t(asset.get_vertex_count()) * asset.get_vertex_format().getStride();
+	const std::uint64_t indices = std::uint64_t(asset.get_face_count()) * 3 * sizeof(std::uint32_t);
+
+	// the mesh keeps its system buffers next to the hardware ones
+	asset_size size;
+	size.cpu_bytes = vertices + indices;
+	if(asset.get_status() == mesh_status::prepared)
+		size.gpu_bytes = vertices + indices;
+	return size;
+}
+
+template <>
+asset_size get_size<material>(const material& asset)
+{
+	asset_size size;
+	size.cpu_bytes = sizeof(asset);
+	return size;
+}
+
+template <>
+asset_size get_size<prefab>(const prefab& asset)
+{
+	asset_size size;
+	size.cpu_bytes = get_stream_size(asset.data);
+	return size;
+}
+
+template <>
+asset_size get_size<scene>(const scene& asset)
+{
+	asset_size size;
+	size.cpu_bytes = get_stream_size(asset.data);
+	return size;
+}
+}
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+
+namespace runtime
+{
+//-----------------------------------------------------------------------------
+//  Name : asset_size (Struct)
+/// <summary>
+/// Memory an asset takes on the CPU and on the GPU.
+/// </summary>
+//-----------------------------------------------------------------------------
+struct asset_size
+{
+	std::uint64_t cpu_bytes = 0;
+	std::uint64_t gpu_bytes = 0;
+};
+
+//-----------------------------------------------------------------------------
+//  Name : residency_entry (Struct)
+/// <summary>
+/// What the asset manager knows about a loaded asset to decide when it
+/// can go.
+/// </summary>
+//-----------------------------------------------------------------------------
+struct residency_entry
+{
+	asset_size size;
+	/// Last frame the asset was loaded or found referenced.
+	std::uint64_t last_use_frame = 0;
+	/// Never evicted, e.g. assets created in memory that can not be loaded
+	/// again or assets loaded with load_flags::do_not_unload.
+	bool pinned = false;
+	/// Size is known, it is measured once the load completes.
+	bool measured = false;
+	/// Waiting among the eviction candidates.
+	bool candidate = false;
+};
+
+//-----------------------------------------------------------------------------
+//  Name : residency_stats (Struct)
+/// <summary>
+/// Residency of the assets of one type.
+/// </summary>
+//-----------------------------------------------------------------------------
+struct residency_stats
+{
+	/// Tracked assets.
+	std::uint32_t assets = 0;
+	std::uint64_t cpu_bytes = 0;
+	std::uint64_t gpu_bytes = 0;
+	/// Bytes over CPU and GPU the type may take, 0 for no limit.
+	std::uint64_t budget = 0;
+	/// Evictions since startup.
+	std::uint64_t evicted_assets = 0;
+	std::uint64_t evicted_bytes = 0;
+
+	std::uint64_t get_resident_bytes() const
+	{
+		return cpu_bytes + gpu_bytes;
+	}
+};
+
+namespace asset_residency
+{
+//-----------------------------------------------------------------------------
+//  Name : get_size ()
+/// <summary>
+/// Measures a loaded asset.
+/// </summary>
+//-----------------------------------------------------------------------------
+template <typename T>
+extern asset_size get_size(const T& asset);
+}
+}
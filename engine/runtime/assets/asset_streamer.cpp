@@ -0,0 +1,365 @@
+#include "asset_streamer.h"
+#include "../system/engine.h"
+#include <algorithm>
+
+namespace runtime
+{
+void latency_histogram::add(std::chrono::duration<float, std::milli> latency)
+{
+	const float ms = latency.count();
+	std::size_t bucket = 0;
+	while(bucket + 1 < bucket_count && ms >= float(1u << bucket))
+	{
+		++bucket;
+	}
+
+	++buckets[bucket];
+	++count;
+	total_ms += ms;
+	max_ms = std::max(max_ms, ms);
+}
+
+bool asset_streamer::initialize()
+{
+	on_frame_begin.connect(this, &asset_streamer::frame_begin);
+
+	return true;
+}
+
+void asset_streamer::dispose()
+{
+	on_frame_begin.disconnect(this, &asset_streamer::frame_begin);
+
+	std::vector<request_ptr> finished;
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		_disposed = true;
+
+		std::vector<request_ptr> requests;
+		for(const auto& pair : _requests)
+		{
+			requests.push_back(pair.second);
+		}
+
+		for(auto& r : requests)
+		{
+			r->cancelled = true;
+			if(r->state != request_state::reading)
+			{
+				finish(r, false, finished);
+			}
+		}
+
+		for(auto& queue : _queued)
+		{
+			queue.clear();
+		}
+		for(auto& queue : _uploads)
+		{
+			queue.clear();
+		}
+
+		// Running reads come back to us on the workers, which outlive this
+		// subsystem, so they have to be done before it goes away.
+		_reads_done.wait(lock, [this]() { return _in_flight == 0; });
+	}
+	resolve(finished);
+}
+
+core::task_future<bool> asset_streamer::push(const std::string& key, load_priority priority,
+											 read_func_t read_func)
+{
+	auto& ts = core::get_subsystem<core::task_system>();
+
+	auto r = std::make_shared<request>(&ts);
+	r->key = key;
+	r->priority = priority;
+	r->read_func = std::move(read_func);
+	r->queued_at = clock_t::now();
+
+	auto future = r->promise.get_future();
+
+	std::vector<request_ptr> reads;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if(_disposed)
+		{
+			r->promise.set_value(false);
+			return future;
+		}
+
+		_queued[std::size_t(priority)].push_back(r);
+		_requests.emplace(key, r);
+		take_reads(reads);
+	}
+	start(reads);
+
+	return future;
+}
+
+void asset_streamer::set_priority(const std::string& key, load_priority priority)
+{
+	move(key, priority, false);
+}
+
+void asset_streamer::promote(const std::string& key, load_priority priority)
+{
+	move(key, priority, true);
+}
+
+void asset_streamer::cancel(const std::string& key)
+{
+	std::vector<request_ptr> finished;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		for(auto& r : find(key))
+		{
+			if(r->cancelled)
+				continue;
+
+			r->cancelled = true;
+			++_stats.cancelled;
+
+			// a running read finishes as cancelled
+			if(r->state == request_state::queued)
+			{
+				remove(_queued[std::size_t(r->priority)], r);
+				finish(r, false, finished);
+			}
+			else if(r->state == request_state::uploading)
+			{
+				remove(_uploads[std::size_t(r->priority)], r);
+				finish(r, false, finished);
+			}
+		}
+	}
+	resolve(finished);
+}
+
+void asset_streamer::set_max_in_flight(std::uint32_t count)
+{
+	std::vector<request_ptr> reads;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_max_in_flight = std::max(count, 1u);
+		take_reads(reads);
+	}
+	start(reads);
+}
+
+void asset_streamer::set_upload_budget(std::uint64_t bytes)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_upload_budget = bytes;
+}
+
+asset_streamer_stats asset_streamer::get_stats() const
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	auto stats = _stats;
+	for(std::size_t i = 0; i < asset_streamer_stats::priority_count; ++i)
+	{
+		stats.queued[i] = static_cast<std::uint32_t>(_queued[i].size());
+		stats.uploads[i] = static_cast<std::uint32_t>(_uploads[i].size());
+	}
+	stats.in_flight = _in_flight;
+	return stats;
+}
+
+void asset_streamer::frame_begin(std::chrono::duration<float>)
+{
+	std::vector<request_ptr> finished;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stats.uploaded_bytes = _frame_uploaded;
+		_frame_uploaded = 0;
+
+		// the first upload of a frame always goes so big assets still get
+		// through a small budget, even one of zero bytes
+		bool uploaded_any = false;
+		for(auto& queue : _uploads)
+		{
+			while(!queue.empty() && (!uploaded_any || _frame_uploaded < _upload_budget))
+			{
+				auto r = queue.front();
+				queue.pop_front();
+				finish(r, true, finished);
+				uploaded_any = true;
+			}
+		}
+	}
+	resolve(finished);
+}
+
+void asset_streamer::read(request_ptr r)
+{
+	bool cancelled = false;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		cancelled = r->cancelled;
+	}
+
+	std::uint64_t size = 0;
+	bool result = false;
+	if(!cancelled && r->read_func)
+	{
+		result = r->read_func(size);
+	}
+
+	std::vector<request_ptr> finished;
+	std::vector<request_ptr> reads;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		r->read_done_at = clock_t::now();
+		_stats.read_latency.add(r->read_done_at - r->read_at);
+		--_in_flight;
+
+		r->read_func = nullptr;
+		r->size = size;
+
+		if(r->cancelled || !result)
+		{
+			finish(r, false, finished);
+		}
+		else if(r->priority == load_priority::visible_now)
+		{
+			finish(r, true, finished);
+		}
+		else
+		{
+			r->state = request_state::uploading;
+			_uploads[std::size_t(r->priority)].push_back(r);
+		}
+
+		take_reads(reads);
+
+		// Disposing may go on as soon as the lock is released, nothing of
+		// ours is touched after this unless reads were started.
+		if(_in_flight == 0)
+			_reads_done.notify_all();
+	}
+	resolve(finished);
+	if(!reads.empty())
+		start(reads);
+}
+
+void asset_streamer::move(const std::string& key, load_priority priority, bool only_up)
+{
+	std::vector<request_ptr> finished;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		for(auto& r : find(key))
+		{
+			if(r->priority == priority || (only_up && r->priority < priority))
+				continue;
+
+			const auto from = std::size_t(r->priority);
+			const auto to = std::size_t(priority);
+			r->priority = priority;
+
+			if(r->state == request_state::queued)
+			{
+				remove(_queued[from], r);
+				_queued[to].push_back(r);
+			}
+			else if(r->state == request_state::uploading)
+			{
+				remove(_uploads[from], r);
+				// someone may be waiting on it already
+				if(priority == load_priority::visible_now)
+					finish(r, true, finished);
+				else
+					_uploads[to].push_back(r);
+			}
+		}
+	}
+	resolve(finished);
+}
+
+std::vector<asset_streamer::request_ptr> asset_streamer::find(const std::string& key) const
+{
+	std::vector<request_ptr> requests;
+	auto range = _requests.equal_range(key);
+	for(auto it = range.first; it != range.second; ++it)
+	{
+		requests.push_back(it->second);
+	}
+	return requests;
+}
+
+void asset_streamer::take_reads(std::vector<request_ptr>& reads)
+{
+	if(_disposed)
+		return;
+
+	for(auto& queue : _queued)
+	{
+		while(!queue.empty() && _in_flight < _max_in_flight)
+		{
+			auto r = queue.front();
+			queue.pop_front();
+
+			r->state = request_state::reading;
+			r->read_at = clock_t::now();
+			_stats.queue_latency.add(r->read_at - r->queued_at);
+			++_in_flight;
+
+			reads.push_back(r);
+		}
+	}
+}
+
+void asset_streamer::finish(const request_ptr& r, bool result, std::vector<request_ptr>& finished)
+{
+	if(result)
+	{
+		_stats.upload_latency.add(clock_t::now() - r->read_done_at);
+		_frame_uploaded += r->size;
+	}
+
+	r->state = request_state::done;
+	r->result = result;
+
+	auto range = _requests.equal_range(r->key);
+	for(auto it = range.first; it != range.second; ++it)
+	{
+		if(it->second == r)
+		{
+			_requests.erase(it);
+			break;
+		}
+	}
+
+	finished.push_back(r);
+}
+
+void asset_streamer::start(std::vector<request_ptr>& reads)
+{
+	if(reads.empty())
+		return;
+
+	auto& ts = core::get_subsystem<core::task_system>();
+	for(auto& r : reads)
+	{
+		ts.push_ready([this, r]() { read(r); });
+	}
+}
+
+void asset_streamer::resolve(std::vector<request_ptr>& finished)
+{
+	// outside of the lock, awaiting tasks get scheduled from here
+	for(auto& r : finished)
+	{
+		r->promise.set_value(r->result);
+	}
+}
+
+void asset_streamer::remove(std::deque<request_ptr>& queue, const request_ptr& r)
+{
+	auto it = std::find(queue.begin(), queue.end(), r);
+	if(it != queue.end())
+	{
+		queue.erase(it);
+	}
+}
+}
@@ -0,0 +1,229 @@
+#pragma once
+
+#include "asset_flags.h"
+#include "core/system/subsystem.h"
+#include "core/system/task_system.h"
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace runtime
+{
+//-----------------------------------------------------------------------------
+//  Name : latency_histogram (Struct)
+/// <summary>
+/// Latencies bucketed by powers of two, bucket i counts the latencies below
+/// 2^i milliseconds and the last bucket everything above.
+/// </summary>
+//-----------------------------------------------------------------------------
+struct latency_histogram
+{
+	static const std::size_t bucket_count = 12;
+
+	std::array<std::uint32_t, bucket_count> buckets = {};
+	std::uint32_t count = 0;
+	float total_ms = 0.0f;
+	float max_ms = 0.0f;
+
+	void add(std::chrono::duration<float, std::milli> latency);
+
+	float get_average_ms() const
+	{
+		return count > 0 ? total_ms / float(count) : 0.0f;
+	}
+};
+
+//-----------------------------------------------------------------------------
+//  Name : asset_streamer_stats (Struct)
+/// <summary>
+/// Queue depths of the streamer and the latencies of its requests.
+/// </summary>
+//-----------------------------------------------------------------------------
+struct asset_streamer_stats
+{
+	static const std::size_t priority_count = std::size_t(load_priority::count);
+
+	/// Requests waiting for a read slot, per priority.
+	std::array<std::uint32_t, priority_count> queued = {};
+	/// Requests read but waiting for upload budget, per priority.
+	std::array<std::uint32_t, priority_count> uploads = {};
+	/// Reads running right now.
+	std::uint32_t in_flight = 0;
+	/// Bytes handed over for upload in the last frame.
+	std::uint64_t uploaded_bytes = 0;
+	/// Requests cancelled since startup.
+	std::uint64_t cancelled = 0;
+	/// From the request to the start of its read.
+	latency_histogram queue_latency;
+	/// From the start to the end of the read.
+	latency_histogram read_latency;
+	/// From the end of the read to the upload.
+	latency_histogram upload_latency;
+};
+
+//-----------------------------------------------------------------------------
+//  Name : asset_streamer (Class)
+/// <summary>
+/// Schedules the file reads of the asset loaders. Only a few reads run at a
+/// time so a bulk load does not take all the workers, the next read is
+/// picked by priority as soon as one finishes. Read assets are then handed
+/// to the main thread for upload under a per frame byte budget, except the
+/// ones needed right now which go straight away so waiting on them can not
+/// stall. Requests can be promoted, demoted or cancelled until they are
+/// uploaded, cancelled ones resolve as failed reads.
+/// </summary>
+//-----------------------------------------------------------------------------
+class asset_streamer : public core::subsystem
+{
+public:
+	/// Reads an asset and reports how many bytes its upload hands to the
+	/// renderer.
+	using read_func_t = std::function<bool(std::uint64_t&)>;
+
+	bool initialize() override;
+
+	void dispose() override;
+
+	//-----------------------------------------------------------------------------
+	//  Name : push ()
+	/// <summary>
+	/// Queues a read, the future resolves with the result of the read once
+	/// the asset may be uploaded.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	core::task_future<bool> push(const std::string& key, load_priority priority, read_func_t read_func);
+
+	//-----------------------------------------------------------------------------
+	//  Name : set_priority ()
+	/// <summary>
+	/// Moves the requests of a key to another priority.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void set_priority(const std::string& key, load_priority priority);
+
+	//-----------------------------------------------------------------------------
+	//  Name : promote ()
+	/// <summary>
+	/// Moves the requests of a key to a priority if it is higher than theirs.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void promote(const std::string& key, load_priority priority);
+
+	//-----------------------------------------------------------------------------
+	//  Name : cancel ()
+	/// <summary>
+	/// Cancels the requests of a key. Queued and read ones resolve as failed
+	/// right away, running reads once they finish.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void cancel(const std::string& key);
+
+	//-----------------------------------------------------------------------------
+	//  Name : set_max_in_flight ()
+	/// <summary>
+	/// Sets how many reads may run at the same time.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void set_max_in_flight(std::uint32_t count);
+
+	//-----------------------------------------------------------------------------
+	//  Name : set_upload_budget ()
+	/// <summary>
+	/// Sets how many bytes may be handed over for upload each frame.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void set_upload_budget(std::uint64_t bytes);
+
+	//-----------------------------------------------------------------------------
+	//  Name : get_stats ()
+	/// <summary>
+	/// Returns the current queue depths and the latencies since startup.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	asset_streamer_stats get_stats() const;
+
+private:
+	using clock_t = std::chrono::steady_clock;
+
+	enum class request_state
+	{
+		queued,
+		reading,
+		uploading,
+		done
+	};
+
+	struct request
+	{
+		request(core::task_system* system)
+			: promise(system)
+		{
+		}
+
+		std::string key;
+		load_priority priority = load_priority::prefetch;
+		request_state state = request_state::queued;
+		bool cancelled = false;
+		bool result = false;
+		std::uint64_t size = 0;
+		read_func_t read_func;
+		core::task_promise<bool> promise;
+		clock_t::time_point queued_at;
+		clock_t::time_point read_at;
+		clock_t::time_point read_done_at;
+	};
+
+	using request_ptr = std::shared_ptr<request>;
+	using request_queues = std::array<std::deque<request_ptr>, asset_streamer_stats::priority_count>;
+
+	//-----------------------------------------------------------------------------
+	//  Name : frame_begin ()
+	/// <summary>
+	/// Hands over the read assets the budget of the frame allows.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void frame_begin(std::chrono::duration<float>);
+
+	void read(request_ptr r);
+
+	void move(const std::string& key, load_priority priority, bool only_up);
+
+	/// Requests of a key, called under the lock.
+	std::vector<request_ptr> find(const std::string& key) const;
+
+	/// Picks the reads to start, called under the lock.
+	void take_reads(std::vector<request_ptr>& reads);
+
+	/// Marks a request as done, called under the lock.
+	void finish(const request_ptr& r, bool result, std::vector<request_ptr>& finished);
+
+	void start(std::vector<request_ptr>& reads);
+
+	static void resolve(std::vector<request_ptr>& finished);
+
+	static void remove(std::deque<request_ptr>& queue, const request_ptr& r);
+
+	mutable std::mutex _mutex;
+	/// Signaled when the last running read finishes.
+	std::condition_variable _reads_done;
+	request_queues _queued;
+	request_queues _uploads;
+	/// Requests by key, a key may be requested again while in the queues.
+	std::unordered_multimap<std::string, request_ptr> _requests;
+	std::uint32_t _max_in_flight = 4;
+	std::uint32_t _in_flight = 0;
+	std::uint64_t _upload_budget = 8 * 1024 * 1024;
+	std::uint64_t _frame_uploaded = 0;
+	/// No reads start once set, disposing waits for the running ones.
+	bool _disposed = false;
+	asset_streamer_stats _stats;
+};
+}
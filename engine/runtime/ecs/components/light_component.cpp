@@ -16,11 +16,21 @@ light_component::~light_component()
 int light_component::compute_projected_sphere_rect(irect& rect, const math::vec3& light_position,
 												   const math::vec3& light_direction,
 												   const math::transform& view, const math::transform& proj)
+{
+	if(_light.type == light_type::directional)
+		return 1;
+
+	const auto sphere = get_bounding_sphere(light_position, light_direction);
+	return math::compute_projected_sphere_rect(rect.left, rect.right, rect.top, rect.bottom,
+											   math::vec3(sphere), sphere.w, view, proj);
+}
+
+math::vec4 light_component::get_bounding_sphere(const math::vec3& light_position,
+												const math::vec3& light_direction) const
 {
 	if(_light.type == light_type::point)
 	{
-		return math::compute_projected_sphere_rect(rect.left, rect.right, rect.top, rect.bottom,
-												   light_position, _light.point_data.range, view, proj);
+		return math::vec4(light_position, _light.point_data.range);
 	}
 	else if(_light.type == light_type::spot)
 	{
@@ -37,11 +47,10 @@ int light_component::compute_projected_sphere_rect(irect& rect, const math::vec3
 		const float radius = math::sqrt(1.25f * range * range - range * range * cos_outer_cone);
 		math::vec3 center = light_position + 0.5f * light_direction * range;
 
-		return math::compute_projected_sphere_rect(rect.left, rect.right, rect.top, rect.bottom, center,
-												   radius, view, proj);
+		return math::vec4(center, radius);
 	}
 	else
 	{
-		return 1;
+		return math::vec4(light_position, 0.0f);
 	}
 }
@@ -72,6 +72,15 @@ public:
 									  const math::vec3& light_direction, const math::transform& view,
 									  const math::transform& proj);
 
+	//-----------------------------------------------------------------------------
+	//  Name : get_bounding_sphere ()
+	/// <summary>
+	/// Sphere enclosing the lit volume, center in xyz and radius in w. The
+	/// radius is zero for directional lights.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	math::vec4 get_bounding_sphere(const math::vec3& light_position, const math::vec3& light_direction) const;
+
 private:
 	//-------------------------------------------------------------------------
 	// Private Member Variables.
@@ -78,3 +78,8 @@ bool model_component::casts_reflection() const
 {
 	return _casts_reflection;
 }
+
+skinning_cache& model_component::get_skinning_cache() const
+{
+	return _skinning_cache;
+}
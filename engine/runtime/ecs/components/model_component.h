@@ -19,6 +19,9 @@ class model_component : public runtime::component_impl<model_component>
 	REFLECTABLEV(model_component, component)
 
 public:
+	/// Iterated every frame, keep them packed together.
+	using storage_policy = runtime::packed_storage_policy;
+
 	//-------------------------------------------------------------------------
 	// Constructors & Destructors
 	//-------------------------------------------------------------------------
@@ -112,6 +115,14 @@ public:
 	//-----------------------------------------------------------------------------
 	model_component& set_model(const model& model);
 
+	//-----------------------------------------------------------------------------
+	//  Name : get_skinning_cache ()
+	/// <summary>
+	/// Skinning matrices of this instance shared by the render passes.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	skinning_cache& get_skinning_cache() const;
+
 private:
 	//-------------------------------------------------------------------------
 	// Private Member Variables.
@@ -124,4 +135,6 @@ private:
 	bool _casts_reflection = true;
 	///
 	model _model;
+	/// Not part of the state, only caches matrices computed from it.
+	mutable skinning_cache _skinning_cache;
 };
@@ -1,5 +1,79 @@
 #include "reflection_probe_component.h"
 
+namespace
+{
+void build_face_camera(camera& cam, std::uint32_t face, const math::transform& transform)
+{
+	cam.set_fov(90.0f);
+	cam.set_aspect_ratio(1.0f, true);
+	cam.set_near_clip(0.01f);
+	cam.set_far_clip(256.0f);
+
+	// Configurable axis vectors used to construct view matrices. In the
+	// case of the omni light, we align all frustums to the world axes.
+	math::vec3 X(1, 0, 0);
+	math::vec3 Y(0, 1, 0);
+	math::vec3 Z(0, 0, 1);
+	math::vec3 Zero(0, 0, 0);
+	math::transform t;
+	// Generate the correct view matrix for the frustum
+	if(!gfx::is_origin_bottom_left())
+	{
+		switch(face)
+		{
+			case 0:
+				t.set_rotation(-Z, +Y, +X);
+				break;
+			case 1:
+				t.set_rotation(+Z, +Y, -X);
+				break;
+			case 2:
+				t.set_rotation(+X, -Z, +Y);
+				break;
+			case 3:
+				t.set_rotation(+X, +Z, -Y);
+				break;
+			case 4:
+				t.set_rotation(+X, +Y, +Z);
+				break;
+			case 5:
+				t.set_rotation(-X, +Y, -Z);
+				break;
+		}
+	}
+	else
+	{
+		switch(face)
+		{
+			case 0:
+				t.set_rotation(-Z, +Y, +X);
+				break;
+			case 1:
+				t.set_rotation(+Z, +Y, -X);
+				break;
+			case 3:
+				t.set_rotation(+X, -Z, +Y);
+				break;
+			case 2:
+				t.set_rotation(+X, +Z, -Y);
+				break;
+			case 4:
+				t.set_rotation(+X, +Y, +Z);
+				break;
+			case 5:
+				t.set_rotation(-X, +Y, -Z);
+				break;
+		}
+	}
+
+	t = transform * t;
+	// First update so the camera can cache the previous matrices
+	cam.record_current_matrices();
+	// Set new transform
+	cam.look_at(t.get_position(), t.get_position() + t.z_unit_axis(), t.y_unit_axis());
+}
+}
+
 reflection_probe_component::reflection_probe_component()
 {
 }
@@ -65,4 +139,25 @@ void reflection_probe_component::set_probe(const reflection_probe& probe)
 	touch();
 
 	_probe = probe;
+	_face_cameras_valid = false;
+}
+
+camera& reflection_probe_component::get_face_camera(std::uint32_t face, const math::transform& world_transform)
+{
+	update_face_cameras(world_transform);
+	return _face_cameras[face];
+}
+
+void reflection_probe_component::update_face_cameras(const math::transform& world_transform)
+{
+	if(_face_cameras_valid && _face_transform == world_transform)
+		return;
+
+	for(std::uint32_t i = 0; i < 6; ++i)
+	{
+		build_face_camera(_face_cameras[i], i, world_transform);
+	}
+
+	_face_transform = world_transform;
+	_face_cameras_valid = true;
 }
@@ -2,6 +2,7 @@
 //-----------------------------------------------------------------------------
 // reflection_probe_component Header Includes
 //-----------------------------------------------------------------------------
+#include "../../rendering/camera.h"
 #include "../../rendering/reflection_probe.h"
 #include "../../rendering/render_pass.h"
 #include "../ecs.h"
@@ -25,6 +26,9 @@ class reflection_probe_component : public runtime::component_impl<reflection_pro
 	SERIALIZABLE(reflection_probe_component)
 	REFLECTABLEV(reflection_probe_component, runtime::component)
 public:
+	/// Bit mask with one bit per cubemap face.
+	static const std::uint32_t all_faces = 0x3f;
+
 	//-------------------------------------------------------------------------
 	// Constructors & Destructors
 	//-------------------------------------------------------------------------
@@ -102,7 +106,58 @@ public:
 	//-----------------------------------------------------------------------------
 	std::shared_ptr<frame_buffer> get_cubemap_fbo();
 
+	//-----------------------------------------------------------------------------
+	//  Name : get_face_camera ()
+	/// <summary>
+	/// Returns the camera rendering a cubemap face from the probe's world
+	/// transform. The six cameras are cached and rebuilt only when the
+	/// transform or the probe settings change.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	camera& get_face_camera(std::uint32_t face, const math::transform& world_transform);
+
+	//-----------------------------------------------------------------------------
+	//  Name : get_pending_faces ()
+	/// <summary>
+	/// Faces waiting to be rendered, one bit per face.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	inline std::uint32_t get_pending_faces() const
+	{
+		return _pending_faces;
+	}
+
+	//-----------------------------------------------------------------------------
+	//  Name : queue_faces ()
+	/// <summary>
+	/// Marks faces as needing to be rendered again.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	inline void queue_faces(std::uint32_t faces)
+	{
+		_pending_faces |= faces & all_faces;
+	}
+
+	//-----------------------------------------------------------------------------
+	//  Name : clear_pending_face ()
+	/// <summary>
+	/// Marks a face as rendered.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	inline void clear_pending_face(std::uint32_t face)
+	{
+		_pending_faces &= ~(1u << face);
+	}
+
 private:
+	//-----------------------------------------------------------------------------
+	//  Name : update_face_cameras ()
+	/// <summary>
+	/// Rebuilds the face cameras if the cache is out of date.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void update_face_cameras(const math::transform& world_transform);
+
 	//-------------------------------------------------------------------------
 	// Private Member Variables.
 	//-------------------------------------------------------------------------
@@ -110,4 +165,12 @@ private:
 	reflection_probe _probe;
 	/// The render view for this component
 	render_view _render_view[6];
+	/// Cached cameras of the cubemap faces
+	camera _face_cameras[6];
+	/// Transform the face cameras were built from
+	math::transform _face_transform;
+	/// Are the face cameras up to date
+	bool _face_cameras_valid = false;
+	/// Faces waiting to be rendered
+	std::uint32_t _pending_faces = all_faces;
 };
@@ -1,6 +1,17 @@
 #include "transform_component.h"
 #include "core/logging/logging.h"
 #include <algorithm>
+#include <atomic>
+
+namespace
+{
+std::atomic<std::uint64_t> hierarchy_version{0};
+
+void hierarchy_changed()
+{
+	hierarchy_version.fetch_add(1, std::memory_order_relaxed);
+}
+}
 
 runtime::chandle<transform_component> create_from_component(runtime::chandle<transform_component> component)
 {
@@ -34,6 +45,7 @@ transform_component::transform_component(const transform_component& rhs)
 
 void transform_component::on_entity_set()
 {
+	hierarchy_changed();
 	for(auto& child : _children)
 	{
 		child.lock()->_parent = handle();
@@ -42,6 +54,7 @@ void transform_component::on_entity_set()
 
 transform_component::~transform_component()
 {
+	hierarchy_changed();
 	if(!_parent.expired())
 	{
 		_parent.lock()->cleanup_dead_children();
@@ -82,8 +95,9 @@ transform_component& transform_component::move_local(const math::vec3& amount)
 transform_component& transform_component::set_local_position(const math::vec3& position)
 {
 	// Set new cell relative position
-	_local_transform.set_position(position);
-	set_local_transform(_local_transform);
+	math::transform m = _local_transform;
+	m.set_position(position);
+	set_local_transform(m);
 	return *this;
 }
 
@@ -235,8 +249,9 @@ transform_component& transform_component::rotate_local(float x, float y, float z
 	if(!x && !y && !z)
 		return *this;
 
-	_local_transform.rotate_local(math::radians(x), math::radians(y), math::radians(z));
-	set_local_transform(_local_transform);
+	math::transform m = _local_transform;
+	m.rotate_local(math::radians(x), math::radians(y), math::radians(z));
+	set_local_transform(m);
 	return *this;
 }
 
@@ -378,8 +393,9 @@ transform_component& transform_component::set_local_scale(const math::vec3& scal
 	// Do nothing if scaling is disallowed.
 	if(!can_scale())
 		return *this;
-	_local_transform.set_scale(scale);
-	set_local_transform(_local_transform);
+	math::transform m = _local_transform;
+	m.set_scale(scale);
+	set_local_transform(m);
 	return *this;
 }
 
@@ -410,8 +426,9 @@ transform_component& transform_component::set_local_rotation(const math::quat& r
 		return *this;
 
 	// Set orientation of new math::transform
-	_local_transform.set_rotation(rotation);
-	set_local_transform(_local_transform);
+	math::transform m = _local_transform;
+	m.set_rotation(rotation);
+	set_local_transform(m);
 
 	return *this;
 }
@@ -546,11 +563,13 @@ const runtime::chandle<transform_component>& transform_component::get_parent() c
 
 void transform_component::attach_child(runtime::chandle<transform_component> child)
 {
+	hierarchy_changed();
 	_children.push_back(child);
 }
 
 void transform_component::remove_child(runtime::chandle<transform_component> child)
 {
+	hierarchy_changed();
 	_children.erase(std::remove_if(std::begin(_children), std::end(_children),
 								   [&child](runtime::chandle<transform_component> other) {
 									   return child.lock() == other.lock();
@@ -560,6 +579,7 @@ void transform_component::remove_child(runtime::chandle<transform_component> chi
 
 void transform_component::cleanup_dead_children()
 {
+	hierarchy_changed();
 	_children.erase(
 		std::remove_if(std::begin(_children), std::end(_children),
 					   [](runtime::chandle<transform_component> other) { return other.expired(); }),
@@ -606,29 +626,42 @@ void transform_component::resolve(bool force, float dt)
 {
 	if(force || is_dirty())
 	{
-		if(!_parent.expired())
+		auto parent = _parent.lock();
+		if(parent)
+			parent->resolve();
+
+		resolve_world(parent.get(), dt);
+	}
+}
+
+void transform_component::resolve_world(const transform_component* parent, float dt)
+{
+	if(parent)
+	{
+		auto target = parent->_world_transform * _local_transform;
+
+		if(_slow_parenting)
 		{
-			auto target = _parent.lock()->get_transform() * _local_transform;
-
-			if(_slow_parenting)
-			{
-				float t = math::clamp(_slow_parenting_speed * dt, 0.0f, 1.0f);
-				_world_transform.set_position(
-					math::lerp(_world_transform.get_position(), target.get_position(), t));
-				_world_transform.set_scale(math::lerp(_world_transform.get_scale(), target.get_scale(), t));
-				_world_transform.set_rotation(
-					math::slerp(_world_transform.get_rotation(), target.get_rotation(), t));
-			}
-			else
-			{
-				_world_transform = target;
-			}
+			float t = math::clamp(_slow_parenting_speed * dt, 0.0f, 1.0f);
+			_world_transform.set_position(math::lerp(_world_transform.get_position(), target.get_position(), t));
+			_world_transform.set_scale(math::lerp(_world_transform.get_scale(), target.get_scale(), t));
+			_world_transform.set_rotation(
+				math::slerp(_world_transform.get_rotation(), target.get_rotation(), t));
 		}
 		else
 		{
-			_world_transform = _local_transform;
+			_world_transform = target;
 		}
 	}
+	else
+	{
+		_world_transform = _local_transform;
+	}
+}
+
+std::uint64_t transform_component::get_hierarchy_version()
+{
+	return hierarchy_version.load(std::memory_order_relaxed);
 }
 
 bool transform_component::is_dirty() const
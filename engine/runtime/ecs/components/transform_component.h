@@ -20,6 +20,9 @@ class transform_component : public runtime::component_impl<transform_component>
 	REFLECTABLEV(transform_component, runtime::component)
 
 public:
+	/// Iterated every frame, keep them packed together.
+	using storage_policy = runtime::packed_storage_policy;
+
 	//-------------------------------------------------------------------------
 	// Constructors & Destructors
 	//-------------------------------------------------------------------------
@@ -66,6 +69,25 @@ public:
 	//-----------------------------------------------------------------------------
 	void resolve(bool force = false, float dt = 0.0f);
 
+	//-----------------------------------------------------------------------------
+	//  Name : resolve_world ()
+	/// <summary>
+	/// Recomputes the world transform from the given parent, which must already
+	/// be resolved. Does not touch the parent handle, used by the scene graph
+	/// when walking the flattened hierarchy.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void resolve_world(const transform_component* parent, float dt);
+
+	//-----------------------------------------------------------------------------
+	//  Name : get_hierarchy_version (static)
+	/// <summary>
+	/// Changes whenever a transform joins or leaves the scene or any parent /
+	/// child link changes.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	static std::uint64_t get_hierarchy_version();
+
 	//-----------------------------------------------------------------------------
 	//  Name : is_dirty (virtual )
 	/// <summary>
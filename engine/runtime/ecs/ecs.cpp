@@ -7,6 +7,8 @@ event<void(entity)> on_entity_destroyed;
 event<void(entity, chandle<component>)> on_component_added;
 event<void(entity, chandle<component>)> on_component_removed;
 
+const std::uint32_t component_storage::invalid_index;
+
 component_storage::component_storage(std::size_t size)
 {
 	expand(size);
@@ -19,11 +21,17 @@ component_storage::~component_storage()
 void component_storage::expand(std::size_t n)
 {
 	data.resize(n);
+	raw.resize(n, nullptr);
+	sparse.resize(n, invalid_index);
+	changed_frame.resize(n, 0);
 }
 
 void component_storage::reserve(std::size_t n)
 {
 	data.reserve(n);
+	raw.reserve(n);
+	sparse.reserve(n);
+	changed_frame.reserve(n);
 }
 
 std::shared_ptr<component> component_storage::get(std::size_t n)
@@ -42,15 +50,65 @@ void component_storage::destroy(std::size_t n)
 {
 	expects(n < size());
 	auto& element = data[n];
+	raw[n] = nullptr;
+	changed_frame[n] = 0;
+	remove_entity(static_cast<std::uint32_t>(n));
 	element.reset();
 }
 
 std::weak_ptr<component> component_storage::set(unsigned int index, std::shared_ptr<component> component)
 {
+	raw[index] = component.get();
 	data[index] = component;
+	add_entity(index);
 	return component;
 }
 
+void component_storage::changed_since(std::uint64_t frame, std::vector<std::uint32_t>& result) const
+{
+	auto it = std::lower_bound(std::begin(changes), std::end(changes), frame,
+							   [](const change_record& record, std::uint64_t f) { return record.frame < f; });
+
+	for(; it != std::end(changes); ++it)
+	{
+		// only the latest record of an entity counts
+		if(changed_frame[it->index] == it->frame + 1)
+			result.push_back(it->index);
+	}
+}
+
+void component_storage::compact_changes()
+{
+	changes.erase(std::remove_if(std::begin(changes), std::end(changes),
+								 [this](const change_record& record) {
+									 return changed_frame[record.index] != record.frame + 1;
+								 }),
+				  std::end(changes));
+}
+
+void component_storage::add_entity(std::uint32_t index)
+{
+	if(sparse[index] != invalid_index)
+		return;
+
+	sparse[index] = static_cast<std::uint32_t>(dense.size());
+	dense.push_back(index);
+}
+
+void component_storage::remove_entity(std::uint32_t index)
+{
+	const auto pos = sparse[index];
+	if(pos == invalid_index)
+		return;
+
+	// swap with the last one to keep the set packed
+	const auto last = dense.back();
+	dense[pos] = last;
+	sparse[last] = pos;
+	dense.pop_back();
+	sparse[index] = invalid_index;
+}
+
 /////////////////////////////////////////////////////////////////////////////
 const entity::id_t entity::INVALID;
 
@@ -130,20 +188,129 @@ void entity_component_system::remove(entity::id_t id, std::shared_ptr<component>
 
 void entity_component_system::remove(entity::id_t id, const rtti::type_index_sequential_t::index_t family)
 {
+	check_not_iterating();
 	assert_valid(id);
 	const std::uint32_t index = id.index();
 
 	// Find the pool for this component family.
 	auto& pool = component_pools_[family];
-	chandle<component> handle(pool->get(id.index()));
+	auto comp = pool->get(id.index());
+	chandle<component> handle(comp);
 	on_component_removed(get(id), handle);
 	// Remove component bit.
 	entity_component_mask_[id.index()].reset(family);
+	comp->_storage = nullptr;
 
 	// Call destructor.
 	pool->destroy(index);
 }
 
+const std::vector<std::uint32_t>*
+entity_component_system::smallest_entity_set(const component_mask_t& mask) const
+{
+	const std::vector<std::uint32_t>* result = nullptr;
+	for(size_t family = 0; family < MAX_COMPONENTS; ++family)
+	{
+		if(!mask.test(family))
+			continue;
+
+		// a component nobody ever had, nothing can match
+		if(family >= component_pools_.size() || !component_pools_[family])
+			return nullptr;
+
+		const auto& entities = component_pools_[family]->entities();
+		if(!result || entities.size() < result->size())
+			result = &entities;
+	}
+	return result;
+}
+
+entity_component_system::registered_query& entity_component_system::get_query(const component_mask_t& mask)
+{
+	for(auto& query : queries_)
+	{
+		if(query->mask() == mask)
+			return *query;
+	}
+
+	queries_.emplace_back(std::make_unique<registered_query>(this, mask));
+	return *queries_.back();
+}
+
+entity_component_system::registered_query::registered_query(entity_component_system* manager,
+															component_mask_t mask)
+	: manager_(manager)
+	, mask_(mask)
+{
+	for(auto e : base_view<false>(manager_, mask_))
+		add(e);
+
+	on_component_added.connect(this, &registered_query::handle_component_added);
+	on_component_removed.connect(this, &registered_query::handle_component_removed);
+	on_entity_destroyed.connect(this, &registered_query::handle_entity_destroyed);
+}
+
+entity_component_system::registered_query::~registered_query()
+{
+	on_component_added.disconnect(this, &registered_query::handle_component_added);
+	on_component_removed.disconnect(this, &registered_query::handle_component_removed);
+	on_entity_destroyed.disconnect(this, &registered_query::handle_entity_destroyed);
+}
+
+void entity_component_system::registered_query::handle_component_added(entity e, chandle<component>)
+{
+	// Emitted after the component bit is set.
+	if(owns(e) && (manager_->entity_component_mask_[e.id().index()] & mask_) == mask_)
+		add(e);
+}
+
+void entity_component_system::registered_query::handle_component_removed(entity e,
+																		  chandle<component> handle)
+{
+	// Emitted before the component bit is cleared.
+	auto comp = handle.lock();
+	if(owns(e) && comp && mask_.test(comp->runtime_id()))
+		remove(e);
+}
+
+void entity_component_system::registered_query::handle_entity_destroyed(entity e)
+{
+	if(owns(e))
+		remove(e);
+}
+
+bool entity_component_system::registered_query::owns(const entity& e) const
+{
+	return e == entity(manager_, e.id());
+}
+
+void entity_component_system::registered_query::add(const entity& e)
+{
+	const auto index = e.id().index();
+	if(positions_.size() <= index)
+		positions_.resize(index + 1, ~0u);
+
+	if(positions_[index] != ~0u)
+		return;
+
+	positions_[index] = static_cast<std::uint32_t>(entities_.size());
+	entities_.push_back(e);
+}
+
+void entity_component_system::registered_query::remove(const entity& e)
+{
+	const auto index = e.id().index();
+	if(index >= positions_.size() || positions_[index] == ~0u)
+		return;
+
+	const auto pos = positions_[index];
+	const auto last = entities_.back();
+	entities_[pos] = last;
+	positions_[last.id().index()] = pos;
+	entities_.pop_back();
+	positions_[index] = ~0u;
+}
+
 bool entity_component_system::has_component(entity::id_t id, std::shared_ptr<component> component) const
 {
 	return has_component(id, component->runtime_id());
@@ -209,6 +376,8 @@ chandle<component> entity_component_system::assign(entity::id_t id, std::shared_
 
 	// Create and return handle.
 	comp->_entity = get(id);
+	comp->_storage = &pool;
+	pool.mark_changed(id.index(), core::simulation::get_frame_epoch());
 	comp->on_entity_set();
 	chandle<component> handle(ptr);
 	on_component_added(get(id), handle);
@@ -217,6 +386,7 @@ chandle<component> entity_component_system::assign(entity::id_t id, std::shared_
 
 void entity_component_system::destroy(entity::id_t id)
 {
+	check_not_iterating();
 	entity_names_[id.id()] = "";
 	assert_valid(id);
 	std::uint32_t index = id.index();
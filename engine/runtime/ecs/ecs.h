@@ -2,6 +2,7 @@
 
 #include "core/common/assert.hpp"
 #include "core/common/nonstd/type_traits.hpp"
+#include "core/memory/pool_allocator.hpp"
 #include "core/reflection/registration.h"
 #include "core/serialization/serialization.h"
 #include "core/signals/event.hpp"
@@ -9,7 +10,9 @@
 #include "core/system/subsystem.h"
 
 #include <algorithm>
+#include <atomic>
 #include <bitset>
+#include <cassert>
 #include <cstdint>
 #include <cstdlib>
 #include <functional>
@@ -31,6 +34,175 @@ namespace runtime
 static const std::size_t MAX_COMPONENTS = 128;
 
 class component;
+
+/// Default storage policy, every component is its own heap allocation.
+struct heap_storage_policy
+{
+};
+
+/// Components of the type live by value in contiguous chunks.
+struct packed_storage_policy
+{
+};
+
+/// A component type opts into a storage policy by declaring
+///     using storage_policy = runtime::packed_storage_policy;
+template <typename T, typename = void>
+struct component_storage_policy
+{
+	using type = heap_storage_policy;
+};
+
+template <typename T>
+struct component_storage_policy<T, nonstd::void_t<typename T::storage_policy>>
+{
+	using type = typename T::storage_policy;
+};
+
+/** Chunked by-value storage for all components of type T.
+*
+* Components are still handed out as std::shared_ptr so chandle keeps
+* working, but the objects themselves sit next to each other in memory.
+* Chunks never move, so handles stay valid while the arena grows.
+*/
+template <typename T>
+class packed_component_arena
+{
+public:
+	static packed_component_arena& get()
+	{
+		// Never destroyed. Components can be released during static
+		// destruction and still need to give their slot back.
+		static auto arena = new packed_component_arena();
+		return *arena;
+	}
+
+	template <typename... Args>
+	std::shared_ptr<T> create(Args&&... args)
+	{
+		auto slot = acquire();
+		T* element = nullptr;
+		try
+		{
+			element = new(slot) T(std::forward<Args>(args)...);
+		}
+		catch(...)
+		{
+			release(slot);
+			throw;
+		}
+
+		return std::shared_ptr<T>(element,
+								  [](T* ptr) {
+									  ptr->~T();
+									  get().release(ptr);
+								  },
+								  core::pool_allocator<T>());
+	}
+
+	/// Number of live components.
+	std::size_t size() const
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return capacity_unlocked() - _free.size();
+	}
+
+	/// Number of slots allocated.
+	std::size_t capacity() const
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return capacity_unlocked();
+	}
+
+private:
+	using storage_t = typename std::aligned_storage<sizeof(T), alignof(T)>::type;
+	static const std::size_t chunk_size = 256;
+
+	packed_component_arena() = default;
+
+	void* acquire()
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if(_free.empty())
+		{
+			_chunks.emplace_back(new storage_t[chunk_size]);
+			auto chunk = _chunks.back().get();
+			// reversed so that slots are handed out in address order
+			for(std::size_t i = chunk_size; i-- > 0;)
+				_free.push_back(&chunk[i]);
+		}
+
+		auto slot = _free.back();
+		_free.pop_back();
+		return slot;
+	}
+
+	void release(void* slot)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_free.push_back(static_cast<storage_t*>(slot));
+	}
+
+	std::size_t capacity_unlocked() const
+	{
+		return _chunks.size() * chunk_size;
+	}
+
+	mutable std::mutex _mutex;
+	std::vector<std::unique_ptr<storage_t[]>> _chunks;
+	std::vector<storage_t*> _free;
+};
+
+template <typename T, typename... Args>
+std::shared_ptr<T> make_component(heap_storage_policy, Args&&... args)
+{
+	// object and control block share one pooled block
+	return std::allocate_shared<T>(core::pool_allocator<T>(), std::forward<Args>(args)...);
+}
+
+template <typename T, typename... Args>
+std::shared_ptr<T> make_component(packed_storage_policy, Args&&... args)
+{
+	return packed_component_arena<T>::get().create(std::forward<Args>(args)...);
+}
+
+/**
+* Create a component using the storage policy of its type.
+*/
+template <typename T, typename... Args>
+std::shared_ptr<T> make_component(Args&&... args)
+{
+	return make_component<T>(typename component_storage_policy<T>::type{}, std::forward<Args>(args)...);
+}
+
+template <typename T>
+core::pool_stats component_pool_stats(heap_storage_policy)
+{
+	return core::get_pool_stats(rtti::type_id<T>());
+}
+
+template <typename T>
+core::pool_stats component_pool_stats(packed_storage_policy)
+{
+	// the pools only hold the control blocks, the objects live in the arena
+	auto stats = core::get_pool_stats(rtti::type_id<T>());
+	const auto& arena = packed_component_arena<T>::get();
+	const auto capacity = arena.capacity();
+	stats.size += arena.size();
+	stats.capacity += capacity;
+	stats.bytes += capacity * sizeof(T);
+	return stats;
+}
+
+/**
+* Memory occupancy of everything allocated for components of type T.
+*/
+template <typename T>
+core::pool_stats component_pool_stats()
+{
+	return component_pool_stats<T>(typename component_storage_policy<T>::type{});
+}
+
 class component_storage
 {
 public:
@@ -66,20 +238,75 @@ public:
 		return std::static_pointer_cast<T>(get(n));
 	}
 
+	/// Raw access for iteration, no reference counting involved.
+	inline component* get_raw(std::size_t n) const
+	{
+		return raw[n];
+	}
+
+	/// Indices of the entities that have this component, in no particular order.
+	inline const std::vector<std::uint32_t>& entities() const
+	{
+		return dense;
+	}
+
 	void destroy(std::size_t n);
 
+	/// Records that the component of entity index changed during frame.
+	/// Not synchronized, like the rest of the storage.
+	inline void mark_changed(std::uint32_t index, std::uint64_t frame)
+	{
+		// stored off by one so that 0 means unchanged
+		if(changed_frame[index] == frame + 1)
+			return;
+
+		changed_frame[index] = frame + 1;
+		changes.push_back({index, frame});
+
+		if(changes.size() > 2 * dense.size() + 64)
+			compact_changes();
+	}
+
+	/// Appends the indices of entities whose component changed on or after frame.
+	void changed_since(std::uint64_t frame, std::vector<std::uint32_t>& result) const;
+
 	template <typename T, typename... Args>
 	std::weak_ptr<T> set(unsigned int index, Args&&... args)
 	{
-		auto element = std::make_shared<T>(std::forward<Args>(args)...);
+		auto element = make_component<T>(std::forward<Args>(args)...);
+		raw[index] = element.get();
 		data[index] = std::move(element);
+		add_entity(index);
 		return std::static_pointer_cast<T>(data[index]);
 	}
 
 	std::weak_ptr<component> set(unsigned int index, std::shared_ptr<component> component);
 
 private:
+	static const std::uint32_t invalid_index = ~0u;
+
+	struct change_record
+	{
+		std::uint32_t index;
+		std::uint64_t frame;
+	};
+
+	void add_entity(std::uint32_t index);
+	void remove_entity(std::uint32_t index);
+	/// Drops records superseded by a later change of the same entity.
+	void compact_changes();
+
 	std::vector<std::shared_ptr<component>> data;
+	/// Mirrors data without the control blocks.
+	std::vector<component*> raw;
+	/// Entity indices that have this component, packed.
+	std::vector<std::uint32_t> dense;
+	/// Position of each entity index inside dense or invalid_index.
+	std::vector<std::uint32_t> sparse;
+	/// Change log ordered by frame.
+	std::vector<change_record> changes;
+	/// Last frame + 1 each entity index changed or 0.
+	std::vector<std::uint64_t> changed_frame;
 };
 
 class entity_component_system;
@@ -291,10 +518,28 @@ public:
 	/// </summary>
 	//-----------------------------------------------------------------------------
 	component(const component&)
+		: std::enable_shared_from_this<component>()
+		, _entity()
+		, _storage(nullptr)
 	{
+		// A copy belongs to no entity until it gets assigned, changes to it
+		// must not be tracked on the slot of the original.
 		touch();
 	}
 
+	//-----------------------------------------------------------------------------
+	//  Name : operator= ()
+	/// <summary>
+	/// Copies the state of another component, the owning entity and storage
+	/// of this one stay as they are.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	component& operator=(const component&)
+	{
+		touch();
+		return *this;
+	}
+
 	//-----------------------------------------------------------------------------
 	//  Name : ~component (virtual )
 	/// <summary>
@@ -325,7 +570,10 @@ public:
 	//-----------------------------------------------------------------------------
 	virtual void touch()
 	{
-		_last_touched = static_cast<std::uint32_t>(core::get_subsystem<core::simulation>().get_frame()) + 1;
+		const auto frame = core::simulation::get_frame_epoch();
+		_last_touched = static_cast<std::uint32_t>(frame) + 1;
+		if(_storage)
+			_storage->mark_changed(_entity.id().index(), frame);
 	}
 
 	//-----------------------------------------------------------------------------
@@ -338,8 +586,7 @@ public:
 	//-----------------------------------------------------------------------------
 	virtual bool is_dirty() const
 	{
-		return _last_touched >=
-			   static_cast<std::uint32_t>(core::get_subsystem<core::simulation>().get_frame());
+		return _last_touched >= static_cast<std::uint32_t>(core::simulation::get_frame_epoch());
 	}
 
 	//-----------------------------------------------------------------------------
@@ -381,6 +628,8 @@ protected:
 	std::uint32_t _last_touched = 0;
 	/// Owning entity
 	entity _entity;
+	/// Storage the component lives in while assigned, for change tracking.
+	component_storage* _storage = nullptr;
 };
 
 template <typename T>
@@ -399,7 +648,7 @@ public:
 	}
 	virtual std::shared_ptr<component> clone() const
 	{
-		return std::static_pointer_cast<component>(std::make_shared<T>(static_cast<const T&>(*this)));
+		return std::static_pointer_cast<component>(make_component<T>(static_cast<const T&>(*this)));
 	}
 };
 
@@ -421,24 +670,26 @@ public:
 
 	/// An iterator over a view of the entities in an entity_component_system.
 	/// If All is true it will iterate over all valid entities and will ignore the
-	/// entity mask.
+	/// entity mask. Otherwise it walks the entity set of the rarest component in
+	/// the mask, so the cost follows the number of matches rather than the
+	/// number of entities. Components must not be removed while iterating.
 	template <class Delegate, bool All = false>
 	class view_iterator : public std::iterator<std::input_iterator_tag, entity::id_t>
 	{
 	public:
 		Delegate& operator++()
 		{
-			++i_;
+			++pos_;
 			next();
 			return *static_cast<Delegate*>(this);
 		}
 		bool operator==(const Delegate& rhs) const
 		{
-			return i_ == rhs.i_;
+			return pos_ == rhs.pos_;
 		}
 		bool operator!=(const Delegate& rhs) const
 		{
-			return i_ != rhs.i_;
+			return pos_ != rhs.pos_;
 		}
 		entity operator*()
 		{
@@ -452,38 +703,47 @@ public:
 	protected:
 		view_iterator(entity_component_system* manager, std::uint32_t index)
 			: manager_(manager)
-			, i_(index)
-			, capacity_(manager_->capacity())
 			, free_cursor_(~0UL)
 		{
-			if(All)
-			{
-				std::sort(manager_->free_list_.begin(), manager_->free_list_.end());
-				free_cursor_ = 0;
-			}
+			mask_.set();
+			init(index);
 		}
+		/// index is a position in the iterated sequence, anything past the
+		/// end (e.g. capacity()) yields the end iterator.
 		view_iterator(entity_component_system* manager, const component_mask_t mask, std::uint32_t index)
 			: manager_(manager)
 			, mask_(mask)
-			, i_(index)
-			, capacity_(manager_->capacity())
 			, free_cursor_(~0UL)
+		{
+			init(index);
+		}
+
+		void init(std::uint32_t index)
 		{
 			if(All)
 			{
 				std::sort(manager_->free_list_.begin(), manager_->free_list_.end());
 				free_cursor_ = 0;
+				end_ = manager_->capacity();
 			}
+			else
+			{
+				entities_ = manager_->smallest_entity_set(mask_);
+				end_ = entities_ ? entities_->size() : 0;
+			}
+
+			pos_ = std::min<std::size_t>(index, end_);
+			i_ = static_cast<std::uint32_t>(pos_);
 		}
 
 		void next()
 		{
-			while(i_ < capacity_ && !predicate())
+			while(pos_ < end_ && !predicate())
 			{
-				++i_;
+				++pos_;
 			}
 
-			if(i_ < capacity_)
+			if(pos_ < end_)
 			{
 				entity entity = manager_->get(manager_->create_id(i_));
 				static_cast<Delegate*>(this)->next_entity(entity);
@@ -492,7 +752,17 @@ public:
 
 		inline bool predicate()
 		{
-			return (All && valid_entity()) || (manager_->entity_component_mask_[i_] & mask_) == mask_;
+			if(All)
+			{
+				i_ = static_cast<std::uint32_t>(pos_);
+				return valid_entity();
+			}
+
+			if(pos_ >= entities_->size())
+				return false;
+
+			i_ = (*entities_)[pos_];
+			return (manager_->entity_component_mask_[i_] & mask_) == mask_;
 		}
 
 		inline bool valid_entity()
@@ -508,8 +778,13 @@ public:
 
 		entity_component_system* manager_;
 		component_mask_t mask_;
-		std::uint32_t i_;
-		size_t capacity_;
+		/// Entity set driving the iteration when not iterating All.
+		const std::vector<std::uint32_t>* entities_ = nullptr;
+		/// Current entity index.
+		std::uint32_t i_ = 0;
+		/// Position in the iterated sequence.
+		size_t pos_ = 0;
+		size_t end_ = 0;
 		size_t free_cursor_;
 	};
 
@@ -562,6 +837,7 @@ public:
 		{
 		}
 
+	protected:
 		entity_component_system* manager_;
 		component_mask_t mask_;
 	};
@@ -576,10 +852,14 @@ public:
 			typedef T type;
 		};
 
+		/// Components are passed as plain references, they must not be
+		/// removed from inside f.
 		void each(typename identity<std::function<void(entity entity, Components&...)>>::type f)
 		{
+			auto manager = this->manager_;
+			iteration_scope scope(manager);
 			for(auto it : *this)
-				f(it, *(it.template get_component<Components>().lock().get())...);
+				f(it, manager->template get_component_ref<Components>(it.id().index())...);
 		}
 
 	private:
@@ -686,6 +966,101 @@ public:
 		unpacker unpacker_;
 	};
 
+	/// A persistent set of the entities matching a component mask.
+	/// Membership is kept up to date through the component and entity events,
+	/// so iterating it never looks at the component masks of other entities.
+	class registered_query
+	{
+	public:
+		registered_query(entity_component_system* manager, component_mask_t mask);
+		~registered_query();
+
+		registered_query(const registered_query&) = delete;
+		registered_query& operator=(const registered_query&) = delete;
+
+		const component_mask_t& mask() const
+		{
+			return mask_;
+		}
+
+		/// Matching entities, in no particular order.
+		const std::vector<entity>& entities() const
+		{
+			return entities_;
+		}
+
+	private:
+		void handle_component_added(entity e, chandle<component> handle);
+		void handle_component_removed(entity e, chandle<component> handle);
+		void handle_entity_destroyed(entity e);
+
+		bool owns(const entity& e) const;
+		void add(const entity& e);
+		void remove(const entity& e);
+
+		entity_component_system* manager_;
+		component_mask_t mask_;
+		/// Packed matching entities.
+		std::vector<entity> entities_;
+		/// Position of each entity index inside entities_ or ~0u.
+		std::vector<std::uint32_t> positions_;
+	};
+
+	template <typename... Components>
+	class typed_query
+	{
+	public:
+		template <typename T>
+		struct identity
+		{
+			typedef T type;
+		};
+
+		std::vector<entity>::const_iterator begin() const
+		{
+			return query_->entities().begin();
+		}
+		std::vector<entity>::const_iterator end() const
+		{
+			return query_->entities().end();
+		}
+		std::size_t size() const
+		{
+			return query_->entities().size();
+		}
+		bool empty() const
+		{
+			return query_->entities().empty();
+		}
+
+		/// Components are passed as plain references, they must not be
+		/// removed from inside f.
+		void each(typename identity<std::function<void(entity entity, Components&...)>>::type f)
+		{
+			// removals would also reorder the packed entities under the loop
+			iteration_scope scope(manager_);
+			const auto& entities = query_->entities();
+			for(std::size_t i = 0; i < entities.size(); ++i)
+			{
+				auto e = entities[i];
+				const auto index = e.id().index();
+				f(e, manager_->template get_component_ref<Components>(index)...);
+			}
+		}
+
+	private:
+		friend class entity_component_system;
+
+		typed_query(entity_component_system* manager, registered_query* query)
+			: manager_(manager)
+			, query_(query)
+		{
+		}
+
+		entity_component_system* manager_;
+		registered_query* query_;
+	};
+
 	/**
 	* Number of managed entities.
 	*/
@@ -785,7 +1160,7 @@ public:
 	chandle<C> assign(entity::id_t id, Args&&... args)
 	{
 		return std::static_pointer_cast<C>(
-			assign(id, std::make_shared<C>(std::forward<Args>(args)...)).lock());
+			assign(id, make_component<C>(std::forward<Args>(args)...)).lock());
 	}
 
 	chandle<component> assign(entity::id_t id, std::shared_ptr<component> comp);
@@ -857,6 +1232,18 @@ public:
 		return chandle<C>(pool->template get<C>(id.index()));
 	}
 
+	/**
+	* Retrieve a component by reference for an entity index known to have it.
+	*
+	* No validity checks and no reference counting, meant for iteration.
+	*/
+	template <typename C>
+	C& get_component_ref(std::uint32_t index)
+	{
+		auto family = rtti::type_index_sequential_t::id<component, C>();
+		return static_cast<C&>(*component_pools_[family]->get_raw(index));
+	}
+
 	template <typename... Components>
 	std::tuple<chandle<Components>...> components(entity::id_t id)
 	{
@@ -903,6 +1290,42 @@ public:
 		return entities_with_components<Components...>().each(f);
 	}
 
+	/**
+	* Entities whose component C was touched or assigned on or after frame
+	* (see core::simulation::get_frame_epoch), each listed once. Appends to result.
+	*
+	* @code
+	* ecs.changed_since<Position>(last_synced_frame, moved);
+	* @endcode
+	*/
+	template <typename C>
+	void changed_since(std::uint64_t frame, std::vector<entity>& result)
+	{
+		auto family = rtti::type_index_sequential_t::id<component, C>();
+		if(family >= component_pools_.size() || !component_pools_[family])
+			return;
+
+		changed_indices_.clear();
+		component_pools_[family]->changed_since(frame, changed_indices_);
+		for(auto index : changed_indices_)
+			result.emplace_back(this, create_id(index));
+	}
+
+	/**
+	* Cached version of entities_with_components for queries that run every
+	* frame. The first call registers the query, later calls reuse its
+	* incrementally maintained entity list.
+	*
+	* @code
+	* ecs.query<Position, Direction>().each([](entity e, Position& p, Direction& d) {});
+	* @endcode
+	*/
+	template <typename... Components>
+	typed_query<Components...> query()
+	{
+		return typed_query<Components...>(this, &get_query(component_mask<Components...>()));
+	}
+
 	/**
 	* Find Entities that have all of the specified Components and assign them
 	* to the given parameters.
@@ -986,6 +1409,12 @@ private:
 		return entity_component_mask_.at(id.index());
 	}
 
+	registered_query& get_query(const component_mask_t& mask);
+
+	/// The smallest entity set among the components of mask or nullptr if
+	/// nothing can match.
+	const std::vector<std::uint32_t>* smallest_entity_set(const component_mask_t& mask) const;
+
 	component_mask_t component_mask(entity::id_t id) const
 	{
 		assert_valid(id);
@@ -1017,6 +1446,28 @@ private:
 		return component_mask<C1, Components...>();
 	}
 
+	/// Marks a running each() so removals from inside it are caught in debug
+	/// builds, see check_not_iterating.
+	struct iteration_scope
+	{
+		explicit iteration_scope(entity_component_system* manager)
+			: manager_(manager)
+		{
+			++manager_->iterating_;
+		}
+		~iteration_scope()
+		{
+			--manager_->iterating_;
+		}
+
+		entity_component_system* manager_;
+	};
+
+	inline void check_not_iterating() const
+	{
+		assert(iterating_ == 0 && "components removed or entities destroyed while iterating");
+	}
+
 	inline void accomodate_entity(std::uint32_t index)
 	{
 		if(entity_component_mask_.size() <= index)
@@ -1069,6 +1520,13 @@ private:
 	std::vector<std::uint32_t> free_list_;
 
 	std::unordered_map<std::uint64_t, std::string> entity_names_;
+	// Queries registered through query<Components...>().
+	std::vector<std::unique_ptr<registered_query>> queries_;
+	// Scratch buffer for changed_since.
+	std::vector<std::uint32_t> changed_indices_;
+	// Number of each() calls running, views hand out plain component
+	// references that a removal would leave dangling.
+	std::atomic<std::uint32_t> iterating_{0};
 };
 
 template <typename C, typename... Args>
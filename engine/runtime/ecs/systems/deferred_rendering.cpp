@@ -6,6 +6,7 @@
 #include "../../rendering/mesh.h"
 #include "../../rendering/model.h"
 #include "../../rendering/render_pass.h"
+#include "../../rendering/shader.h"
 #include "../../rendering/texture.h"
 #include "../../rendering/vertex_buffer.h"
 #include "../../system/engine.h"
@@ -14,148 +15,142 @@
 #include "../components/model_component.h"
 #include "../components/reflection_probe_component.h"
 #include "../components/transform_component.h"
+#include "scene_graph.h"
 
 namespace runtime
 {
-camera get_face_camera(std::uint32_t face, const math::transform& transform)
-{
-	camera cam;
-	cam.set_fov(90.0f);
-	cam.set_aspect_ratio(1.0f, true);
-	cam.set_near_clip(0.01f);
-	cam.set_far_clip(256.0f);
-
-	// Configurable axis vectors used to construct view matrices. In the
-	// case of the omni light, we align all frustums to the world axes.
-	math::vec3 X(1, 0, 0);
-	math::vec3 Y(0, 1, 0);
-	math::vec3 Z(0, 0, 1);
-	math::vec3 Zero(0, 0, 0);
-	math::transform t;
-	// Generate the correct view matrix for the frustum
-	if(!gfx::is_origin_bottom_left())
-	{
-		switch(face)
-		{
-			case 0:
-				t.set_rotation(-Z, +Y, +X);
-				break;
-			case 1:
-				t.set_rotation(+Z, +Y, -X);
-				break;
-			case 2:
-				t.set_rotation(+X, -Z, +Y);
-				break;
-			case 3:
-				t.set_rotation(+X, +Z, -Y);
-				break;
-			case 4:
-				t.set_rotation(+X, +Y, +Z);
-				break;
-			case 5:
-				t.set_rotation(-X, +Y, -Z);
-				break;
-		}
-	}
-	else
-	{
-		switch(face)
-		{
-			case 0:
-				t.set_rotation(-Z, +Y, +X);
-				break;
-			case 1:
-				t.set_rotation(+Z, +Y, -X);
-				break;
-			case 3:
-				t.set_rotation(+X, -Z, +Y);
-				break;
-			case 2:
-				t.set_rotation(+X, +Z, -Y);
-				break;
-			case 4:
-				t.set_rotation(+X, +Y, +Z);
-				break;
-			case 5:
-				t.set_rotation(-X, +Y, -Z);
-				break;
-		}
-	}
+// Marks entities waiting in _spatial_pending.
+static const std::int32_t pending_proxy = -2;
 
-	t = transform * t;
-	// First update so the camera can cache the previous matrices
-	cam.record_current_matrices();
-	// Set new transform
-	cam.look_at(t.get_position(), t.get_position() + t.z_unit_axis(), t.y_unit_axis());
-
-	return cam;
+namespace
+{
+// Uniforms of the passes, resolved once.
+const auto s_tex0 = program::resolve_uniform("s_tex0");
+const auto s_tex1 = program::resolve_uniform("s_tex1");
+const auto s_tex2 = program::resolve_uniform("s_tex2");
+const auto s_tex3 = program::resolve_uniform("s_tex3");
+const auto s_tex4 = program::resolve_uniform("s_tex4");
+const auto s_tex5 = program::resolve_uniform("s_tex5");
+const auto s_tex6 = program::resolve_uniform("s_tex6");
+const auto s_tex7 = program::resolve_uniform("s_tex7");
+const auto s_tex8 = program::resolve_uniform("s_tex8");
+const auto s_tex9 = program::resolve_uniform("s_tex9");
+const auto s_input = program::resolve_uniform("s_input");
+const auto s_tex_cube = program::resolve_uniform("s_tex_cube");
+const auto u_camera_clip_planes = program::resolve_uniform("u_camera_clip_planes");
+const auto u_camera_position = program::resolve_uniform("u_camera_position");
+const auto u_camera_wpos = program::resolve_uniform("u_camera_wpos");
+const auto u_cluster_depth = program::resolve_uniform("u_cluster_depth");
+const auto u_cluster_size = program::resolve_uniform("u_cluster_size");
+const auto u_data0 = program::resolve_uniform("u_data0");
+const auto u_data1 = program::resolve_uniform("u_data1");
+const auto u_data2 = program::resolve_uniform("u_data2");
+const auto u_inv_world = program::resolve_uniform("u_inv_world");
+const auto u_light_color_intensity = program::resolve_uniform("u_light_color_intensity");
+const auto u_light_data = program::resolve_uniform("u_light_data");
+const auto u_light_direction = program::resolve_uniform("u_light_direction");
+const auto u_light_position = program::resolve_uniform("u_light_position");
+const auto u_lod_params = program::resolve_uniform("u_lod_params");
+
+// rows of the clustered light data texture, the shader loop is bound to it
+const std::size_t max_clustered_lights = 256;
+
+const std::uint32_t cluster_sampler_flags = BGFX_TEXTURE_MIN_POINT | BGFX_TEXTURE_MAG_POINT |
+											BGFX_TEXTURE_MIP_POINT | BGFX_TEXTURE_U_CLAMP |
+											BGFX_TEXTURE_V_CLAMP;
+
+// order of the passes of a chain, see deferred_rendering::begin_chain
+enum chain_pass : std::uint32_t
+{
+	g_buffer_fill = 0,
+	refl_buffer_fill,
+	light_buffer_fill,
+	atmospherics_fill,
+	output_buffer_fill,
+	cubemap_fill
+};
+
+gfx::TextureFormat::Enum get_light_buffer_format()
+{
+	static auto format =
+		gfx::get_best_format(BGFX_CAPS_FORMAT_TEXTURE_FRAMEBUFFER,
+							 gfx::format_search_flags::FourChannels | gfx::format_search_flags::RequireAlpha |
+								 gfx::format_search_flags::HalfPrecisionFloat);
+	return format;
 }
 
-void update_lod_data(lod_data& data, std::size_t total_lods, float min_dist, float max_dist,
-					 float transition_time, float distance, float dt)
+// the cluster textures are only created again when their size changes
+void update_cluster_texture(texture& tex, std::uint16_t width, std::uint16_t height,
+							gfx::TextureFormat::Enum format)
 {
-	if(total_lods <= 1)
+	if(tex.is_valid() && tex.info.width == width && tex.info.height == height)
 		return;
 
-	total_lods -= 1;
+	tex.populate(width, height, false, 1, format, cluster_sampler_flags);
+}
+
+bool supports_clustered_lighting()
+{
+	const auto caps = gfx::getCaps();
+	auto supported = [caps](gfx::TextureFormat::Enum format) {
+		return (caps->formats[format] & BGFX_CAPS_FORMAT_TEXTURE_2D) != 0;
+	};
+	return supported(gfx::TextureFormat::R32F) && supported(gfx::TextureFormat::RG32F) &&
+		   supported(gfx::TextureFormat::RGBA32F);
+}
+}
+
+void update_lod_data(lod_data& data, const lod_request& request, float dt)
+{
+	// Only move to another lod once the metric is past the edges of the
+	// target band by the hysteresis.
+	const float value = request.factor * static_cast<float>(request.max_lod);
+	const float upper = std::min(float(data.target_lod_index + 1) + request.hysteresis, float(request.max_lod));
+	const float lower = float(data.target_lod_index) - request.hysteresis;
+	std::uint32_t lod = data.target_lod_index;
+	if(value >= upper || value <= lower)
+		lod = std::min(static_cast<std::uint32_t>(value), request.max_lod);
 
-	const float factor = 1.0f - math::clamp((max_dist - distance) / (max_dist - min_dist), 0.0f, 1.0f);
-	const int lod = (int)math::lerp(0.0f, static_cast<float>(total_lods), factor);
 	if(data.target_lod_index != lod && data.target_lod_index == data.current_lod_index)
 		data.target_lod_index = lod;
 
 	if(data.current_lod_index != data.target_lod_index)
 		data.current_time += dt;
 
-	if(data.current_time >= transition_time)
+	if(data.current_time >= request.transition_time)
 	{
 		data.current_lod_index = data.target_lod_index;
 		data.current_time = 0.0f;
 	}
 }
 
-bool should_rebuild_reflections(visibility_set_models_t& visibility_set, const reflection_probe& probe)
+std::uint32_t get_dirty_reflection_faces(const std::vector<math::bbox>& dirty_bounds,
+										 std::vector<std::uint32_t>& visible,
+										 reflection_probe_component& probe_comp,
+										 const math::transform& world_transform)
 {
+	if(dirty_bounds.empty())
+		return 0;
 
-	if(probe.method == reflect_method::environment)
-		return false;
+	visible.resize((dirty_bounds.size() + 31) / 32);
 
-	for(auto& element : visibility_set)
+	std::uint32_t faces = 0;
+	for(std::uint32_t i = 0; i < 6; ++i)
 	{
-		auto& e = std::get<0>(element);
-		auto& transform_comp_handle = std::get<1>(element);
-		auto& model_comp_handle = std::get<2>(element);
-		auto transform_comp_ptr = transform_comp_handle.lock();
-		auto model_comp_ptr = model_comp_handle.lock();
-		if(!transform_comp_ptr || !model_comp_ptr)
-			continue;
-
-		auto& transform_comp_ref = *transform_comp_ptr.get();
-		auto& model_comp_ref = *model_comp_ptr.get();
-
-		const auto& model = model_comp_ref.get_model();
-		if(!model.is_valid())
-			continue;
-
-		const auto mesh = model.get_lod(0);
-
-		const auto& world_transform = transform_comp_ref.get_transform();
-
-		const auto& bounds = mesh->get_bounds();
-
-		bool result = false;
+		const auto& frustum = probe_comp.get_face_camera(i, world_transform).get_frustum();
+		frustum.test_aabbs(dirty_bounds.data(), dirty_bounds.size(), visible.data());
 
-		for(std::uint32_t i = 0; i < 6; ++i)
+		for(auto bits : visible)
 		{
-			const auto& frustum = get_face_camera(i, world_transform).get_frustum();
-			result |= math::frustum::test_obb(frustum, bounds, world_transform);
+			if(bits != 0)
+			{
+				faces |= 1u << i;
+				break;
+			}
 		}
-
-		if(result)
-			return true;
 	}
 
-	return false;
+	return faces;
 }
 
 visibility_set_models_t deferred_rendering::gather_visible_models(entity_component_system& ecs,
@@ -165,30 +160,31 @@ visibility_set_models_t deferred_rendering::gather_visible_models(entity_compone
 																  bool require_reflection_caster /*= false*/)
 {
 	visibility_set_models_t result;
-	chandle<transform_component> transform_comp_handle;
-	chandle<model_component> model_comp_handle;
-	for(auto entity : ecs.entities_with_components(transform_comp_handle, model_comp_handle))
-	{
+
+	auto gather = [&](entity entity, bool test_bounds) {
+		auto transform_comp_handle = entity.get_component<transform_component>();
+		auto model_comp_handle = entity.get_component<model_component>();
 		auto model_comp_ptr = model_comp_handle.lock();
 		auto transform_comp_ptr = transform_comp_handle.lock();
 
 		if(static_only && !model_comp_ptr->is_static())
 		{
-			continue;
+			return;
 		}
 
 		if(require_reflection_caster && !model_comp_ptr->casts_reflection())
 		{
-			continue;
+			return;
 		}
 
 		auto mesh = model_comp_ptr->get_model().get_lod(0);
 
 		// If mesh isnt loaded yet skip it.
 		if(!mesh)
-			continue;
+			return;
 
-		if(camera)
+		// Test the bounding box of the mesh
+		if(test_bounds)
 		{
 			const auto& frustum = camera->get_frustum();
 
@@ -196,83 +192,319 @@ visibility_set_models_t deferred_rendering::gather_visible_models(entity_compone
 
 			const auto& bounds = mesh->get_bounds();
 
-			// Test the bounding box of the mesh
-			if(math::frustum::test_obb(frustum, bounds, world_transform))
-			{
-				// Only dirty mesh components.
-				if(dirty_only)
-				{
-					if(transform_comp_ptr->is_dirty() || model_comp_ptr->is_dirty())
-					{
-						result.push_back(std::make_tuple(entity, transform_comp_handle, model_comp_handle));
-					}
-				} // End if dirty_only
-				else
-				{
-					result.push_back(std::make_tuple(entity, transform_comp_handle, model_comp_handle));
-				}
-
-			} // Enf if visble
+			if(!math::frustum::test_obb(frustum, bounds, world_transform))
+				return;
 		}
-		else
+
+		// Only dirty mesh components.
+		if(dirty_only)
 		{
-			// Only dirty mesh components.
-			if(dirty_only)
-			{
-				if(transform_comp_ptr->is_dirty() || model_comp_ptr->is_dirty())
-				{
-					result.push_back(std::make_tuple(entity, transform_comp_handle, model_comp_handle));
-				}
-			} // End if dirty_only
-			else
+			if(transform_comp_ptr->is_dirty() || model_comp_ptr->is_dirty())
 			{
 				result.push_back(std::make_tuple(entity, transform_comp_handle, model_comp_handle));
 			}
+		} // End if dirty_only
+		else
+		{
+			result.push_back(std::make_tuple(entity, transform_comp_handle, model_comp_handle));
+		}
+	};
+
+	if(camera)
+	{
+		// Whole subtrees of the index are accepted or rejected at once, only
+		// boxes crossing the frustum planes need the exact test.
+		_spatial_index.query(camera->get_frustum(), [&](std::uint32_t index, bool inside) {
+			gather(ecs.get(ecs.create_id(index)), !inside);
+		});
+	}
+	else
+	{
+		for(auto entity : ecs.query<transform_component, model_component>())
+		{
+			gather(entity, false);
 		}
 	}
+
 	return result;
 }
 
+void deferred_rendering::update_spatial_index(entity_component_system& ecs)
+{
+	auto& sg = core::get_subsystem<scene_graph>();
+
+	auto pending = std::move(_spatial_pending);
+	_spatial_pending.clear();
+	for(auto e : pending)
+	{
+		const auto index = e.id().index();
+		if(_spatial_proxies[index] == pending_proxy)
+			_spatial_proxies[index] = math::aabb_tree::null_node;
+	}
+	for(auto e : pending)
+	{
+		if(e.valid())
+			update_spatial_proxy(e);
+	}
+
+	for(auto e : sg.get_resolved())
+	{
+		if(e.valid())
+			update_spatial_proxy(e);
+	}
+
+	_spatial_changed.clear();
+	ecs.changed_since<model_component>(_spatial_frame, _spatial_changed);
+	for(auto e : _spatial_changed)
+	{
+		update_spatial_proxy(e);
+	}
+
+	_spatial_frame = core::simulation::get_frame_epoch();
+}
+
+void deferred_rendering::update_spatial_proxy(entity e)
+{
+	const auto index = e.id().index();
+	if(_spatial_proxies.size() <= index)
+		_spatial_proxies.resize(index + 1, math::aabb_tree::null_node);
+
+	auto transform_comp_ptr = e.get_component<transform_component>().lock();
+	auto model_comp_ptr = e.get_component<model_component>().lock();
+	if(!transform_comp_ptr || !model_comp_ptr)
+	{
+		remove_spatial_proxy(index);
+		return;
+	}
+
+	auto mesh = model_comp_ptr->get_model().get_lod(0);
+	if(!mesh)
+	{
+		// Bounds are unknown until the mesh is loaded.
+		if(_spatial_proxies[index] != pending_proxy)
+		{
+			remove_spatial_proxy(index);
+			_spatial_proxies[index] = pending_proxy;
+			_spatial_pending.push_back(e);
+		}
+		return;
+	}
+
+	auto& proxy = _spatial_proxies[index];
+	const auto bounds = math::bbox::mul(mesh->get_bounds(), transform_comp_ptr->get_transform());
+	if(proxy >= 0)
+		_spatial_index.update(proxy, bounds);
+	else
+		proxy = _spatial_index.insert(bounds, index);
+}
+
+void deferred_rendering::remove_spatial_proxy(std::uint32_t index)
+{
+	if(index >= _spatial_proxies.size())
+		return;
+
+	auto& proxy = _spatial_proxies[index];
+	if(proxy >= 0)
+		_spatial_index.remove(proxy);
+
+	proxy = math::aabb_tree::null_node;
+}
+
 void deferred_rendering::frame_render(std::chrono::duration<float> dt)
 {
 	auto& ecs = core::get_subsystem<entity_component_system>();
 
+	update_spatial_index(ecs);
+
 	build_reflections_pass(ecs, dt);
 	build_shadows_pass(ecs, dt);
 	camera_pass(ecs, dt);
+
+	_render_queue_stats = _frame_queue_stats;
+	_frame_queue_stats = render_queue_stats();
+	_light_cluster_stats = _frame_cluster_stats;
+	_frame_cluster_stats = light_cluster_stats();
+	_transient_pool.end_frame();
 }
 
-void deferred_rendering::build_reflections_pass(entity_component_system& ecs, std::chrono::duration<float> dt)
+const render_queue_stats& deferred_rendering::get_render_queue_stats() const
 {
-	auto dirty_models = gather_visible_models(ecs, nullptr, true, true, true);
-	ecs.each<transform_component, reflection_probe_component>([this, &ecs, dt, &dirty_models](
-		entity ce, transform_component& transform_comp, reflection_probe_component& reflection_probe_comp) {
-		const auto& world_tranform = transform_comp.get_transform();
-		const auto& probe = reflection_probe_comp.get_probe();
+	return _render_queue_stats;
+}
 
-		auto cubemap_fbo = reflection_probe_comp.get_cubemap_fbo();
-		bool should_rebuild = true;
+const light_cluster_stats& deferred_rendering::get_light_cluster_stats() const
+{
+	return _light_cluster_stats;
+}
 
-		if(!transform_comp.is_dirty() && !reflection_probe_comp.is_dirty())
+const transient_pool_stats& deferred_rendering::get_transient_pool_stats() const
+{
+	return _transient_pool.get_stats();
+}
+
+void deferred_rendering::begin_chain(const usize& viewport_size, bool transient_outputs)
+{
+	_transient_pool.reset();
+
+	auto declare = [this, &viewport_size](gfx::TextureFormat::Enum format) {
+		transient_pool::texture_desc desc;
+		desc.width = std::uint16_t(viewport_size.width);
+		desc.height = std::uint16_t(viewport_size.height);
+		desc.format = format;
+		return _transient_pool.declare(desc);
+	};
+
+	_chain = chain_targets();
+	_chain.transient_outputs = transient_outputs;
+	if(transient_outputs)
+	{
+		for(std::uint32_t i = 0; i < 4; ++i)
 		{
-			// If reflections shouldn't be rebuilt - continue.
-			should_rebuild = should_rebuild_reflections(dirty_models, probe);
+			_chain.g_buffer[i] = declare(render_view::get_g_buffer_format(i));
+			_transient_pool.write(_chain.g_buffer[i], g_buffer_fill);
+			_transient_pool.read(_chain.g_buffer[i], light_buffer_fill);
 		}
 
-		if(!should_rebuild)
-			return;
+		_chain.depth = declare(render_view::get_depth_stencil_format());
+		_transient_pool.write(_chain.depth, g_buffer_fill);
+		_transient_pool.read(_chain.depth, output_buffer_fill);
+
+		_chain.output = declare(render_view::get_output_format());
+		_transient_pool.write(_chain.output, output_buffer_fill);
+		_transient_pool.read(_chain.output, cubemap_fill);
+	}
+
+	_chain.refl_buffer = declare(get_light_buffer_format());
+	_transient_pool.write(_chain.refl_buffer, refl_buffer_fill);
+	_transient_pool.read(_chain.refl_buffer, light_buffer_fill);
+
+	_chain.light_buffer = declare(get_light_buffer_format());
+	_transient_pool.write(_chain.light_buffer, light_buffer_fill);
+	_transient_pool.write(_chain.light_buffer, atmospherics_fill);
+	_transient_pool.read(_chain.light_buffer, output_buffer_fill);
+
+	_transient_pool.compile();
+}
+
+void deferred_rendering::end_chain()
+{
+	_transient_pool.reset();
+	_chain = chain_targets();
+}
+
+std::shared_ptr<frame_buffer> deferred_rendering::get_g_buffer_fbo(render_view& render_view,
+																  const usize& viewport_size)
+{
+	if(!_chain.transient_outputs)
+		return render_view.get_g_buffer_fbo(viewport_size);
+
+	return _transient_pool.get_fbo(
+		{_transient_pool.get(_chain.g_buffer[0]), _transient_pool.get(_chain.g_buffer[1]),
+		 _transient_pool.get(_chain.g_buffer[2]), _transient_pool.get(_chain.g_buffer[3]),
+		 _transient_pool.get(_chain.depth)});
+}
 
-		// iterate trough each cube face
-		for(std::uint32_t i = 0; i < 6; ++i)
+std::shared_ptr<texture> deferred_rendering::get_depth_stencil_buffer(render_view& render_view,
+																	  const usize& viewport_size)
+{
+	if(!_chain.transient_outputs)
+		return render_view.get_depth_stencil_buffer(viewport_size);
+
+	return _transient_pool.get(_chain.depth);
+}
+
+std::shared_ptr<frame_buffer> deferred_rendering::get_output_fbo(render_view& render_view,
+																const usize& viewport_size)
+{
+	if(!_chain.transient_outputs)
+		return render_view.get_output_fbo(viewport_size);
+
+	return _transient_pool.get_fbo({_transient_pool.get(_chain.output), _transient_pool.get(_chain.depth)});
+}
+
+void deferred_rendering::build_reflections_pass(entity_component_system& ecs, std::chrono::duration<float> dt)
+{
+	// World bounds of the static reflection casters that changed, shared by all probes.
+	_reflection_dirty_bounds.clear();
+	auto dirty_models = gather_visible_models(ecs, nullptr, true, true, true);
+	for(auto& element : dirty_models)
+	{
+		auto transform_comp_ptr = std::get<1>(element).lock();
+		auto model_comp_ptr = std::get<2>(element).lock();
+		if(!transform_comp_ptr || !model_comp_ptr)
+			continue;
+
+		const auto& model = model_comp_ptr->get_model();
+		if(!model.is_valid())
+			continue;
+
+		const auto mesh = model.get_lod(0);
+		if(!mesh)
+			continue;
+
+		_reflection_dirty_bounds.push_back(
+			math::bbox::mul(mesh->get_bounds(), transform_comp_ptr->get_transform()));
+	}
+
+	_reflection_probes.clear();
+	ecs.each<transform_component, reflection_probe_component>(
+		[this](entity ce, transform_component& transform_comp, reflection_probe_component& reflection_probe_comp) {
+			const auto& probe = reflection_probe_comp.get_probe();
+
+			if(transform_comp.is_dirty() || reflection_probe_comp.is_dirty())
+			{
+				reflection_probe_comp.queue_faces(reflection_probe_component::all_faces);
+			}
+			else if(probe.method != reflect_method::environment)
+			{
+				// Only the faces that can see a changed model need to be rendered again.
+				reflection_probe_comp.queue_faces(get_dirty_reflection_faces(
+					_reflection_dirty_bounds, _reflection_visible, reflection_probe_comp,
+					transform_comp.get_transform()));
+			}
+
+			if(reflection_probe_comp.get_pending_faces() != 0)
+				_reflection_probes.push_back(ce);
+		});
+
+	if(_reflection_probes.empty())
+		return;
+
+	// Spread the faces over frames, starting from a different probe each frame
+	// so that a probe which is always dirty cannot starve the others.
+	auto budget = _reflection_face_budget;
+	const auto count = _reflection_probes.size();
+	const auto first = _reflection_probe_cursor % count;
+	const auto first_face = static_cast<std::uint32_t>(_reflection_probe_cursor % 6);
+	++_reflection_probe_cursor;
+	for(std::size_t n = 0; n < count && budget > 0; ++n)
+	{
+		auto ce = _reflection_probes[(first + n) % count];
+		auto transform_comp = ce.get_component<transform_component>().lock();
+		auto reflection_probe_comp = ce.get_component<reflection_probe_component>().lock();
+
+		const auto& world_tranform = transform_comp->get_transform();
+		const auto& probe = reflection_probe_comp->get_probe();
+		auto cubemap_fbo = reflection_probe_comp->get_cubemap_fbo();
+		auto& camera_lods = _lod_data[ce];
+
+		// iterate trough each pending cube face
+		for(std::uint32_t j = 0; j < 6 && budget > 0; ++j)
 		{
-			auto camera = get_face_camera(i, world_tranform);
-			auto& render_view = reflection_probe_comp.get_render_view(i);
+			const auto i = (first_face + j) % 6;
+			if(!(reflection_probe_comp->get_pending_faces() & (1u << i)))
+				continue;
+
+			auto& camera = reflection_probe_comp->get_face_camera(i, world_tranform);
+			auto& render_view = reflection_probe_comp->get_render_view(i);
 			camera.set_viewport_size(cubemap_fbo->get_size());
-			auto& camera_lods = _lod_data[ce];
 			visibility_set_models_t visibility_set;
 
 			if(probe.method != reflect_method::environment)
-				visibility_set = gather_visible_models(ecs, &camera, !should_rebuild, true, true);
+				visibility_set = gather_visible_models(ecs, &camera, false, true, true);
+
+			// nothing reads the face targets after the blit, they are all shared
+			begin_chain(camera.get_viewport_size(), true);
 
 			std::shared_ptr<frame_buffer> output = nullptr;
 			output = g_buffer_pass(output, camera, render_view, visibility_set, camera_lods, dt);
@@ -283,12 +515,26 @@ void deferred_rendering::build_reflections_pass(entity_component_system& ecs, st
 			render_pass pass("cubemap_fill");
 			gfx::blit(pass.id, gfx::getTexture(cubemap_fbo->handle), 0, 0, 0, i,
 					  gfx::getTexture(output->handle));
+
+			end_chain();
+
+			reflection_probe_comp->clear_pending_face(i);
+			--budget;
 		}
 
 		render_pass pass("cubemap_generate_mips");
 		pass.bind(cubemap_fbo.get());
+	}
+}
 
-	});
+void deferred_rendering::set_reflection_face_budget(std::uint32_t faces)
+{
+	_reflection_face_budget = faces;
+}
+
+std::uint32_t deferred_rendering::get_reflection_face_budget() const
+{
+	return _reflection_face_budget;
 }
 
 void deferred_rendering::build_shadows_pass(entity_component_system& ecs, std::chrono::duration<float> dt)
@@ -308,12 +554,15 @@ void deferred_rendering::camera_pass(entity_component_system& ecs, std::chrono::
 
 std::shared_ptr<frame_buffer> deferred_rendering::deferred_render_full(
 	camera& camera, render_view& render_view, entity_component_system& ecs,
-	std::unordered_map<entity, lod_data>& camera_lods, std::chrono::duration<float> dt)
+	camera_lods_t& camera_lods, std::chrono::duration<float> dt)
 {
 	std::shared_ptr<frame_buffer> output = nullptr;
 
 	auto visibility_set = gather_visible_models(ecs, &camera, false, false, false);
 
+	// The g-buffer and output stay in the render view, others read them later.
+	begin_chain(camera.get_viewport_size(), false);
+
 	output = g_buffer_pass(output, camera, render_view, visibility_set, camera_lods, dt);
 
 	output = reflection_probe_pass(output, camera, render_view, ecs, dt);
@@ -324,105 +573,201 @@ std::shared_ptr<frame_buffer> deferred_rendering::deferred_render_full(
 
 	output = tonemapping_pass(output, camera, render_view);
 
+	end_chain();
+
 	return output;
 }
 
 std::shared_ptr<frame_buffer>
 deferred_rendering::g_buffer_pass(std::shared_ptr<frame_buffer> input, camera& camera,
 								  render_view& render_view, visibility_set_models_t& visibility_set,
-								  std::unordered_map<entity, lod_data>& camera_lods,
+								  camera_lods_t& camera_lods,
 								  std::chrono::duration<float> dt)
 {
 	const auto& view = camera.get_view();
 	const auto& proj = camera.get_projection();
 	const auto& viewport_size = camera.get_viewport_size();
-	auto g_buffer_fbo = render_view.get_g_buffer_fbo(viewport_size);
+	auto g_buffer_fbo = get_g_buffer_fbo(render_view, viewport_size);
 
 	render_pass pass("g_buffer_fill");
 	pass.bind(g_buffer_fbo.get());
 	pass.clear();
 	pass.set_view_proj(view, proj);
 
-	for(auto& element : visibility_set)
-	{
-		auto& e = std::get<0>(element);
-		auto& transform_comp_handle = std::get<1>(element);
-		auto& model_comp_handle = std::get<2>(element);
-		auto transform_comp_ptr = transform_comp_handle.lock();
-		auto model_comp_ptr = model_comp_handle.lock();
-		if(!transform_comp_ptr || !model_comp_ptr)
-			continue;
+	const auto camera_pos = camera.get_position();
+	const auto clip_planes = math::vec2(camera.get_near_clip(), camera.get_far_clip());
 
-		auto& transform_comp_ref = *transform_comp_ptr.get();
-		auto& model_comp_ref = *model_comp_ptr.get();
+	select_lods(camera, visibility_set, camera_lods, dt);
 
-		const auto& model = model_comp_ref.get_model();
-		if(!model.is_valid())
-			continue;
+	auto& ts = core::get_subsystem<core::task_system>();
+	ts.parallel_for(0, visibility_set.size(), 0, [&](std::size_t begin, std::size_t end) {
+		render_queue::recorder recorder(_render_queue);
+		for(auto i = begin; i < end; ++i)
+		{
+			auto& element = visibility_set[i];
+			auto transform_comp_ptr = std::get<1>(element).lock();
+			auto model_comp_ptr = std::get<2>(element).lock();
+			if(!transform_comp_ptr || !model_comp_ptr)
+				continue;
 
-		const auto& world_transform = transform_comp_ref.get_transform();
-		const auto clip_planes = math::vec2(camera.get_near_clip(), camera.get_far_clip());
-
-		auto& lod_data = camera_lods[e];
-		const auto transition_time = model.get_lod_transition_time();
-		const auto min_distance = model.get_lod_min_distance();
-		const auto max_distance = model.get_lod_max_distance();
-		const auto lod_count = model.get_lods().size();
-		const auto current_time = lod_data.current_time;
-		const auto current_lod_index = lod_data.current_lod_index;
-		const auto target_lod_index = lod_data.target_lod_index;
-
-		const auto current_mesh = model.get_lod(current_lod_index);
-		if(!current_mesh)
-			continue;
-		;
+			const auto& model = model_comp_ptr->get_model();
+			if(!model.is_valid())
+				continue;
 
-		if(model.get_lods().size() > 1)
-		{
-			const auto& bounds = current_mesh->get_bounds();
+			const auto& world_transform = _world_transforms[i];
+
+			const auto& lod_data = *_lod_data_refs[i];
+			const auto transition_time = model.get_lod_transition_time();
+			const auto current_time = lod_data.current_time;
+			const auto current_lod_index = lod_data.current_lod_index;
+			const auto target_lod_index = lod_data.target_lod_index;
+
+			if(!model.get_lod(current_lod_index))
+				continue;
 
-			float t = 0.0f;
-			const auto ray_origin = camera.get_position();
-			const auto inv_world = math::inverse(world_transform);
-			const auto object_ray_origin = inv_world.transform_coord(ray_origin);
-			const auto object_ray_direction = math::normalize(bounds.get_center() - object_ray_origin);
-			bounds.intersect(object_ray_origin, object_ray_direction, t);
+			const auto params = math::vec4{0.0f, -1.0f, (transition_time - current_time) / transition_time, 0.0f};
+			const auto params_inv = math::vec4{1.0f, 1.0f, current_time / transition_time, 0.0f};
 
-			// Compute final object space intersection point.
-			auto intersection_point = object_ray_origin + (object_ray_direction * t);
+			// front to back within the same state
+			const auto depth = math::length(world_transform.get_position() - camera_pos) / clip_planes.y;
 
-			// transform intersection point back into world space to compute
-			// the final intersection distance.
-			intersection_point = world_transform.transform_coord(intersection_point);
-			const float distance = math::length(intersection_point - ray_origin);
+			// skinning matrices are computed here in parallel and shared by the passes
+			auto& skinning = model_comp_ptr->get_skinning_cache();
+			model.record(recorder, world_transform, 0, depth, true, true, true, 0, current_lod_index, params,
+						 &skinning);
 
-			// Compute Lods
-			update_lod_data(lod_data, lod_count, min_distance, max_distance, transition_time, distance,
-							dt.count());
+			if(current_time != 0.0f)
+			{
+				model.record(recorder, world_transform, 0, depth, true, true, true, 0, target_lod_index,
+							 params_inv, &skinning);
+			}
 		}
+	});
 
-		const auto params = math::vec3{0.0f, -1.0f, (transition_time - current_time) / transition_time};
+	_frame_queue_stats += _render_queue.flush(pass.id,
+											  [&camera_pos, &clip_planes](program& p) {
+												  p.set_uniform(u_camera_wpos, &camera_pos);
+												  p.set_uniform(u_camera_clip_planes, &clip_planes);
+											  },
+											  [](program& p, const draw_item& item) {
+												  p.set_uniform(u_lod_params, &item.params);
+											  });
 
-		const auto params_inv = math::vec3{1.0f, 1.0f, current_time / transition_time};
+	return g_buffer_fbo;
+}
 
-		model.render(pass.id, world_transform, true, true, true, 0, current_lod_index, nullptr,
-					 [&camera, &clip_planes, &params](program& p) {
-						 auto camera_pos = camera.get_position();
-						 p.set_uniform("u_camera_wpos", &camera_pos);
-						 p.set_uniform("u_camera_clip_planes", &clip_planes);
-						 p.set_uniform("u_lod_params", &params);
-					 });
+void deferred_rendering::select_lods(camera& camera, visibility_set_models_t& visibility_set,
+									 camera_lods_t& camera_lods, std::chrono::duration<float> dt)
+{
+	// The state is looked up by entity index, a slot whose entity changed
+	// starts over so destroyed entities need no cleanup.
+	std::uint32_t slots = std::uint32_t(camera_lods.size());
+	for(const auto& element : visibility_set)
+	{
+		slots = std::max(slots, std::get<0>(element).id().index() + 1);
+	}
+	camera_lods.resize(slots);
 
-		if(current_time != 0.0f)
+	// Resolving a transform writes its world matrix and the ones of its
+	// parents, so the matrices are read here once for the parallel loops.
+	_lod_data_refs.clear();
+	_world_transforms.clear();
+	for(const auto& element : visibility_set)
+	{
+		const auto id = std::get<0>(element).id();
+		auto& data = camera_lods[id.index()];
+		if(data.id != id)
 		{
-			model.render(pass.id, world_transform, true, true, true, 0, target_lod_index, nullptr,
-						 [&camera, &clip_planes, &params_inv](program& p) {
-							 p.set_uniform("u_lod_params", &params_inv);
-						 });
+			data = lod_data();
+			data.id = id;
 		}
+		_lod_data_refs.push_back(&data);
+
+		auto transform_comp_ptr = std::get<1>(element).lock();
+		_world_transforms.push_back(transform_comp_ptr ? transform_comp_ptr->get_transform()
+													   : math::transform::identity);
 	}
 
-	return g_buffer_fbo;
+	const auto& view = camera.get_view();
+	const auto& proj = camera.get_projection();
+	const auto camera_pos = camera.get_position();
+
+	// Metrics of all the models at once.
+	_lod_requests.resize(visibility_set.size());
+	auto& ts = core::get_subsystem<core::task_system>();
+	ts.parallel_for(0, visibility_set.size(), 0, [&](std::size_t begin, std::size_t end) {
+		for(auto i = begin; i < end; ++i)
+		{
+			auto& request = _lod_requests[i];
+			request = lod_request();
+
+			auto& element = visibility_set[i];
+			auto transform_comp_ptr = std::get<1>(element).lock();
+			auto model_comp_ptr = std::get<2>(element).lock();
+			if(!transform_comp_ptr || !model_comp_ptr)
+				continue;
+
+			const auto& model = model_comp_ptr->get_model();
+			const auto lod_count = model.get_lods().size();
+			if(!model.is_valid() || lod_count <= 1)
+				continue;
+
+			const auto current_mesh = model.get_lod(_lod_data_refs[i]->current_lod_index);
+			if(!current_mesh)
+				continue;
+
+			const auto& world_transform = _world_transforms[i];
+			const auto& bounds = current_mesh->get_bounds();
+
+			if(model.get_lod_metric() == lod_metric::screen_size)
+			{
+				// Radius of the bounding sphere over its projected distance,
+				// as a fraction of the view height.
+				const auto world_bounds = math::bbox::mul(bounds, world_transform);
+				const auto radius = math::length(world_bounds.get_extents());
+				const auto center = view.transform_coord(world_bounds.get_center());
+				const auto w = std::max(proj[2][3] * center.z + proj[3][3], 0.0001f);
+				const auto size = radius * proj[1][1] / w;
+
+				const auto max_size = model.get_lod_max_screen_size();
+				const auto min_size = model.get_lod_min_screen_size();
+				request.factor = math::clamp((max_size - size) / (max_size - min_size), 0.0f, 1.0f);
+			}
+			else
+			{
+				float t = 0.0f;
+				const auto inv_world = math::inverse(world_transform);
+				const auto object_ray_origin = inv_world.transform_coord(camera_pos);
+				const auto object_ray_direction = math::normalize(bounds.get_center() - object_ray_origin);
+				bounds.intersect(object_ray_origin, object_ray_direction, t);
+
+				// Compute final object space intersection point.
+				auto intersection_point = object_ray_origin + (object_ray_direction * t);
+
+				// transform intersection point back into world space to compute
+				// the final intersection distance.
+				intersection_point = world_transform.transform_coord(intersection_point);
+				const float distance = math::length(intersection_point - camera_pos);
+
+				const auto max_distance = model.get_lod_max_distance();
+				const auto min_distance = model.get_lod_min_distance();
+				request.factor =
+					1.0f - math::clamp((max_distance - distance) / (max_distance - min_distance), 0.0f, 1.0f);
+			}
+
+			request.hysteresis = model.get_lod_hysteresis();
+			request.transition_time = model.get_lod_transition_time();
+			request.max_lod = static_cast<std::uint32_t>(lod_count - 1);
+		}
+	});
+
+	// Targets and transitions over the flat list.
+	const auto delta = dt.count();
+	for(std::size_t i = 0; i < _lod_requests.size(); ++i)
+	{
+		if(_lod_requests[i].factor >= 0.0f)
+			update_lod_data(*_lod_data_refs[i], _lod_requests[i], delta);
+	}
 }
 
 std::shared_ptr<frame_buffer> deferred_rendering::lighting_pass(std::shared_ptr<frame_buffer> input,
@@ -437,16 +782,19 @@ std::shared_ptr<frame_buffer> deferred_rendering::lighting_pass(std::shared_ptr<
 	const auto inv_view_proj = math::inverse(view_proj);
 
 	const auto& viewport_size = camera.get_viewport_size();
-	auto g_buffer_fbo = render_view.get_g_buffer_fbo(viewport_size).get();
+	auto g_buffer_fbo = get_g_buffer_fbo(render_view, viewport_size);
+	auto refl_buffer = _transient_pool.get(_chain.refl_buffer);
 
-	static auto light_buffer_format =
-		gfx::get_best_format(BGFX_CAPS_FORMAT_TEXTURE_FRAMEBUFFER,
-							 gfx::format_search_flags::FourChannels | gfx::format_search_flags::RequireAlpha |
-								 gfx::format_search_flags::HalfPrecisionFloat);
+	// Without the reflection pass the indirect specular is cleared instead.
+	if(!bind_indirect_specular)
+	{
+		render_pass clear_pass("refl_buffer_clear");
+		clear_pass.bind(_transient_pool.get_fbo({refl_buffer}).get());
+		clear_pass.clear(BGFX_CLEAR_COLOR, 0, 0.0f, 0);
+	}
 
-	auto light_buffer = render_view.get_texture("LBUFFER", viewport_size.width, viewport_size.height, false,
-												1, light_buffer_format);
-	auto l_buffer_fbo = render_view.get_fbo("LBUFFER", {light_buffer});
+	auto light_buffer = _transient_pool.get(_chain.light_buffer);
+	auto l_buffer_fbo = _transient_pool.get_fbo({light_buffer});
 	const auto buffer_size = l_buffer_fbo->get_size();
 
 	render_pass pass("light_buffer_fill");
@@ -454,19 +802,56 @@ std::shared_ptr<frame_buffer> deferred_rendering::lighting_pass(std::shared_ptr<
 	pass.clear(BGFX_CLEAR_COLOR, 0, 0.0f, 0);
 	pass.set_view_proj(view, proj);
 
-	auto refl_buffer =
-		render_view
-			.get_texture("RBUFFER", viewport_size.width, viewport_size.height, false, 1, light_buffer_format)
-			.get();
-
-	ecs.each<transform_component, light_component>([this, bind_indirect_specular, &camera, &pass,
-													&buffer_size, &view, &proj, g_buffer_fbo, refl_buffer](
-		entity e, transform_component& transform_comp_ref, light_component& light_comp_ref) {
+	auto bind_g_buffer = [this, g_buffer_fbo, refl_buffer](program& program) {
+		program.set_texture(0, s_tex0, gfx::getTexture(g_buffer_fbo->handle, 0));
+		program.set_texture(1, s_tex1, gfx::getTexture(g_buffer_fbo->handle, 1));
+		program.set_texture(2, s_tex2, gfx::getTexture(g_buffer_fbo->handle, 2));
+		program.set_texture(3, s_tex3, gfx::getTexture(g_buffer_fbo->handle, 3));
+		program.set_texture(4, s_tex4, gfx::getTexture(g_buffer_fbo->handle, 4));
+		program.set_texture(5, s_tex5, refl_buffer->handle);
+		program.set_texture(6, s_tex6, _ibl_brdf_lut->handle);
+	};
+
+	// Point and spot lights are binned into clusters and shaded in one pass
+	// when the clustered program is available, directional lights and
+	// anything over the light data capacity get a scissored quad each.
+	_cluster_spheres.clear();
+	_cluster_light_data.clear();
+
+	ecs.query<transform_component, light_component>().each([this, &camera, &pass, &buffer_size, &view, &proj,
+													&bind_g_buffer](entity e,
+																	transform_component& transform_comp_ref,
+																	light_component& light_comp_ref) {
 		const auto& light = light_comp_ref.get_light();
 		const auto& world_transform = transform_comp_ref.get_transform();
 		const auto& light_position = world_transform.get_position();
 		const auto& light_direction = world_transform.z_unit_axis();
 
+		if(_clustered_light_program && light.type != light_type::directional &&
+		   _cluster_spheres.size() < max_clustered_lights)
+		{
+			_cluster_spheres.push_back(light_comp_ref.get_bounding_sphere(light_position, light_direction));
+
+			// position and range, direction and type, color and intensity, parameters
+			if(light.type == light_type::point)
+			{
+				_cluster_light_data.emplace_back(light_position, light.point_data.range);
+				_cluster_light_data.emplace_back(light_direction, float(light.type));
+				_cluster_light_data.emplace_back(math::vec3(light.color.value), light.intensity);
+				_cluster_light_data.emplace_back(light.point_data.exponent_falloff, 0.0f, 0.0f, 0.0f);
+			}
+			else
+			{
+				_cluster_light_data.emplace_back(light_position, light.spot_data.get_range());
+				_cluster_light_data.emplace_back(light_direction, float(light.type));
+				_cluster_light_data.emplace_back(math::vec3(light.color.value), light.intensity);
+				_cluster_light_data.emplace_back(
+					0.0f, math::cos(math::radians(light.spot_data.get_inner_angle() * 0.5f)),
+					math::cos(math::radians(light.spot_data.get_outer_angle() * 0.5f)), 0.0f);
+			}
+			return;
+		}
+
 		irect rect(0, 0, buffer_size.width, buffer_size.height);
 		if(light_comp_ref.compute_projected_sphere_rect(rect, light_position, light_direction, view, proj) ==
 		   0)
@@ -478,7 +863,7 @@ std::shared_ptr<frame_buffer> deferred_rendering::lighting_pass(std::shared_ptr<
 			// Draw light.
 			program = _directional_light_program.get();
 			program->begin_pass();
-			program->set_uniform("u_light_direction", &light_direction);
+			program->set_uniform(u_light_direction, &light_direction);
 		}
 		if(light.type == light_type::point && _point_light_program)
 		{
@@ -487,8 +872,8 @@ std::shared_ptr<frame_buffer> deferred_rendering::lighting_pass(std::shared_ptr<
 			// Draw light.
 			program = _point_light_program.get();
 			program->begin_pass();
-			program->set_uniform("u_light_position", &light_position);
-			program->set_uniform("u_light_data", light_data);
+			program->set_uniform(u_light_position, &light_position);
+			program->set_uniform(u_light_data, light_data);
 		}
 
 		if(light.type == light_type::spot && _spot_light_program)
@@ -500,9 +885,9 @@ std::shared_ptr<frame_buffer> deferred_rendering::lighting_pass(std::shared_ptr<
 			// Draw light.
 			program = _spot_light_program.get();
 			program->begin_pass();
-			program->set_uniform("u_light_position", &light_position);
-			program->set_uniform("u_light_direction", &light_direction);
-			program->set_uniform("u_light_data", light_data);
+			program->set_uniform(u_light_position, &light_position);
+			program->set_uniform(u_light_direction, &light_direction);
+			program->set_uniform(u_light_data, light_data);
 		}
 
 		if(program)
@@ -510,15 +895,9 @@ std::shared_ptr<frame_buffer> deferred_rendering::lighting_pass(std::shared_ptr<
 			float light_color_intensity[4] = {light.color.value.r, light.color.value.g, light.color.value.b,
 											  light.intensity};
 			auto camera_pos = camera.get_position();
-			program->set_uniform("u_light_color_intensity", light_color_intensity);
-			program->set_uniform("u_camera_position", &camera_pos);
-			program->set_texture(0, "s_tex0", gfx::getTexture(g_buffer_fbo->handle, 0));
-			program->set_texture(1, "s_tex1", gfx::getTexture(g_buffer_fbo->handle, 1));
-			program->set_texture(2, "s_tex2", gfx::getTexture(g_buffer_fbo->handle, 2));
-			program->set_texture(3, "s_tex3", gfx::getTexture(g_buffer_fbo->handle, 3));
-			program->set_texture(4, "s_tex4", gfx::getTexture(g_buffer_fbo->handle, 4));
-			program->set_texture(5, "s_tex5", refl_buffer->handle);
-			program->set_texture(6, "s_tex6", _ibl_brdf_lut->handle);
+			program->set_uniform(u_light_color_intensity, light_color_intensity);
+			program->set_uniform(u_camera_position, &camera_pos);
+			bind_g_buffer(*program);
 
 			gfx::setScissor(rect.left, rect.top, rect.width(), rect.height());
 			auto topology = gfx::clip_quad(1.0f);
@@ -528,6 +907,68 @@ std::shared_ptr<frame_buffer> deferred_rendering::lighting_pass(std::shared_ptr<
 		}
 	});
 
+	if(_cluster_spheres.empty())
+		return l_buffer_fbo;
+
+	auto& ts = core::get_subsystem<core::task_system>();
+	_light_clusters.build(view, proj, camera.get_near_clip(), camera.get_far_clip(), _cluster_spheres, &ts);
+	_frame_cluster_stats += _light_clusters.get_stats();
+	if(_light_clusters.get_stats().visible_lights == 0 || !_clustered_light_program->begin_pass())
+		return l_buffer_fbo;
+
+	// Offset and count of every cluster, one row per depth slice.
+	const auto& clusters = _light_clusters.get_clusters();
+	const auto cluster_width = std::uint16_t(_light_clusters.get_size_x() * _light_clusters.get_size_y());
+	const auto cluster_height = std::uint16_t(_light_clusters.get_size_z());
+	update_cluster_texture(_cluster_texture, cluster_width, cluster_height, gfx::TextureFormat::RG32F);
+	_cluster_upload.resize(clusters.size() * 2);
+	for(std::size_t i = 0; i < clusters.size(); ++i)
+	{
+		_cluster_upload[i * 2 + 0] = float(clusters[i].offset);
+		_cluster_upload[i * 2 + 1] = float(clusters[i].count);
+	}
+	gfx::updateTexture2D(_cluster_texture.handle, 0, 0, 0, 0, cluster_width, cluster_height,
+						 gfx::copy(_cluster_upload.data(), std::uint32_t(_cluster_upload.size() * sizeof(float))));
+
+	// Light indices in a square texture that grows in powers of two, only
+	// the rows in use are uploaded.
+	const auto& indices = _light_clusters.get_light_indices();
+	std::uint16_t index_size = 64;
+	while(std::size_t(index_size) * index_size < indices.size())
+		index_size *= 2;
+	const auto index_rows = std::uint16_t((indices.size() + index_size - 1) / index_size);
+	update_cluster_texture(_cluster_index_texture, index_size, index_size, gfx::TextureFormat::R32F);
+	_cluster_upload.assign(std::size_t(index_rows) * index_size, 0.0f);
+	std::copy(indices.begin(), indices.end(), _cluster_upload.begin());
+	gfx::updateTexture2D(_cluster_index_texture.handle, 0, 0, 0, 0, index_size, index_rows,
+						 gfx::copy(_cluster_upload.data(), std::uint32_t(_cluster_upload.size() * sizeof(float))));
+
+	const auto light_count = std::uint16_t(_cluster_spheres.size());
+	update_cluster_texture(_cluster_light_texture, 4, max_clustered_lights, gfx::TextureFormat::RGBA32F);
+	gfx::updateTexture2D(_cluster_light_texture.handle, 0, 0, 0, 0, 4, light_count,
+						 gfx::copy(_cluster_light_data.data(),
+								   std::uint32_t(_cluster_light_data.size() * sizeof(math::vec4))));
+
+	const auto depth_params = _light_clusters.get_depth_params();
+	const math::vec4 cluster_size(_light_clusters.get_size_x(), _light_clusters.get_size_y(),
+								  _light_clusters.get_size_z(), index_size);
+	const math::vec4 cluster_depth(depth_params, float(max_clustered_lights));
+	const auto camera_pos = camera.get_position();
+
+	auto& program = *_clustered_light_program;
+	program.set_uniform(u_cluster_size, &cluster_size);
+	program.set_uniform(u_cluster_depth, &cluster_depth);
+	program.set_uniform(u_camera_position, &camera_pos);
+	bind_g_buffer(program);
+	program.set_texture(7, s_tex7, _cluster_texture.handle);
+	program.set_texture(8, s_tex8, _cluster_index_texture.handle);
+	program.set_texture(9, s_tex9, _cluster_light_texture.handle);
+
+	auto topology = gfx::clip_quad(1.0f);
+	gfx::setState(topology | BGFX_STATE_RGB_WRITE | BGFX_STATE_ALPHA_WRITE | BGFX_STATE_BLEND_ADD);
+	gfx::submit(pass.id, program.handle);
+	gfx::setState(BGFX_STATE_DEFAULT);
+
 	return l_buffer_fbo;
 }
 
@@ -541,16 +982,10 @@ std::shared_ptr<frame_buffer> deferred_rendering::reflection_probe_pass(std::sha
 	const auto& proj = camera.get_projection();
 
 	const auto& viewport_size = camera.get_viewport_size();
-	auto g_buffer_fbo = render_view.get_g_buffer_fbo(viewport_size).get();
+	auto g_buffer_fbo = get_g_buffer_fbo(render_view, viewport_size).get();
 
-	static auto refl_buffer_format =
-		gfx::get_best_format(BGFX_CAPS_FORMAT_TEXTURE_FRAMEBUFFER,
-							 gfx::format_search_flags::FourChannels | gfx::format_search_flags::RequireAlpha |
-								 gfx::format_search_flags::HalfPrecisionFloat);
-
-	auto refl_buffer = render_view.get_texture("RBUFFER", viewport_size.width, viewport_size.height, false, 1,
-											   refl_buffer_format);
-	auto r_buffer_fbo = render_view.get_fbo("RBUFFER", {refl_buffer});
+	auto refl_buffer = _transient_pool.get(_chain.refl_buffer);
+	auto r_buffer_fbo = _transient_pool.get_fbo({refl_buffer});
 	const auto buffer_size = refl_buffer->get_size();
 
 	render_pass pass("refl_buffer_fill");
@@ -585,14 +1020,14 @@ std::shared_ptr<frame_buffer> deferred_rendering::reflection_probe_pass(std::sha
 			math::transform t;
 			t.set_scale(probe.box_data.extents);
 			t = world_transform * t;
-			auto u_inv_world = math::inverse(t);
+			auto inv_world = math::inverse(t);
 			float data2[4] = {probe.box_data.extents.x, probe.box_data.extents.y, probe.box_data.extents.z,
 							  probe.box_data.transition_distance};
 
 			program = _box_ref_probe_program.get();
 			program->begin_pass();
-			program->set_uniform("u_inv_world", &u_inv_world);
-			program->set_uniform("u_data2", data2);
+			program->set_uniform(u_inv_world, &inv_world);
+			program->set_uniform(u_data2, data2);
 
 			influence_radius = math::length(t.get_scale() + probe.box_data.transition_distance);
 		}
@@ -606,15 +1041,15 @@ std::shared_ptr<frame_buffer> deferred_rendering::reflection_probe_pass(std::sha
 
 			float data1[4] = {mips, 0.0f, 0.0f, 0.0f};
 
-			program->set_uniform("u_data0", data0);
-			program->set_uniform("u_data1", data1);
+			program->set_uniform(u_data0, data0);
+			program->set_uniform(u_data1, data1);
 
-			program->set_texture(0, "s_tex0", gfx::getTexture(g_buffer_fbo->handle, 0));
-			program->set_texture(1, "s_tex1", gfx::getTexture(g_buffer_fbo->handle, 1));
-			program->set_texture(2, "s_tex2", gfx::getTexture(g_buffer_fbo->handle, 2));
-			program->set_texture(3, "s_tex3", gfx::getTexture(g_buffer_fbo->handle, 3));
-			program->set_texture(4, "s_tex4", gfx::getTexture(g_buffer_fbo->handle, 4));
-			program->set_texture(5, "s_tex_cube", cubemap->handle);
+			program->set_texture(0, s_tex0, gfx::getTexture(g_buffer_fbo->handle, 0));
+			program->set_texture(1, s_tex1, gfx::getTexture(g_buffer_fbo->handle, 1));
+			program->set_texture(2, s_tex2, gfx::getTexture(g_buffer_fbo->handle, 2));
+			program->set_texture(3, s_tex3, gfx::getTexture(g_buffer_fbo->handle, 3));
+			program->set_texture(4, s_tex4, gfx::getTexture(g_buffer_fbo->handle, 4));
+			program->set_texture(5, s_tex_cube, cubemap->handle);
 			gfx::setScissor(rect.left, rect.top, rect.width(), rect.height());
 			auto topology = gfx::clip_quad(1.0f);
 			gfx::setState(topology | BGFX_STATE_RGB_WRITE | BGFX_STATE_ALPHA_WRITE | BGFX_STATE_BLEND_ALPHA);
@@ -638,15 +1073,8 @@ std::shared_ptr<frame_buffer> deferred_rendering::atmospherics_pass(std::shared_
 	camera.set_far_clip(far_clip_cache);
 	const auto& viewport_size = camera.get_viewport_size();
 
-	static auto light_buffer_format =
-		gfx::get_best_format(BGFX_CAPS_FORMAT_TEXTURE_FRAMEBUFFER,
-							 gfx::format_search_flags::FourChannels | gfx::format_search_flags::RequireAlpha |
-								 gfx::format_search_flags::HalfPrecisionFloat);
-
-	auto light_buffer = render_view.get_texture("LBUFFER", viewport_size.width, viewport_size.height, false,
-												1, light_buffer_format, gfx::get_default_rt_sampler_flags());
-	input =
-		render_view.get_fbo("LBUFFER", {light_buffer, render_view.get_depth_stencil_buffer(viewport_size)});
+	auto light_buffer = _transient_pool.get(_chain.light_buffer);
+	input = _transient_pool.get_fbo({light_buffer, get_depth_stencil_buffer(render_view, viewport_size)});
 
 	const auto surface = input.get();
 	const auto output_size = surface->get_size();
@@ -658,7 +1086,7 @@ std::shared_ptr<frame_buffer> deferred_rendering::atmospherics_pass(std::shared_
 	{
 		bool found_sun = false;
 		auto light_direction = math::normalize(math::vec3(0.2f, -0.8f, 1.0f));
-		ecs.each<transform_component, light_component>([this, &light_direction, &found_sun](
+		ecs.query<transform_component, light_component>().each([this, &light_direction, &found_sun](
 			entity e, transform_component& transform_comp_ref, light_component& light_comp_ref) {
 			if(found_sun)
 				return;
@@ -674,7 +1102,7 @@ std::shared_ptr<frame_buffer> deferred_rendering::atmospherics_pass(std::shared_
 		});
 
 		_atmospherics_program->begin_pass();
-		_atmospherics_program->set_uniform("u_light_direction", &light_direction);
+		_atmospherics_program->set_uniform(u_light_direction, &light_direction);
 
 		irect rect(0, 0, output_size.width, output_size.height);
 		gfx::setScissor(rect.left, rect.top, rect.width(), rect.height());
@@ -695,7 +1123,7 @@ std::shared_ptr<frame_buffer> deferred_rendering::tonemapping_pass(std::shared_p
 		return nullptr;
 
 	const auto& viewport_size = camera.get_viewport_size();
-	const auto surface = render_view.get_output_fbo(viewport_size);
+	const auto surface = get_output_fbo(render_view, viewport_size);
 	const auto output_size = surface->get_size();
 	const auto& view = camera.get_view();
 	const auto& proj = camera.get_projection();
@@ -706,7 +1134,7 @@ std::shared_ptr<frame_buffer> deferred_rendering::tonemapping_pass(std::shared_p
 	if(surface && _gamma_correction_program)
 	{
 		_gamma_correction_program->begin_pass();
-		_gamma_correction_program->set_texture(0, "s_input", gfx::getTexture(input->handle));
+		_gamma_correction_program->set_texture(0, s_input, gfx::getTexture(input->handle));
 		irect rect(0, 0, output_size.width, output_size.height);
 		gfx::setScissor(rect.left, rect.top, rect.width(), rect.height());
 		auto topology = gfx::clip_quad(1.0f);
@@ -720,15 +1148,20 @@ std::shared_ptr<frame_buffer> deferred_rendering::tonemapping_pass(std::shared_p
 
 void deferred_rendering::receive(entity e)
 {
+	remove_spatial_proxy(e.id().index());
 	_lod_data.erase(e);
-	for(auto& pair : _lod_data)
-	{
-		pair.second.erase(e);
-	}
+}
+
+void deferred_rendering::receive_component_removed(entity e, chandle<component>)
+{
+	const auto index = e.id().index();
+	if(index < _spatial_proxies.size() && _spatial_proxies[index] >= 0)
+		_spatial_pending.push_back(e);
 }
 bool deferred_rendering::initialize()
 {
 	on_entity_destroyed.connect(this, &deferred_rendering::receive);
+	on_component_removed.connect(this, &deferred_rendering::receive_component_removed);
 	on_frame_render.connect(this, &deferred_rendering::frame_render);
 
 	auto& ts = core::get_subsystem<core::task_system>();
@@ -738,6 +1171,7 @@ bool deferred_rendering::initialize()
 	auto fs_deferred_spot_light = am.load<shader>("engine_data:/shaders/fs_deferred_spot_light.sc");
 	auto fs_deferred_directional_light =
 		am.load<shader>("engine_data:/shaders/fs_deferred_directional_light.sc");
+	auto fs_deferred_clustered_light = am.load<shader>("engine_data:/shaders/fs_deferred_clustered_light.sc");
 	auto fs_gamma_correction = am.load<shader>("engine_data:/shaders/fs_gamma_correction.sc");
 	auto vs_clip_quad_ex = am.load<shader>("engine_data:/shaders/vs_clip_quad_ex.sc");
 	auto fs_sphere_reflection_probe = am.load<shader>("engine_data:/shaders/fs_sphere_reflection_probe.sc");
@@ -766,6 +1200,18 @@ bool deferred_rendering::initialize()
 		},
 		vs_clip_quad, fs_deferred_directional_light);
 
+	ts.push_awaitable_on_main(
+		[this](asset_handle<shader> vs, asset_handle<shader> fs) {
+			// without the compiled shader for this renderer the lights
+			// keep their own passes
+			if(!vs || !fs || !vs->is_valid() || !fs->is_valid() || !supports_clustered_lighting())
+				return;
+
+			_clustered_light_program = std::make_unique<program>(vs, fs);
+
+		},
+		vs_clip_quad, fs_deferred_clustered_light);
+
 	ts.push_awaitable_on_main(
 		[this](asset_handle<shader> vs, asset_handle<shader> fs) {
 			_gamma_correction_program = std::make_unique<program>(vs, fs);
@@ -800,6 +1246,7 @@ bool deferred_rendering::initialize()
 void deferred_rendering::dispose()
 {
 	on_entity_destroyed.disconnect(this, &deferred_rendering::receive);
+	on_component_removed.disconnect(this, &deferred_rendering::receive_component_removed);
 	on_frame_render.disconnect(this, &deferred_rendering::frame_render);
 }
 }
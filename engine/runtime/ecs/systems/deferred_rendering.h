@@ -1,10 +1,16 @@
 #pragma once
 
+#include "../../rendering/light_clusters.h"
 #include "../../rendering/program.h"
+#include "../../rendering/render_queue.h"
+#include "../../rendering/texture.h"
+#include "../../rendering/transient_pool.h"
 #include "../components/model_component.h"
 #include "../components/transform_component.h"
 #include "../ecs.h"
+#include "core/math/aabb_tree.h"
 #include <chrono>
+#include <cstdint>
 #include <memory>
 #include <tuple>
 #include <vector>
@@ -16,11 +22,27 @@ namespace runtime
 {
 struct lod_data
 {
+	/// Entity the state belongs to, the slot starts over when it changes.
+	entity::id_t id;
 	std::uint32_t current_lod_index = 0;
 	std::uint32_t target_lod_index = 0;
 	float current_time = 0.0f;
 };
 
+/// Lod state of the models seen by one camera, indexed by entity index.
+using camera_lods_t = std::vector<lod_data>;
+
+struct lod_request
+{
+	/// 0 for the first lod up to 1 for the last one, negative to keep the
+	/// current state.
+	float factor = -1.0f;
+	/// See model::get_lod_hysteresis.
+	float hysteresis = 0.0f;
+	float transition_time = 0.0f;
+	std::uint32_t max_lod = 0;
+};
+
 using visibility_set_models_t =
 	std::vector<std::tuple<entity, chandle<transform_component>, chandle<model_component>>>;
 
@@ -58,6 +80,15 @@ public:
 	//-----------------------------------------------------------------------------
 	void receive(entity e);
 
+	//-----------------------------------------------------------------------------
+	//  Name : receive_component_removed ()
+	/// <summary>
+	/// Queues the entity for a spatial index check, it may no longer be
+	/// renderable.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void receive_component_removed(entity e, chandle<component> component);
+
 	//-----------------------------------------------------------------------------
 	//  Name : initialize ()
 	/// <summary>
@@ -88,6 +119,48 @@ public:
 	//-----------------------------------------------------------------------------
 	void build_reflections_pass(entity_component_system& ecs, std::chrono::duration<float> dt);
 
+	//-----------------------------------------------------------------------------
+	//  Name : set_reflection_face_budget ()
+	/// <summary>
+	/// Sets how many reflection probe cubemap faces may be rendered per frame.
+	/// Faces over the budget are rendered on the following frames.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void set_reflection_face_budget(std::uint32_t faces);
+
+	//-----------------------------------------------------------------------------
+	//  Name : get_reflection_face_budget ()
+	/// <summary>
+	/// Returns how many reflection probe cubemap faces may be rendered per frame.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	std::uint32_t get_reflection_face_budget() const;
+
+	//-----------------------------------------------------------------------------
+	//  Name : get_render_queue_stats ()
+	/// <summary>
+	/// Returns the render queue counters of the last frame.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	const render_queue_stats& get_render_queue_stats() const;
+
+	//-----------------------------------------------------------------------------
+	//  Name : get_light_cluster_stats ()
+	/// <summary>
+	/// Returns the light clustering counters of the last frame, summed over
+	/// the lighting passes.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	const light_cluster_stats& get_light_cluster_stats() const;
+
+	//-----------------------------------------------------------------------------
+	//  Name : get_transient_pool_stats ()
+	/// <summary>
+	/// Returns the transient render target counters of the last frame.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	const transient_pool_stats& get_transient_pool_stats() const;
+
 	//-----------------------------------------------------------------------------
 	//  Name : build_shadows ()
 	/// <summary>
@@ -118,7 +191,7 @@ public:
 	//-----------------------------------------------------------------------------
 	std::shared_ptr<frame_buffer> deferred_render_full(camera& camera, render_view& render_view,
 													   entity_component_system& ecs,
-													   std::unordered_map<entity, lod_data>& camera_lods,
+													   camera_lods_t& camera_lods,
 													   std::chrono::duration<float> dt);
 
 	//-----------------------------------------------------------------------------
@@ -132,9 +205,22 @@ public:
 	std::shared_ptr<frame_buffer> g_buffer_pass(std::shared_ptr<frame_buffer> input, camera& camera,
 												render_view& render_view,
 												visibility_set_models_t& visibility_set,
-												std::unordered_map<entity, lod_data>& camera_lods,
+												camera_lods_t& camera_lods,
 												std::chrono::duration<float> dt);
 
+	//-----------------------------------------------------------------------------
+	//  Name : select_lods ()
+	/// <summary>
+	/// Picks the lods of the visible models in one batch. The metric of
+	/// every model is computed in parallel first, then the targets and
+	/// transitions are updated over the flat list. Leaves a pointer to the
+	/// state of each visible model in _lod_data_refs and its world matrix
+	/// in _world_transforms.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void select_lods(camera& camera, visibility_set_models_t& visibility_set, camera_lods_t& camera_lods,
+					 std::chrono::duration<float> dt);
+
 	//-----------------------------------------------------------------------------
 	//  Name : lighting_pass ()
 	/// <summary>
@@ -184,13 +270,149 @@ public:
 												   render_view& render_view);
 
 private:
-	std::unordered_map<entity, std::unordered_map<entity, lod_data>> _lod_data;
+	//-----------------------------------------------------------------------------
+	//  Name : begin_chain ()
+	/// <summary>
+	/// Declares the transient targets of a chain of passes rendering one
+	/// view. With transient_outputs the g-buffer, depth and output are
+	/// transient as well, for views nobody reads after the chain.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void begin_chain(const usize& viewport_size, bool transient_outputs);
+
+	//-----------------------------------------------------------------------------
+	//  Name : end_chain ()
+	/// <summary>
+	/// Frees the transient targets of the chain for the next one.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void end_chain();
+
+	//-----------------------------------------------------------------------------
+	//  Name : get_g_buffer_fbo ()
+	/// <summary>
+	/// G-buffer of the current chain.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	std::shared_ptr<frame_buffer> get_g_buffer_fbo(render_view& render_view, const usize& viewport_size);
+
+	//-----------------------------------------------------------------------------
+	//  Name : get_depth_stencil_buffer ()
+	/// <summary>
+	/// Depth buffer of the current chain.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	std::shared_ptr<texture> get_depth_stencil_buffer(render_view& render_view, const usize& viewport_size);
+
+	//-----------------------------------------------------------------------------
+	//  Name : get_output_fbo ()
+	/// <summary>
+	/// Output of the current chain.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	std::shared_ptr<frame_buffer> get_output_fbo(render_view& render_view, const usize& viewport_size);
+
+	//-----------------------------------------------------------------------------
+	//  Name : update_spatial_index ()
+	/// <summary>
+	/// Brings the spatial index up to date with the transforms resolved this
+	/// frame and the models changed since the last update.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void update_spatial_index(entity_component_system& ecs);
+
+	//-----------------------------------------------------------------------------
+	//  Name : update_spatial_proxy ()
+	/// <summary>
+	/// Inserts, moves or removes the entity in the spatial index.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void update_spatial_proxy(entity e);
+
+	//-----------------------------------------------------------------------------
+	//  Name : remove_spatial_proxy ()
+	/// <summary>
+	///
+	///
+	///
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void remove_spatial_proxy(std::uint32_t index);
+
+	/// Lod state of each camera and reflection probe.
+	std::unordered_map<entity, camera_lods_t> _lod_data;
+	/// World bounds of the renderable models, user data is the entity index.
+	math::aabb_tree _spatial_index;
+	/// Proxy of each entity index in the spatial index or a negative value.
+	std::vector<std::int32_t> _spatial_proxies;
+	/// Entities to check again on the next update, e.g. mesh still loading.
+	std::vector<entity> _spatial_pending;
+	/// Scratch list of changed models.
+	std::vector<entity> _spatial_changed;
+	/// Frame of the last spatial index update.
+	std::uint64_t _spatial_frame = 0;
+	/// Queue the geometry passes record into.
+	render_queue _render_queue;
+	/// Lod data of the visibility set being recorded.
+	std::vector<lod_data*> _lod_data_refs;
+	/// World matrices of the visibility set being recorded, resolved before
+	/// the parallel loops read them.
+	std::vector<math::transform> _world_transforms;
+	/// Lod metric of each model of the visibility set.
+	std::vector<lod_request> _lod_requests;
+	/// Render queue counters of the current frame.
+	render_queue_stats _frame_queue_stats;
+	/// Render queue counters of the last frame.
+	render_queue_stats _render_queue_stats;
+	/// Transient targets of the chain being rendered.
+	struct chain_targets
+	{
+		transient_pool::resource g_buffer[4];
+		transient_pool::resource depth = transient_pool::invalid_resource;
+		transient_pool::resource output = transient_pool::invalid_resource;
+		transient_pool::resource refl_buffer = transient_pool::invalid_resource;
+		transient_pool::resource light_buffer = transient_pool::invalid_resource;
+		bool transient_outputs = false;
+	};
+	chain_targets _chain;
+	/// Render targets shared by the chains of a frame.
+	transient_pool _transient_pool;
+	/// Bins the point and spot lights of the lighting pass.
+	light_clusters _light_clusters;
+	/// Bounding spheres of the clustered lights.
+	std::vector<math::vec4> _cluster_spheres;
+	/// Four texels per clustered light, see lighting_pass.
+	std::vector<math::vec4> _cluster_light_data;
+	/// Scratch texel data uploaded to the cluster textures.
+	std::vector<float> _cluster_upload;
+	/// Offset and count of every cluster, one row per depth slice.
+	texture _cluster_texture;
+	/// Light indices of the clusters.
+	texture _cluster_index_texture;
+	/// Light data of the clustered lights.
+	texture _cluster_light_texture;
+	/// Light clustering counters of the current frame.
+	light_cluster_stats _frame_cluster_stats;
+	/// Light clustering counters of the last frame.
+	light_cluster_stats _light_cluster_stats;
+	/// Cubemap faces that may be rendered per frame.
+	std::uint32_t _reflection_face_budget = 6;
+	/// Rotates the probe and face rendered first each frame.
+	std::size_t _reflection_probe_cursor = 0;
+	/// Scratch list of the probes with pending faces.
+	std::vector<entity> _reflection_probes;
+	/// Scratch world bounds of the changed reflection casters.
+	std::vector<math::bbox> _reflection_dirty_bounds;
+	/// Scratch visibility bits for the face tests.
+	std::vector<std::uint32_t> _reflection_visible;
 	/// Program that is responsible for rendering.
 	std::unique_ptr<program> _directional_light_program;
 	/// Program that is responsible for rendering.
 	std::unique_ptr<program> _point_light_program;
 	/// Program that is responsible for rendering.
 	std::unique_ptr<program> _spot_light_program;
+	/// Program shading all clustered lights in one pass.
+	std::unique_ptr<program> _clustered_light_program;
 	/// Program that is responsible for rendering.
 	std::unique_ptr<program> _box_ref_probe_program;
 	/// Program that is responsible for rendering.
@@ -1,19 +1,95 @@
 #include "scene_graph.h"
 #include "../../system/engine.h"
 #include "../components/transform_component.h"
+#include "core/system/task_system.h"
+#include <algorithm>
+
 namespace runtime
 {
-void update_transform(chandle<transform_component> hTransform, std::chrono::duration<float> dt)
+void scene_graph::rebuild_hierarchy(entity_component_system& ecs)
+{
+	_roots.clear();
+	_nodes.clear();
+	_parents.clear();
+	_subtrees.clear();
+
+	for(auto e : ecs.query<transform_component>())
+	{
+		auto& transform_comp_ref = ecs.get_component_ref<transform_component>(e.id().index());
+		if(transform_comp_ref.get_parent().expired())
+		{
+			_roots.push_back(transform_comp_ref.handle());
+		}
+	}
+
+	std::vector<std::pair<transform_component*, std::int32_t>> stack;
+	for(auto& root : _roots)
+	{
+		_subtrees.push_back(_nodes.size());
+
+		stack.emplace_back(root.lock().get(), -1);
+		while(!stack.empty())
+		{
+			auto node = stack.back();
+			stack.pop_back();
+
+			const auto index = static_cast<std::int32_t>(_nodes.size());
+			_nodes.push_back(node.first);
+			_parents.push_back(node.second);
+
+			const auto& children = node.first->get_children();
+			for(auto it = children.rbegin(); it != children.rend(); ++it)
+			{
+				auto child = it->lock();
+				if(child)
+					stack.emplace_back(child.get(), index);
+			}
+		}
+	}
+	_subtrees.push_back(_nodes.size());
+
+	_dirty.assign(_nodes.size(), 0);
+	_moved.assign(_nodes.size(), 0);
+
+	// Nodes only shifted in the arrays keep their world transform, the
+	// entity ids tell them apart from new nodes reusing a slot.
+	const auto root_id = entity::INVALID.id();
+	_next_placements.clear();
+	for(std::size_t i = 0; i < _nodes.size(); ++i)
+	{
+		const auto parent = _parents[i];
+		const auto id = _nodes[i]->get_entity().id().id();
+		const auto parent_id = parent >= 0 ? _nodes[parent]->get_entity().id().id() : root_id;
+		_next_placements.emplace(id, parent_id);
+
+		auto it = _placements.find(id);
+		if(it == _placements.end() || it->second != parent_id)
+		{
+			_moved[i] = 1;
+			_has_moved = true;
+		}
+	}
+	_placements.swap(_next_placements);
+}
+
+void scene_graph::update_subtree(std::size_t root, float dt)
 {
-	auto pTransform = hTransform.lock();
-	if(pTransform)
+	const auto begin = _subtrees[root];
+	const auto end = _subtrees[root + 1];
+	for(auto i = begin; i < end; ++i)
 	{
-		pTransform->resolve(true, dt.count());
+		auto node = _nodes[i];
+		const auto parent = _parents[i];
+		const bool parent_dirty = parent >= 0 && _dirty[parent];
+
+		// Plain component check, the transform override walks up the parents.
+		const bool dirty = _moved[i] || parent_dirty || node->runtime::component::is_dirty() ||
+						   node->get_slow_parenting();
 
-		auto& children = pTransform->get_children();
-		for(auto& child : children)
+		_dirty[i] = dirty;
+		if(dirty)
 		{
-			update_transform(child, dt);
+			node->resolve_world(parent >= 0 ? _nodes[parent] : nullptr, dt);
 		}
 	}
 }
@@ -21,18 +97,34 @@ void update_transform(chandle<transform_component> hTransform, std::chrono::dura
 void scene_graph::frame_update(std::chrono::duration<float> dt)
 {
 	auto& ecs = core::get_subsystem<runtime::entity_component_system>();
-	_roots.clear();
-	ecs.each<transform_component>([this](runtime::entity e, transform_component& transformComponent) {
-		auto parent = transformComponent.get_parent();
-		if(parent.expired())
+	auto& ts = core::get_subsystem<core::task_system>();
+
+	const auto version = transform_component::get_hierarchy_version();
+	if(version != _hierarchy_version)
+	{
+		rebuild_hierarchy(ecs);
+		_hierarchy_version = version;
+	}
+
+	const auto count = dt.count();
+	ts.parallel_for(0, _roots.size(), 0, [this, count](std::size_t begin, std::size_t end) {
+		for(auto root = begin; root < end; ++root)
 		{
-			_roots.push_back(transformComponent.handle());
+			update_subtree(root, count);
 		}
 	});
 
-	for(auto& hComponent : _roots)
+	_resolved.clear();
+	for(std::size_t i = 0; i < _nodes.size(); ++i)
+	{
+		if(_dirty[i])
+			_resolved.push_back(_nodes[i]->get_entity());
+	}
+
+	if(_has_moved)
 	{
-		update_transform(hComponent, dt);
+		std::fill(_moved.begin(), _moved.end(), std::uint8_t(0));
+		_has_moved = false;
 	}
 }
 
@@ -2,6 +2,8 @@
 
 #include "../ecs.h"
 #include <chrono>
+#include <cstdint>
+#include <unordered_map>
 #include <vector>
 
 class transform_component;
@@ -36,8 +38,60 @@ public:
 		return _roots;
 	}
 
+	//-----------------------------------------------------------------------------
+	//  Name : get_resolved ()
+	/// <summary>
+	/// Entities whose world transform was recomputed by the last update.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	const std::vector<entity>& get_resolved() const
+	{
+		return _resolved;
+	}
+
 private:
+	//-----------------------------------------------------------------------------
+	//  Name : rebuild_hierarchy ()
+	/// <summary>
+	/// Flattens the transform hierarchy into the node arrays. Only needed when
+	/// transforms are added, removed or reparented. Only the nodes that are
+	/// new or got another parent are marked to be resolved, along with what
+	/// is below them.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void rebuild_hierarchy(entity_component_system& ecs);
+
+	//-----------------------------------------------------------------------------
+	//  Name : update_subtree ()
+	/// <summary>
+	/// Resolves the dirty nodes of one root subtree. Subtrees share no nodes so
+	/// they can be updated concurrently.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void update_subtree(std::size_t root, float dt);
+
 	/// scene roots
 	std::vector<chandle<transform_component>> _roots;
+	/// Transforms in depth first order. Each root subtree is contiguous and
+	/// parents always come before their children.
+	std::vector<transform_component*> _nodes;
+	/// Index of the parent node or -1 for roots.
+	std::vector<std::int32_t> _parents;
+	/// Was the node resolved this frame, children of resolved nodes follow.
+	std::vector<std::uint8_t> _dirty;
+	/// Entities resolved by the last update.
+	std::vector<entity> _resolved;
+	/// Start of each root subtree in _nodes, with the total node count last.
+	std::vector<std::size_t> _subtrees;
+	/// Was the node added or moved to another parent by the last rebuild.
+	std::vector<std::uint8_t> _moved;
+	/// Parent entity of every node entity as of the last rebuild.
+	std::unordered_map<std::uint64_t, std::uint64_t> _placements;
+	/// Scratch map the next placements are built in.
+	std::unordered_map<std::uint64_t, std::uint64_t> _next_placements;
+	/// Hierarchy version the node arrays were built from.
+	std::uint64_t _hierarchy_version = ~0ull;
+	/// Some nodes are marked as moved.
+	bool _has_moved = false;
 };
 }
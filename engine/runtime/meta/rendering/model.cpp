@@ -7,6 +7,9 @@
 
 REFLECT(model)
 {
+	rttr::registration::enumeration<lod_metric>("lod_metric")(
+		rttr::value("distance", lod_metric::distance), rttr::value("screen_size", lod_metric::screen_size));
+
 	rttr::registration::class_<model>("model")
 		.property("lods", &model::get_lods, &model::set_lods)(
 			rttr::metadata("pretty_name", "Levels of Detail"), rttr::metadata("Tooltip", "Levels of Detail."))
@@ -23,7 +26,25 @@ REFLECT(model)
 		.property("lod_min_distance", &model::get_lod_min_distance, &model::set_lod_min_distance)(
 			rttr::metadata("pretty_name", "Min Distance"),
 			rttr::metadata("Tooltip", "Nearer from this distance will use the "
-									  "highest level of detail."));
+									  "highest level of detail."))
+		.property("lod_metric", &model::get_lod_metric, &model::set_lod_metric)(
+			rttr::metadata("pretty_name", "Metric"),
+			rttr::metadata("Tooltip", "Pick levels of detail by distance or by screen size."))
+		.property("lod_max_screen_size", &model::get_lod_max_screen_size, &model::set_lod_max_screen_size)(
+			rttr::metadata("pretty_name", "Max Screen Size"), rttr::metadata("min", 0.0f),
+			rttr::metadata("max", 1.0f), rttr::metadata("step", 0.01f),
+			rttr::metadata("Tooltip", "Larger on screen than this fraction of the view "
+									  "height will use the highest level of detail."))
+		.property("lod_min_screen_size", &model::get_lod_min_screen_size, &model::set_lod_min_screen_size)(
+			rttr::metadata("pretty_name", "Min Screen Size"), rttr::metadata("min", 0.0f),
+			rttr::metadata("max", 1.0f), rttr::metadata("step", 0.01f),
+			rttr::metadata("Tooltip", "Smaller on screen than this fraction of the view "
+									  "height will use the lowest level of detail."))
+		.property("lod_hysteresis", &model::get_lod_hysteresis, &model::set_lod_hysteresis)(
+			rttr::metadata("pretty_name", "Hysteresis"), rttr::metadata("min", 0.0f),
+			rttr::metadata("max", 0.5f), rttr::metadata("step", 0.01f),
+			rttr::metadata("Tooltip", "Part of a level of detail band to move past "
+									  "before switching, avoids flickering."));
 }
 
 SAVE(model)
@@ -33,6 +54,10 @@ SAVE(model)
 	try_save(ar, cereal::make_nvp("transition_time", obj._transition_time));
 	try_save(ar, cereal::make_nvp("max_distance", obj._max_distance));
 	try_save(ar, cereal::make_nvp("min_distance", obj._min_distance));
+	try_save(ar, cereal::make_nvp("lod_metric", obj._lod_metric));
+	try_save(ar, cereal::make_nvp("max_screen_size", obj._max_screen_size));
+	try_save(ar, cereal::make_nvp("min_screen_size", obj._min_screen_size));
+	try_save(ar, cereal::make_nvp("hysteresis", obj._hysteresis));
 }
 SAVE_INSTANTIATE(model, cereal::oarchive_associative_t);
 
@@ -44,5 +69,9 @@ LOAD(model)
 	try_load(ar, cereal::make_nvp("transition_time", obj._transition_time));
 	try_load(ar, cereal::make_nvp("max_distance", obj._max_distance));
 	try_load(ar, cereal::make_nvp("min_distance", obj._min_distance));
+	try_load(ar, cereal::make_nvp("lod_metric", obj._lod_metric));
+	try_load(ar, cereal::make_nvp("max_screen_size", obj._max_screen_size));
+	try_load(ar, cereal::make_nvp("min_screen_size", obj._min_screen_size));
+	try_load(ar, cereal::make_nvp("hysteresis", obj._hysteresis));
 }
 LOAD_INSTANTIATE(model, cereal::iarchive_associative_t);
@@ -556,25 +556,21 @@ public:
 		return tex;
 	}
 
-	std::shared_ptr<texture> get_depth_stencil_buffer(const usize& viewport_size)
+	static gfx::TextureFormat::Enum get_depth_stencil_format()
 	{
 		static auto format = gfx::get_best_format(BGFX_CAPS_FORMAT_TEXTURE_FRAMEBUFFER,
 												  gfx::format_search_flags::RequireDepth |
 													  gfx::format_search_flags::RequireStencil);
-		return get_texture("DEPTH", viewport_size.width, viewport_size.height, false, 1, format);
+		return format;
 	}
-	std::shared_ptr<texture> get_output_buffer(const usize& viewport_size)
+	static gfx::TextureFormat::Enum get_output_format()
 	{
 		static auto format = gfx::get_best_format(BGFX_CAPS_FORMAT_TEXTURE_FRAMEBUFFER,
 												  gfx::format_search_flags::FourChannels |
 													  gfx::format_search_flags::RequireAlpha);
-		return get_texture("OUTPUT", viewport_size.width, viewport_size.height, false, 1, format);
-	}
-	std::shared_ptr<frame_buffer> get_output_fbo(const usize& viewport_size)
-	{
-		return get_fbo("OUTPUT", {get_output_buffer(viewport_size), get_depth_stencil_buffer(viewport_size)});
+		return format;
 	}
-	std::shared_ptr<frame_buffer> get_g_buffer_fbo(const usize& viewport_size)
+	static gfx::TextureFormat::Enum get_g_buffer_format(std::uint32_t index)
 	{
 		static auto format = gfx::get_best_format(BGFX_CAPS_FORMAT_TEXTURE_FRAMEBUFFER,
 												  gfx::format_search_flags::FourChannels |
@@ -583,12 +579,32 @@ public:
 														 gfx::format_search_flags::FourChannels |
 															 gfx::format_search_flags::RequireAlpha |
 															 gfx::format_search_flags::HalfPrecisionFloat);
+		return index == 1 ? normal_format : format;
+	}
+	std::shared_ptr<texture> get_depth_stencil_buffer(const usize& viewport_size)
+	{
+		return get_texture("DEPTH", viewport_size.width, viewport_size.height, false, 1,
+						   get_depth_stencil_format());
+	}
+	std::shared_ptr<texture> get_output_buffer(const usize& viewport_size)
+	{
+		return get_texture("OUTPUT", viewport_size.width, viewport_size.height, false, 1, get_output_format());
+	}
+	std::shared_ptr<frame_buffer> get_output_fbo(const usize& viewport_size)
+	{
+		return get_fbo("OUTPUT", {get_output_buffer(viewport_size), get_depth_stencil_buffer(viewport_size)});
+	}
+	std::shared_ptr<frame_buffer> get_g_buffer_fbo(const usize& viewport_size)
+	{
 		auto depth_buffer = get_depth_stencil_buffer(viewport_size);
-		auto buffer0 = get_texture("GBUFFER0", viewport_size.width, viewport_size.height, false, 1, format);
-		auto buffer1 =
-			get_texture("GBUFFER1", viewport_size.width, viewport_size.height, false, 1, normal_format);
-		auto buffer2 = get_texture("GBUFFER2", viewport_size.width, viewport_size.height, false, 1, format);
-		auto buffer3 = get_texture("GBUFFER3", viewport_size.width, viewport_size.height, false, 1, format);
+		auto buffer0 = get_texture("GBUFFER0", viewport_size.width, viewport_size.height, false, 1,
+								   get_g_buffer_format(0));
+		auto buffer1 = get_texture("GBUFFER1", viewport_size.width, viewport_size.height, false, 1,
+								   get_g_buffer_format(1));
+		auto buffer2 = get_texture("GBUFFER2", viewport_size.width, viewport_size.height, false, 1,
+								   get_g_buffer_format(2));
+		auto buffer3 = get_texture("GBUFFER3", viewport_size.width, viewport_size.height, false, 1,
+								   get_g_buffer_format(3));
 		return get_fbo("GBUFFER", {buffer0, buffer1, buffer2, buffer3, depth_buffer});
 	}
 
@@ -0,0 +1,188 @@
+#include "light_clusters.h"
+#include "core/system/task_system.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+std::uint32_t to_cell(float ndc, std::uint32_t size)
+{
+	const auto cell = std::floor((ndc * 0.5f + 0.5f) * float(size));
+	return std::uint32_t(math::clamp(cell, 0.0f, float(size - 1)));
+}
+}
+
+light_cluster_stats& light_cluster_stats::operator+=(const light_cluster_stats& rhs)
+{
+	lights += rhs.lights;
+	visible_lights += rhs.visible_lights;
+	indices += rhs.indices;
+	max_cluster_lights = std::max(max_cluster_lights, rhs.max_cluster_lights);
+	build_time += rhs.build_time;
+	return *this;
+}
+
+light_clusters::light_clusters(std::uint32_t size_x, std::uint32_t size_y, std::uint32_t size_z)
+{
+	set_grid_size(size_x, size_y, size_z);
+}
+
+void light_clusters::set_grid_size(std::uint32_t size_x, std::uint32_t size_y, std::uint32_t size_z)
+{
+	_size_x = std::max(size_x, 1u);
+	_size_y = std::max(size_y, 1u);
+	_size_z = std::max(size_z, 1u);
+}
+
+float light_clusters::get_slice(float view_depth) const
+{
+	const auto depth = _linear ? view_depth : std::log(std::max(view_depth, 1e-6f));
+	return depth * _slice_scale + _slice_bias;
+}
+
+const light_clusters::cluster& light_clusters::get_cluster(std::uint32_t x, std::uint32_t y,
+														   std::uint32_t z) const
+{
+	return _clusters[(z * _size_y + y) * _size_x + x];
+}
+
+void light_clusters::build(const math::transform& view, const math::transform& proj, float near_clip,
+						   float far_clip, const std::vector<math::vec4>& spheres, core::task_system* ts)
+{
+	using clock = std::chrono::high_resolution_clock;
+	const auto start = clock::now();
+
+	_stats = light_cluster_stats();
+	_stats.lights = std::uint32_t(spheres.size());
+
+	// w does not depend on the depth for orthographic projections
+	_linear = proj[2][3] == 0.0f;
+	if(_linear)
+	{
+		_slice_scale = float(_size_z) / (far_clip - near_clip);
+		_slice_bias = -near_clip * _slice_scale;
+	}
+	else
+	{
+		_slice_scale = float(_size_z) / std::log(far_clip / near_clip);
+		_slice_bias = -std::log(near_clip) * _slice_scale;
+	}
+
+	// Find the cells each light overlaps from the screen bounds of its view
+	// space box and the slices of its depth range.
+	_ranges.resize(spheres.size());
+	for(std::size_t i = 0; i < spheres.size(); ++i)
+	{
+		auto& range = _ranges[i];
+		range.visible = false;
+
+		const auto radius = spheres[i].w;
+		const auto center = view * math::vec4(math::vec3(spheres[i]), 1.0f);
+		const auto min_z = std::max(center.z - radius, near_clip);
+		const auto max_z = std::min(center.z + radius, far_clip);
+		if(min_z > max_z)
+			continue;
+
+		math::vec2 min_ndc(std::numeric_limits<float>::max());
+		math::vec2 max_ndc(std::numeric_limits<float>::lowest());
+		for(std::uint32_t corner = 0; corner < 8; ++corner)
+		{
+			const math::vec4 p((corner & 1) ? center.x + radius : center.x - radius,
+							   (corner & 2) ? center.y + radius : center.y - radius,
+							   (corner & 4) ? max_z : min_z, 1.0f);
+			const auto clip = proj * p;
+			const auto ndc = math::vec2(clip) / clip.w;
+			min_ndc = math::min(min_ndc, ndc);
+			max_ndc = math::max(max_ndc, ndc);
+		}
+
+		if(max_ndc.x < -1.0f || max_ndc.y < -1.0f || min_ndc.x > 1.0f || min_ndc.y > 1.0f)
+			continue;
+
+		range.min[0] = to_cell(min_ndc.x, _size_x);
+		range.max[0] = to_cell(max_ndc.x, _size_x);
+		range.min[1] = to_cell(min_ndc.y, _size_y);
+		range.max[1] = to_cell(max_ndc.y, _size_y);
+		range.min[2] = std::uint32_t(math::clamp(get_slice(min_z), 0.0f, float(_size_z - 1)));
+		range.max[2] = std::uint32_t(math::clamp(get_slice(max_z), 0.0f, float(_size_z - 1)));
+		range.visible = true;
+		++_stats.visible_lights;
+	}
+
+	_clusters.assign(_size_x * _size_y * _size_z, cluster());
+	_slice_indices.resize(_size_z);
+
+	// Slices only write to their own clusters and index list.
+	if(ts)
+	{
+		ts->parallel_for(0, _size_z, 0, [this](std::size_t begin, std::size_t end) {
+			for(auto z = begin; z < end; ++z)
+				bin_slice(std::uint32_t(z));
+		});
+	}
+	else
+	{
+		for(std::uint32_t z = 0; z < _size_z; ++z)
+			bin_slice(z);
+	}
+
+	// Join the slice lists, cluster offsets are moved by the slice base.
+	_indices.clear();
+	const auto slice_size = _size_x * _size_y;
+	for(std::uint32_t z = 0; z < _size_z; ++z)
+	{
+		const auto base = std::uint32_t(_indices.size());
+		auto first = _clusters.begin() + z * slice_size;
+		std::for_each(first, first + slice_size, [&](cluster& c) {
+			c.offset += base;
+			_stats.max_cluster_lights = std::max(_stats.max_cluster_lights, c.count);
+		});
+
+		const auto& list = _slice_indices[z];
+		_indices.insert(_indices.end(), list.begin(), list.end());
+	}
+
+	_stats.indices = std::uint32_t(_indices.size());
+	_stats.build_time = clock::now() - start;
+}
+
+void light_clusters::bin_slice(std::uint32_t z)
+{
+	auto first = &_clusters[z * _size_x * _size_y];
+	auto& list = _slice_indices[z];
+
+	auto for_each_cell = [&](const cell_range& range, auto&& f) {
+		for(auto y = range.min[1]; y <= range.max[1]; ++y)
+		{
+			for(auto x = range.min[0]; x <= range.max[0]; ++x)
+				f(first[y * _size_x + x]);
+		}
+	};
+
+	auto in_slice = [z](const cell_range& range) {
+		return range.visible && range.min[2] <= z && z <= range.max[2];
+	};
+
+	// Count, turn the counts into offsets, then fill.
+	for(const auto& range : _ranges)
+	{
+		if(in_slice(range))
+			for_each_cell(range, [](cluster& c) { ++c.count; });
+	}
+
+	std::uint32_t total = 0;
+	for(std::uint32_t i = 0; i < _size_x * _size_y; ++i)
+	{
+		first[i].offset = total;
+		total += first[i].count;
+		first[i].count = 0;
+	}
+
+	list.resize(total);
+	for(std::size_t i = 0; i < _ranges.size(); ++i)
+	{
+		if(in_slice(_ranges[i]))
+			for_each_cell(_ranges[i], [&](cluster& c) { list[c.offset + c.count++] = std::uint32_t(i); });
+	}
+}
@@ -0,0 +1,182 @@
+#pragma once
+#include "core/math/math_includes.h"
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace core
+{
+class task_system;
+}
+
+//-----------------------------------------------------------------------------
+//  Name : light_cluster_stats (Struct)
+/// <summary>
+/// Counters of the last light_clusters build.
+/// </summary>
+//-----------------------------------------------------------------------------
+struct light_cluster_stats
+{
+	/// Lights passed to the build.
+	std::uint32_t lights = 0;
+	/// Lights overlapping at least one cluster.
+	std::uint32_t visible_lights = 0;
+	/// Entries in the light index list.
+	std::uint32_t indices = 0;
+	/// Most lights found in a single cluster.
+	std::uint32_t max_cluster_lights = 0;
+	/// Time spent binning.
+	std::chrono::duration<float> build_time{0.0f};
+
+	light_cluster_stats& operator+=(const light_cluster_stats& rhs);
+};
+
+//-----------------------------------------------------------------------------
+//  Name : light_clusters (Class)
+/// <summary>
+/// Bins light volumes into a view space grid of clusters (froxels). The grid
+/// splits the screen into tiles and the depth range into slices, which are
+/// exponential for perspective projections and linear for orthographic
+/// ones. Each cluster ends up with a range in a flat list of light indices.
+/// The binning is pure CPU work and does not touch the renderer.
+/// </summary>
+//-----------------------------------------------------------------------------
+class light_clusters
+{
+public:
+	//-----------------------------------------------------------------------------
+	//  Name : cluster (Struct)
+	/// <summary>
+	/// Range of a cluster in the light index list.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	struct cluster
+	{
+		std::uint32_t offset = 0;
+		std::uint32_t count = 0;
+	};
+
+	light_clusters(std::uint32_t size_x = 16, std::uint32_t size_y = 8, std::uint32_t size_z = 24);
+
+	//-----------------------------------------------------------------------------
+	//  Name : set_grid_size ()
+	/// <summary>
+	/// Sets the number of tiles and slices, takes effect on the next build.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void set_grid_size(std::uint32_t size_x, std::uint32_t size_y, std::uint32_t size_z);
+
+	//-----------------------------------------------------------------------------
+	//  Name : build ()
+	/// <summary>
+	/// Bins the bounding spheres, world space center in xyz and radius in w,
+	/// for the given camera. The index of a sphere is what gets stored in the
+	/// clusters. Lights are binned one depth slice at a time, the slices are
+	/// spread over the task system when one is given.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void build(const math::transform& view, const math::transform& proj, float near_clip, float far_clip,
+			   const std::vector<math::vec4>& spheres, core::task_system* ts = nullptr);
+
+	//-----------------------------------------------------------------------------
+	//  Name : get_slice ()
+	/// <summary>
+	/// Depth slice of a view space depth, not clamped to the grid.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	float get_slice(float view_depth) const;
+
+	//-----------------------------------------------------------------------------
+	//  Name : get_cluster ()
+	/// <summary>
+	/// Returns the cluster at the given tile and slice.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	const cluster& get_cluster(std::uint32_t x, std::uint32_t y, std::uint32_t z) const;
+
+	//-----------------------------------------------------------------------------
+	//  Name : get_clusters ()
+	/// <summary>
+	/// All clusters, x varies fastest, then y, then z.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	const std::vector<cluster>& get_clusters() const
+	{
+		return _clusters;
+	}
+
+	//-----------------------------------------------------------------------------
+	//  Name : get_light_indices ()
+	/// <summary>
+	/// Flat list of light indices the clusters point into.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	const std::vector<std::uint32_t>& get_light_indices() const
+	{
+		return _indices;
+	}
+
+	//-----------------------------------------------------------------------------
+	//  Name : get_depth_params ()
+	/// <summary>
+	/// Scale, bias and whether slicing is linear (1) or exponential (0), so
+	/// that a shader can find the slice as scale * f(depth) + bias where f is
+	/// the identity or the natural logarithm.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	math::vec3 get_depth_params() const
+	{
+		return {_slice_scale, _slice_bias, _linear ? 1.0f : 0.0f};
+	}
+
+	std::uint32_t get_size_x() const
+	{
+		return _size_x;
+	}
+
+	std::uint32_t get_size_y() const
+	{
+		return _size_y;
+	}
+
+	std::uint32_t get_size_z() const
+	{
+		return _size_z;
+	}
+
+	//-----------------------------------------------------------------------------
+	//  Name : get_stats ()
+	/// <summary>
+	/// Returns the counters of the last build.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	const light_cluster_stats& get_stats() const
+	{
+		return _stats;
+	}
+
+private:
+	/// Grid cells covered by a light, inclusive.
+	struct cell_range
+	{
+		std::uint32_t min[3];
+		std::uint32_t max[3];
+		bool visible = false;
+	};
+
+	void bin_slice(std::uint32_t z);
+
+	std::uint32_t _size_x = 16;
+	std::uint32_t _size_y = 8;
+	std::uint32_t _size_z = 24;
+	float _slice_scale = 0.0f;
+	float _slice_bias = 0.0f;
+	bool _linear = false;
+	std::vector<cluster> _clusters;
+	std::vector<std::uint32_t> _indices;
+	/// Cells of each light for the current build.
+	std::vector<cell_range> _ranges;
+	/// Index lists of each slice before they are joined.
+	std::vector<std::vector<std::uint32_t>> _slice_indices;
+	light_cluster_stats _stats;
+};
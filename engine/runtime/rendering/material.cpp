@@ -1,5 +1,6 @@
 #include "material.h"
 #include "program.h"
+#include "shader.h"
 #include "texture.h"
 #include "uniform.h"
 
@@ -55,6 +56,16 @@ program* material::get_program() const
 	return skinned ? _program_skinned.get() : _program.get();
 }
 
+program* material::get_program(bool skinned) const
+{
+	return skinned ? _program_skinned.get() : _program.get();
+}
+
+program* material::get_program_instanced() const
+{
+	return _program_instanced.get();
+}
+
 std::uint64_t material::get_render_states(bool apply_cull, bool depth_write, bool depth_test) const
 {
 	// Set render states.
@@ -99,6 +110,23 @@ standard_material::standard_material()
 
 		},
 		vs_deferred_geom_skinned, fs_deferred_geom);
+
+	if(gfx::getCaps()->supported & BGFX_CAPS_INSTANCING)
+	{
+		auto vs_deferred_geom_instanced = am.load<shader>("engine_data:/shaders/vs_deferred_geom_instanced.sc");
+
+		ts.push_awaitable_on_main(
+			[this](asset_handle<shader> vs, asset_handle<shader> fs) {
+				// without the compiled shader for this renderer items are
+				// simply submitted one by one
+				if(!vs || !fs || !vs->is_valid() || !fs->is_valid())
+					return;
+
+				_program_instanced = std::make_unique<program>(vs, fs);
+
+			},
+			vs_deferred_geom_instanced, fs_deferred_geom);
+	}
 }
 
 void standard_material::submit()
@@ -106,18 +134,37 @@ void standard_material::submit()
 	if(!is_valid())
 		return;
 
-	get_program()->set_uniform("u_base_color", &_base_color);
-	get_program()->set_uniform("u_subsurface_color", &_subsurface_color);
-	get_program()->set_uniform("u_emissive_color", &_emissive_color);
-	get_program()->set_uniform("u_surface_data", &_surface_data);
-	get_program()->set_uniform("u_tiling", &_tiling);
-	get_program()->set_uniform("u_dither_threshold", &_dither_threshold);
-
-	const auto& color_map = _maps["color"];
-	const auto& normal_map = _maps["normal"];
-	const auto& roughness_map = _maps["roughness"];
-	const auto& metalness_map = _maps["metalness"];
-	const auto& ao_map = _maps["ao"];
+	static const auto u_base_color = program::resolve_uniform("u_base_color");
+	static const auto u_subsurface_color = program::resolve_uniform("u_subsurface_color");
+	static const auto u_emissive_color = program::resolve_uniform("u_emissive_color");
+	static const auto u_surface_data = program::resolve_uniform("u_surface_data");
+	static const auto u_tiling = program::resolve_uniform("u_tiling");
+	static const auto u_dither_threshold = program::resolve_uniform("u_dither_threshold");
+	static const auto s_tex_color = program::resolve_uniform("s_tex_color");
+	static const auto s_tex_normal = program::resolve_uniform("s_tex_normal");
+	static const auto s_tex_roughness = program::resolve_uniform("s_tex_roughness");
+	static const auto s_tex_metalness = program::resolve_uniform("s_tex_metalness");
+	static const auto s_tex_ao = program::resolve_uniform("s_tex_ao");
+
+	static const std::string color_key = "color";
+	static const std::string normal_key = "normal";
+	static const std::string roughness_key = "roughness";
+	static const std::string metalness_key = "metalness";
+	static const std::string ao_key = "ao";
+
+	auto prog = get_program();
+	prog->set_uniform(u_base_color, &_base_color);
+	prog->set_uniform(u_subsurface_color, &_subsurface_color);
+	prog->set_uniform(u_emissive_color, &_emissive_color);
+	prog->set_uniform(u_surface_data, &_surface_data);
+	prog->set_uniform(u_tiling, &_tiling);
+	prog->set_uniform(u_dither_threshold, &_dither_threshold);
+
+	const auto& color_map = _maps[color_key];
+	const auto& normal_map = _maps[normal_key];
+	const auto& roughness_map = _maps[roughness_key];
+	const auto& metalness_map = _maps[metalness_key];
+	const auto& ao_map = _maps[ao_key];
 
 	auto albedo = color_map ? color_map : _default_color_map;
 	auto normal = normal_map ? normal_map : _default_normal_map;
@@ -125,9 +172,9 @@ void standard_material::submit()
 	auto metalness = metalness_map ? metalness_map : _default_color_map;
 	auto ao = ao_map ? ao_map : _default_color_map;
 
-	get_program()->set_texture(0, "s_tex_color", albedo.get());
-	get_program()->set_texture(1, "s_tex_normal", normal.get());
-	get_program()->set_texture(2, "s_tex_roughness", roughness.get());
-	get_program()->set_texture(3, "s_tex_metalness", metalness.get());
-	get_program()->set_texture(4, "s_tex_ao", ao.get());
+	prog->set_texture(0, s_tex_color, albedo.get());
+	prog->set_texture(1, s_tex_normal, normal.get());
+	prog->set_texture(2, s_tex_roughness, roughness.get());
+	prog->set_texture(3, s_tex_metalness, metalness.get());
+	prog->set_texture(4, s_tex_ao, ao.get());
 }
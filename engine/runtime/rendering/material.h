@@ -124,6 +124,24 @@ public:
 	//-----------------------------------------------------------------------------
 	program* get_program() const;
 
+	//-----------------------------------------------------------------------------
+	//  Name : get_program ()
+	/// <summary>
+	/// Returns the program of the skinned or static variant without changing
+	/// the skinned flag, so it can be called from several threads.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	program* get_program(bool skinned) const;
+
+	//-----------------------------------------------------------------------------
+	//  Name : get_program_instanced ()
+	/// <summary>
+	/// Returns the program drawing many instances with the world matrices
+	/// in instance data, or nullptr when instancing is not available.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	program* get_program_instanced() const;
+
 	//-----------------------------------------------------------------------------
 	//  Name : submit (virtual )
 	/// <summary>
@@ -178,6 +196,8 @@ protected:
 	std::unique_ptr<program> _program;
 	/// Program that is responsible for rendering.
 	std::unique_ptr<program> _program_skinned;
+	/// Program that is responsible for instanced rendering.
+	std::unique_ptr<program> _program_instanced;
 	/// Cull type for this material.
 	cull_type _cull_type = cull_type::counter_clockwise;
 	/// Default color texture
@@ -2,11 +2,13 @@
 #include "core/logging/logging.h"
 #include "core/memory/checked_delete.h"
 #include "index_buffer.h"
+#include "mesh_blob.h"
 #include "mesh_tools.h"
 #include "vertex_buffer.h"
 #include <algorithm>
 #include <cmath>
 #include <cstring>
+#include <unordered_map>
 
 #define RMC_DEFINE_DATA                                                                                      \
 	std::vector<math::vec3> vertices;                                                                        \
@@ -84,6 +86,7 @@ void mesh::dispose()
 	// Release bone palettes and skin data (if any)
 	_bone_palettes.clear();
 	_skin_bind_data.clear();
+	_bone_transforms.clear();
 
 	// Clean up preparation data.
 	if(_preparation_data.owns_source == true)
@@ -501,6 +504,8 @@ bool mesh::bind_skin(const skin_bind_data& bind_data)
 
 	vertex_table.clear();
 
+	update_bone_transforms();
+
 	// Skin is now bound?
 	return true;
 }
@@ -508,9 +513,46 @@ bool mesh::bind_skin(const skin_bind_data& bind_data)
 bool mesh::bind_armature(std::unique_ptr<armature_node>& root)
 {
 	_root = std::move(root);
+	update_bone_transforms();
 	return true;
 }
 
+void mesh::update_bone_transforms()
+{
+	const auto& bones = _skin_bind_data.get_bones();
+	_bone_transforms.clear();
+	if(bones.empty())
+		return;
+
+	// Bones without a matching node keep just their bind pose.
+	_bone_transforms.reserve(bones.size());
+	std::unordered_map<std::string, std::size_t> bone_lookup;
+	for(std::size_t i = 0; i < bones.size(); ++i)
+	{
+		bone_lookup.emplace(bones[i].bone_id, i);
+		_bone_transforms.push_back(bones[i].bind_pose_transform);
+	}
+
+	if(!_root)
+		return;
+
+	std::vector<const armature_node*> stack = {_root.get()};
+	while(!stack.empty())
+	{
+		const auto node = stack.back();
+		stack.pop_back();
+
+		for(const auto& child : node->children)
+		{
+			auto it = bone_lookup.find(child->name);
+			if(it != bone_lookup.end())
+				_bone_transforms[it->second] = child->world_transform * bones[it->second].bind_pose_transform;
+
+			stack.push_back(child.get());
+		}
+	}
+}
+
 void mesh::set_subset_count(uint32_t count)
 {
 	if(count > 0)
@@ -3031,6 +3073,321 @@ void mesh::build_ib(bool hardware_copy)
 	} // End if hardware buffer required
 }
 
+bool mesh::write_blob(std::vector<std::uint8_t>& blob) const
+{
+	if(_prepare_status != mesh_status::prepared)
+		return false;
+
+	std::vector<char> strings;
+	auto add_string = [&strings](const std::string& str) {
+		mesh_blob::string_ref ref;
+		ref.offset = static_cast<std::uint32_t>(strings.size());
+		ref.size = static_cast<std::uint32_t>(str.size());
+		strings.insert(strings.end(), str.begin(), str.end());
+		return ref;
+	};
+
+	std::vector<subset> subsets;
+	subsets.reserve(_mesh_subsets.size());
+	for(const auto sub : _mesh_subsets)
+		subsets.push_back(*sub);
+
+	std::vector<mesh_blob::palette> palettes;
+	std::vector<std::uint32_t> palette_bones;
+	for(const auto& palette : _bone_palettes)
+	{
+		const auto& bones = palette.get_bones();
+		mesh_blob::palette entry;
+		entry.data_group_id = palette.get_data_group();
+		entry.maximum_size = palette.get_maximum_size();
+		entry.maximum_blend_index = palette.get_maximum_blend_index();
+		entry.bone_offset = static_cast<std::uint32_t>(palette_bones.size());
+		entry.bone_count = static_cast<std::uint32_t>(bones.size());
+		palette_bones.insert(palette_bones.end(), bones.begin(), bones.end());
+		palettes.push_back(entry);
+	}
+
+	std::vector<mesh_blob::bone> bones;
+	for(const auto& bone : _skin_bind_data.get_bones())
+	{
+		mesh_blob::bone entry;
+		entry.name = add_string(bone.bone_id);
+		std::memcpy(entry.bind_pose, math::value_ptr(bone.bind_pose_transform.matrix()),
+					sizeof(entry.bind_pose));
+		bones.push_back(entry);
+	}
+
+	// Flatten the armature, a node is always added before its children.
+	// Children are pushed in reverse so they are popped, and later loaded,
+	// in their original order.
+	std::vector<mesh_blob::node> nodes;
+	std::vector<std::pair<const armature_node*, std::int32_t>> stack;
+	if(_root)
+		stack.emplace_back(_root.get(), -1);
+	while(!stack.empty())
+	{
+		const auto current = stack.back();
+		stack.pop_back();
+
+		mesh_blob::node entry;
+		entry.parent = current.second;
+		entry.name = add_string(current.first->name);
+		std::memcpy(entry.local_transform, math::value_ptr(current.first->local_transform.matrix()),
+					sizeof(entry.local_transform));
+		std::memcpy(entry.world_transform, math::value_ptr(current.first->world_transform.matrix()),
+					sizeof(entry.world_transform));
+		const auto index = static_cast<std::int32_t>(nodes.size());
+		nodes.push_back(entry);
+
+		const auto& children = current.first->children;
+		for(auto it = children.rbegin(); it != children.rend(); ++it)
+			stack.emplace_back(it->get(), index);
+	}
+
+	mesh_blob::info info;
+	info.vertex_count = _vertex_count;
+	info.face_count = _face_count;
+	info.vertex_format_size = sizeof(gfx::VertexDecl);
+	info.palette_size = gfx::get_max_blend_transforms();
+	std::memcpy(info.bbox_min, math::value_ptr(_bbox.min), sizeof(info.bbox_min));
+	std::memcpy(info.bbox_max, math::value_ptr(_bbox.max), sizeof(info.bbox_max));
+
+	std::vector<mesh_blob::section> table;
+	blob.clear();
+	blob.resize(sizeof(mesh_blob::header) + mesh_blob::section_count * sizeof(mesh_blob::section));
+
+	auto add_section = [&](mesh_blob::section_type type, const void* data, std::size_t size,
+						   std::size_t count) {
+		const auto align = mesh_blob::section_alignment;
+		blob.resize((blob.size() + align - 1) / align * align);
+
+		mesh_blob::section entry;
+		entry.type = type;
+		entry.count = static_cast<std::uint32_t>(count);
+		entry.offset = blob.size();
+		entry.size = size;
+		table.push_back(entry);
+
+		const auto bytes = static_cast<const std::uint8_t*>(data);
+		blob.insert(blob.end(), bytes, bytes + size);
+	};
+
+	add_section(mesh_blob::info_section, &info, sizeof(info), 1);
+	add_section(mesh_blob::vertex_format_section, &_vertex_format, sizeof(gfx::VertexDecl), 1);
+	add_section(mesh_blob::vertices_section, _system_vb, _vertex_count * _vertex_format.getStride(),
+				_vertex_count);
+	add_section(mesh_blob::indices_section, _system_ib, _face_count * 3 * sizeof(std::uint32_t),
+				_face_count * 3);
+	add_section(mesh_blob::subsets_section, subsets.data(), subsets.size() * sizeof(subset), subsets.size());
+	add_section(mesh_blob::palettes_section, palettes.data(), palettes.size() * sizeof(mesh_blob::palette),
+				palettes.size());
+	add_section(mesh_blob::palette_bones_section, palette_bones.data(),
+				palette_bones.size() * sizeof(std::uint32_t), palette_bones.size());
+	add_section(mesh_blob::bones_section, bones.data(), bones.size() * sizeof(mesh_blob::bone), bones.size());
+	add_section(mesh_blob::nodes_section, nodes.data(), nodes.size() * sizeof(mesh_blob::node), nodes.size());
+	add_section(mesh_blob::strings_section, strings.data(), strings.size(), strings.size());
+
+	mesh_blob::header header;
+	header.size = blob.size();
+	header.section_count = static_cast<std::uint32_t>(table.size());
+	std::memcpy(blob.data(), &header, sizeof(header));
+	std::memcpy(blob.data() + sizeof(header), table.data(), table.size() * sizeof(mesh_blob::section));
+
+	return true;
+}
+
+bool mesh::is_blob(const std::uint8_t* data, std::size_t size)
+{
+	if(size < sizeof(mesh_blob::header))
+		return false;
+
+	mesh_blob::header header;
+	std::memcpy(&header, data, sizeof(header));
+	return header.magic == mesh_blob::magic && header.version == mesh_blob::version;
+}
+
+bool mesh::read_blob(const std::uint8_t* data, std::size_t size)
+{
+	if(!is_blob(data, size))
+		return false;
+
+	const auto& header = *reinterpret_cast<const mesh_blob::header*>(data);
+	if(header.size > size ||
+	   sizeof(header) + header.section_count * sizeof(mesh_blob::section) > header.size)
+	{
+		APPLOG_ERROR("Compiled mesh is truncated.");
+		return false;
+	}
+
+	// Validate the table once, after that sections are used without checks.
+	const mesh_blob::section* sections[mesh_blob::section_count] = {};
+	const auto table = reinterpret_cast<const mesh_blob::section*>(data + sizeof(header));
+	for(std::uint32_t i = 0; i < header.section_count; ++i)
+	{
+		const auto& entry = table[i];
+		if(entry.type >= mesh_blob::section_count || entry.offset % mesh_blob::section_alignment != 0 ||
+		   entry.offset + entry.size > header.size)
+		{
+			APPLOG_ERROR("Compiled mesh has an invalid section.");
+			return false;
+		}
+		sections[entry.type] = &entry;
+	}
+
+	auto get_section = [&](mesh_blob::section_type type, std::size_t element_size,
+						   std::uint32_t& count) -> const std::uint8_t* {
+		const auto entry = sections[type];
+		if(entry == nullptr || entry->size != entry->count * std::uint64_t(element_size))
+			return nullptr;
+		count = entry->count;
+		return data + entry->offset;
+	};
+
+	std::uint32_t info_count = 0;
+	std::uint32_t format_count = 0;
+	const auto info_data = get_section(mesh_blob::info_section, sizeof(mesh_blob::info), info_count);
+	const auto format_data =
+		get_section(mesh_blob::vertex_format_section, sizeof(gfx::VertexDecl), format_count);
+	if(info_data == nullptr || format_data == nullptr || info_count != 1 || format_count != 1)
+	{
+		APPLOG_ERROR("Compiled mesh was written by an incompatible version, it has to be recompiled.");
+		return false;
+	}
+
+	const auto& info = *reinterpret_cast<const mesh_blob::info*>(info_data);
+	if(info.palette_size > gfx::get_max_blend_transforms())
+	{
+		APPLOG_ERROR("Compiled mesh uses bone palettes larger than supported, it has to be recompiled.");
+		return false;
+	}
+
+	gfx::VertexDecl vertex_format;
+	std::memcpy(&vertex_format, format_data, sizeof(gfx::VertexDecl));
+
+	std::uint32_t vertex_count = 0;
+	std::uint32_t index_count = 0;
+	std::uint32_t subset_count = 0;
+	std::uint32_t palette_count = 0;
+	std::uint32_t palette_bone_count = 0;
+	std::uint32_t bone_count = 0;
+	std::uint32_t node_count = 0;
+	std::uint32_t string_count = 0;
+	const auto vertices = get_section(mesh_blob::vertices_section, vertex_format.getStride(), vertex_count);
+	const auto indices = get_section(mesh_blob::indices_section, sizeof(std::uint32_t), index_count);
+	const auto subsets = reinterpret_cast<const subset*>(
+		get_section(mesh_blob::subsets_section, sizeof(subset), subset_count));
+	const auto palettes = reinterpret_cast<const mesh_blob::palette*>(
+		get_section(mesh_blob::palettes_section, sizeof(mesh_blob::palette), palette_count));
+	const auto palette_bones = reinterpret_cast<const std::uint32_t*>(
+		get_section(mesh_blob::palette_bones_section, sizeof(std::uint32_t), palette_bone_count));
+	const auto bones = reinterpret_cast<const mesh_blob::bone*>(
+		get_section(mesh_blob::bones_section, sizeof(mesh_blob::bone), bone_count));
+	const auto nodes = reinterpret_cast<const mesh_blob::node*>(
+		get_section(mesh_blob::nodes_section, sizeof(mesh_blob::node), node_count));
+	const auto strings =
+		reinterpret_cast<const char*>(get_section(mesh_blob::strings_section, 1, string_count));
+
+	if(vertices == nullptr || indices == nullptr || subsets == nullptr || palettes == nullptr ||
+	   palette_bones == nullptr || bones == nullptr || nodes == nullptr || strings == nullptr ||
+	   vertex_count != info.vertex_count || index_count != info.face_count * 3)
+	{
+		APPLOG_ERROR("Compiled mesh is missing sections.");
+		return false;
+	}
+
+	// Every node but the root has to come after its parent.
+	for(std::uint32_t i = 1; i < node_count; ++i)
+	{
+		if(nodes[i].parent < 0 || nodes[i].parent >= static_cast<std::int32_t>(i))
+		{
+			APPLOG_ERROR("Compiled mesh has an invalid armature.");
+			return false;
+		}
+	}
+
+	auto get_string = [&](const mesh_blob::string_ref& ref) {
+		if(std::uint64_t(ref.offset) + ref.size > string_count)
+			return std::string();
+		return std::string(strings + ref.offset, ref.size);
+	};
+
+	if(_prepare_status != mesh_status::not_prepared)
+		dispose();
+
+	// Buffers
+	_vertex_format = vertex_format;
+	_vertex_count = info.vertex_count;
+	_face_count = info.face_count;
+	_system_vb = new std::uint8_t[_vertex_count * _vertex_format.getStride()];
+	std::memcpy(_system_vb, vertices, _vertex_count * _vertex_format.getStride());
+	_system_ib = new std::uint32_t[_face_count * 3];
+	std::memcpy(_system_ib, indices, _face_count * 3 * sizeof(std::uint32_t));
+	_bbox.min = math::vec3(info.bbox_min[0], info.bbox_min[1], info.bbox_min[2]);
+	_bbox.max = math::vec3(info.bbox_max[0], info.bbox_max[1], info.bbox_max[2]);
+
+	// Subset tables, stored in draw order so they only need to be indexed.
+	_triangle_data.resize(_face_count);
+	for(std::uint32_t i = 0; i < subset_count; ++i)
+	{
+		auto sub = new subset(subsets[i]);
+		_mesh_subsets.push_back(sub);
+		_subset_lookup[mesh_subset_key(sub->data_group_id)] = sub;
+		_data_groups[sub->data_group_id].push_back(sub);
+
+		const auto face_start = static_cast<std::uint32_t>(std::max(sub->face_start, 0));
+		const auto face_end = std::min(face_start + sub->face_count, _face_count);
+		for(auto j = face_start; j < face_end; ++j)
+			_triangle_data[j].data_group_id = sub->data_group_id;
+	}
+
+	// Skin
+	for(std::uint32_t i = 0; i < bone_count; ++i)
+	{
+		skin_bind_data::bone_influence bone;
+		bone.bone_id = get_string(bones[i].name);
+		bone.bind_pose_transform = math::make_mat4(bones[i].bind_pose);
+		_skin_bind_data.add_bone(bone);
+	}
+
+	for(std::uint32_t i = 0; i < palette_count; ++i)
+	{
+		const auto& entry = palettes[i];
+		const auto bone_offset = std::min(entry.bone_offset, palette_bone_count);
+		const auto bone_end = std::min(bone_offset + entry.bone_count, palette_bone_count);
+
+		bone_palette palette(entry.maximum_size);
+		palette.set_data_group(entry.data_group_id);
+		palette.set_maximum_blend_index(entry.maximum_blend_index);
+		palette.assign_bones(
+			std::vector<std::uint32_t>(palette_bones + bone_offset, palette_bones + bone_end));
+		_bone_palettes.push_back(palette);
+	}
+
+	// Armature
+	std::vector<armature_node*> armature;
+	armature.reserve(node_count);
+	for(std::uint32_t i = 0; i < node_count; ++i)
+	{
+		std::unique_ptr<armature_node> node(new armature_node());
+		node->name = get_string(nodes[i].name);
+		node->local_transform = math::make_mat4(nodes[i].local_transform);
+		node->world_transform = math::make_mat4(nodes[i].world_transform);
+		armature.push_back(node.get());
+
+		if(i == 0)
+			_root = std::move(node);
+		else
+			armature[static_cast<std::size_t>(nodes[i].parent)]->children.push_back(std::move(node));
+	}
+	update_bone_transforms();
+
+	_prepare_status = mesh_status::prepared;
+	_hardware_mesh = true;
+	_optimize_mesh = false;
+
+	return true;
+}
+
 bool mesh::sort_mesh_data(bool optimize, bool hardware_copy, bool build_buffer)
 {
 	std::map<mesh_subset_key, std::uint32_t> subset_sizes;
@@ -4494,6 +4851,31 @@ const mesh::armature_node* mesh::get_armature() const
 	return _root.get();
 }
 
+const std::vector<math::transform>& mesh::get_bone_transforms() const
+{
+	return _bone_transforms;
+}
+
+void mesh::get_skinning_matrices(const math::transform& root_transform,
+								 std::vector<math::transform>& matrices) const
+{
+	std::size_t count = 0;
+	for(const auto& palette : _bone_palettes)
+	{
+		count += palette.get_bones().size();
+	}
+	matrices.resize(count);
+
+	auto out = matrices.data();
+	for(const auto& palette : _bone_palettes)
+	{
+		for(auto bone : palette.get_bones())
+		{
+			*out++ = root_transform * _bone_transforms[bone];
+		}
+	}
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // skin_bind_data Member Definitions
 ///////////////////////////////////////////////////////////////////////////////
@@ -692,6 +692,34 @@ public:
 	//-----------------------------------------------------------------------------
 	void build_ib(bool hardware_copy = true);
 
+	//-----------------------------------------------------------------------------
+	//  Name : write_blob ()
+	/// <summary>
+	/// Writes the prepared mesh in the compiled mesh format, see mesh_blob.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	bool write_blob(std::vector<std::uint8_t>& blob) const;
+
+	//-----------------------------------------------------------------------------
+	//  Name : read_blob ()
+	/// <summary>
+	/// Restores a prepared mesh from a compiled blob aligned to
+	/// mesh_blob::section_alignment. Buffers and tables are copied as they
+	/// are, nothing is sorted or generated again. The hardware buffers are
+	/// left to build_vb and build_ib.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	bool read_blob(const std::uint8_t* data, std::size_t size);
+
+	//-----------------------------------------------------------------------------
+	//  Name : is_blob ()
+	/// <summary>
+	/// Checks whether the data starts with a compiled mesh header of the
+	/// current version.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	static bool is_blob(const std::uint8_t* data, std::size_t size);
+
 	// Utility functions
 	//-----------------------------------------------------------------------------
 	//  Name : generate_adjacency ()
@@ -772,6 +800,27 @@ public:
 	const bone_palette_array_t& get_bone_palettes() const;
 
 	const armature_node* get_armature() const;
+
+	//-----------------------------------------------------------------------------
+	//  Name : get_bone_transforms ()
+	/// <summary>
+	/// Transform of each bone in the skin bind data, the world transform of
+	/// the armature node with the bone's name combined with the bind pose.
+	/// Built once when the skin or the armature is bound.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	const std::vector<math::transform>& get_bone_transforms() const;
+
+	//-----------------------------------------------------------------------------
+	//  Name : get_skinning_matrices ()
+	/// <summary>
+	/// Writes the skinning matrices of every bone palette for the given
+	/// world transform, one palette after the other in palette order. The
+	/// buffer is resized but its memory is reused between calls.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void get_skinning_matrices(const math::transform& root_transform,
+							   std::vector<math::transform>& matrices) const;
 	//-----------------------------------------------------------------------------
 	//  Name : get_subset ()
 	/// <summary>
@@ -1133,6 +1182,17 @@ protected:
 	bone_palette_array_t _bone_palettes;
 	/// List of each of armature nodes
 	std::unique_ptr<armature_node> _root = nullptr;
+	/// Node transform times bind pose of each bone, see get_bone_transforms.
+	std::vector<math::transform> _bone_transforms;
+
+	//-----------------------------------------------------------------------------
+	//  Name : update_bone_transforms ()
+	/// <summary>
+	/// Maps the bones to the armature nodes by name and rebuilds the bone
+	/// transforms.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void update_bone_transforms();
 };
 
 //-----------------------------------------------------------------------------
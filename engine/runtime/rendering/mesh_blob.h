@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdint>
+
+//-----------------------------------------------------------------------------
+//  Name : mesh_blob (Namespace)
+/// <summary>
+/// Layout of the compiled mesh format. A blob is a header followed by a
+/// table of sections, every section starts on a section_alignment boundary
+/// and holds plain arrays, so a blob read or mapped in one go can be used in
+/// place. Offsets are relative to the start of the blob, strings live in a
+/// shared string section and are referenced by offset and size.
+/// </summary>
+//-----------------------------------------------------------------------------
+namespace mesh_blob
+{
+/// "EMSH" in little endian.
+const std::uint32_t magic = 0x48534D45;
+/// Bumped whenever the layout of a section changes.
+const std::uint32_t version = 1;
+const std::uint32_t section_alignment = 16;
+
+enum section_type : std::uint32_t
+{
+	/// One info.
+	info_section,
+	/// The vertex declaration, as stored by the renderer.
+	vertex_format_section,
+	/// Interleaved vertices in the declared format.
+	vertices_section,
+	/// 32 bit indices, three per face, sorted by subset.
+	indices_section,
+	/// Array of mesh::subset in draw order.
+	subsets_section,
+	/// Array of palette.
+	palettes_section,
+	/// Bone indices the palettes point into.
+	palette_bones_section,
+	/// Array of bone.
+	bones_section,
+	/// Array of node, parents come before their children.
+	nodes_section,
+	/// Characters of all names.
+	strings_section,
+	section_count
+};
+
+struct header
+{
+	std::uint32_t magic = mesh_blob::magic;
+	std::uint32_t version = mesh_blob::version;
+	/// Size of the whole blob in bytes.
+	std::uint64_t size = 0;
+	std::uint32_t section_count = 0;
+	std::uint32_t reserved = 0;
+};
+
+struct section
+{
+	section_type type = info_section;
+	/// Number of elements.
+	std::uint32_t count = 0;
+	std::uint64_t offset = 0;
+	std::uint64_t size = 0;
+};
+
+struct info
+{
+	std::uint32_t vertex_count = 0;
+	std::uint32_t face_count = 0;
+	/// Size of the vertex declaration when the blob was written.
+	std::uint32_t vertex_format_size = 0;
+	/// Bone palette size the skin was split for.
+	std::uint32_t palette_size = 0;
+	float bbox_min[3] = {0.0f, 0.0f, 0.0f};
+	float bbox_max[3] = {0.0f, 0.0f, 0.0f};
+};
+
+struct string_ref
+{
+	std::uint32_t offset = 0;
+	std::uint32_t size = 0;
+};
+
+struct palette
+{
+	std::uint32_t data_group_id = 0;
+	std::uint32_t maximum_size = 0;
+	std::int32_t maximum_blend_index = -1;
+	/// Range in the palette bones.
+	std::uint32_t bone_offset = 0;
+	std::uint32_t bone_count = 0;
+};
+
+struct bone
+{
+	string_ref name;
+	float bind_pose[16];
+};
+
+struct node
+{
+	/// Index of the parent node, -1 for the root.
+	std::int32_t parent = -1;
+	string_ref name;
+	float local_transform[16];
+	float world_transform[16];
+};
+}
@@ -6,6 +6,8 @@
 #include "mesh.h"
 #include "program.h"
 #include "vertex_buffer.h"
+#include <algorithm>
+#include <iterator>
 
 model::model()
 {
@@ -116,18 +118,46 @@ void model::set_lod_min_distance(float distance)
 	_min_distance = distance;
 }
 
-void process_node(const mesh::armature_node* const node, const skin_bind_data& bind_data,
-				  std::vector<math::transform>& bones)
+void model::set_lod_max_screen_size(float size)
 {
-	for(auto& child : node->children)
+	if(size < _min_screen_size)
+		size = _min_screen_size;
+
+	_max_screen_size = size;
+}
+
+void model::set_lod_min_screen_size(float size)
+{
+	if(size > _max_screen_size)
+		size = _max_screen_size;
+
+	_min_screen_size = size;
+}
+
+void model::set_lod_hysteresis(float hysteresis)
+{
+	_hysteresis = math::clamp(hysteresis, 0.0f, 0.5f);
+}
+
+const std::vector<math::transform>& skinning_cache::get_matrices(const mesh& msh,
+																 const math::transform& world_transform)
+{
+	auto it = std::find_if(std::begin(_entries), std::end(_entries),
+						   [&msh](const entry& e) { return e.msh == &msh; });
+	if(it == std::end(_entries))
 	{
-		auto bone = bind_data.find_bone_by_id(child->name);
-		if(bone)
-		{
-			bones.push_back(child->world_transform);
-		}
-		process_node(child.get(), bind_data, bones);
+		_entries.emplace_back();
+		it = std::prev(std::end(_entries));
 	}
+	else if(it->world_transform == world_transform)
+	{
+		return it->matrices;
+	}
+
+	it->msh = &msh;
+	it->world_transform = world_transform;
+	msh.get_skinning_matrices(world_transform, it->matrices);
+	return it->matrices;
 }
 
 void model::render(std::uint8_t id, const math::transform& mtx, bool apply_cull, bool depth_write,
@@ -195,24 +225,20 @@ void model::render(std::uint8_t id, const math::transform& mtx, bool apply_cull,
 	// Has skinning data?
 	if(skin_data.has_bones())
 	{
-		mesh->get_armature();
-		// Build an array containing all of the bones that are required
-		// by the binding data in the skinned mesh.
-		std::vector<math::transform> node_transforms;
-		process_node(mesh->get_armature(), skin_data, node_transforms);
+		std::vector<math::transform> skinning_matrices;
+		mesh->get_skinning_matrices(mtx, skinning_matrices);
 
 		// Process each palette in the skin with a matching attribute.
+		std::size_t offset = 0;
 		const auto& palettes = mesh->get_bone_palettes();
 		for(const auto& palette : palettes)
 		{
-			// Apply the bone palette.
-			auto skinning_matrices = palette.get_skinning_matrices(mtx, node_transforms, skin_data, false);
-			// auto max_blend_index = palette.get_maximum_blend_index();
-
+			const auto count = palette.get_bones().size();
 			auto data_group = palette.get_data_group();
-			render_subset(id, true, data_group, reinterpret_cast<float*>(&skinning_matrices[0]),
-						  std::uint32_t(skinning_matrices.size()), apply_cull, depth_write, depth_test,
-						  extra_states, user_program, setup_params);
+			render_subset(id, true, data_group, reinterpret_cast<const float*>(&skinning_matrices[offset]),
+						  std::uint32_t(count), apply_cull, depth_write, depth_test, extra_states, user_program,
+						  setup_params);
+			offset += count;
 
 		} // Next Palette
 	}
@@ -225,3 +251,70 @@ void model::render(std::uint8_t id, const math::transform& mtx, bool apply_cull,
 		}
 	}
 }
+
+void model::record(render_queue::recorder& queue, const math::transform& mtx, std::uint8_t layer, float depth,
+				   bool apply_cull, bool depth_write, bool depth_test, std::uint64_t extra_states,
+				   unsigned int lod, const math::vec4& params, skinning_cache* skinning) const
+{
+	const auto mesh = get_lod(lod);
+	if(!mesh)
+		return;
+
+	auto record_subset = [&](bool skinned, std::uint32_t group_id, const math::transform* transforms,
+							 std::uint32_t count) {
+		const auto mat = get_material_for_group(group_id);
+		if(!mat)
+			return;
+
+		auto program = mat->get_program(skinned);
+		if(!program)
+			return;
+
+		draw_item item;
+		item.key = render_queue::make_sort_key(layer, program, mat.get(), mesh.get(), group_id, depth);
+		item.prog = program;
+		item.instanced_prog = skinned ? nullptr : mat->get_program_instanced();
+		item.mat = mat.get();
+		item.msh = mesh.get();
+		item.group_id = group_id;
+		item.states = extra_states | mat->get_render_states(apply_cull, depth_write, depth_test);
+		item.skinned = skinned;
+		item.params = params;
+		queue.add(item, transforms, count);
+	};
+
+	const auto& skin_data = mesh->get_skin_bind_data();
+
+	// Has skinning data?
+	if(skin_data.has_bones())
+	{
+		// without a cache use a per thread scratch buffer
+		static thread_local std::vector<math::transform> scratch;
+		const math::transform* skinning_matrices = nullptr;
+		if(skinning)
+		{
+			skinning_matrices = skinning->get_matrices(*mesh.get(), mtx).data();
+		}
+		else
+		{
+			mesh->get_skinning_matrices(mtx, scratch);
+			skinning_matrices = scratch.data();
+		}
+
+		// Process each palette in the skin with a matching attribute.
+		const auto& palettes = mesh->get_bone_palettes();
+		for(const auto& palette : palettes)
+		{
+			const auto count = std::uint32_t(palette.get_bones().size());
+			record_subset(true, palette.get_data_group(), skinning_matrices, count);
+			skinning_matrices += count;
+		}
+	}
+	else
+	{
+		for(std::size_t i = 0; i < mesh->get_subset_count(); ++i)
+		{
+			record_subset(false, std::uint32_t(i), &mtx, 1);
+		}
+	}
+}
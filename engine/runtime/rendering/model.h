@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../assets/asset_handle.h"
+#include "render_queue.h"
 #include "core/math/math_includes.h"
 #include "core/reflection/registration.h"
 #include "core/serialization/serialization.h"
@@ -11,6 +12,44 @@ class mesh;
 struct program;
 class material;
 
+enum class lod_metric : std::uint8_t
+{
+	distance = 0,
+	screen_size = 1,
+
+	count
+};
+
+//-----------------------------------------------------------------------------
+//  Name : skinning_cache (Struct)
+/// <summary>
+/// Skinning matrices of one instance. They are computed again only when the
+/// mesh or the world transform changes, so every pass drawing the instance
+/// shares them and the buffers are reused between frames.
+/// </summary>
+//-----------------------------------------------------------------------------
+struct skinning_cache
+{
+	//-----------------------------------------------------------------------------
+	//  Name : get_matrices ()
+	/// <summary>
+	/// Returns the matrices of every palette of the mesh, see
+	/// mesh::get_skinning_matrices.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	const std::vector<math::transform>& get_matrices(const mesh& msh, const math::transform& world_transform);
+
+private:
+	struct entry
+	{
+		const mesh* msh = nullptr;
+		math::transform world_transform;
+		std::vector<math::transform> matrices;
+	};
+	/// One entry per mesh, lods use different meshes.
+	std::vector<entry> _entries;
+};
+
 class model
 {
 public:
@@ -199,6 +238,85 @@ public:
 	//-----------------------------------------------------------------------------
 	void set_lod_min_distance(float distance);
 
+	//-----------------------------------------------------------------------------
+	//  Name : get_lod_metric ()
+	/// <summary>
+	/// Returns whether lods are picked by distance or by screen size.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	inline lod_metric get_lod_metric() const
+	{
+		return _lod_metric;
+	}
+
+	//-----------------------------------------------------------------------------
+	//  Name : set_lod_metric ()
+	/// <summary>
+	/// Sets whether lods are picked by distance or by screen size.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	inline void set_lod_metric(lod_metric metric)
+	{
+		_lod_metric = metric;
+	}
+
+	//-----------------------------------------------------------------------------
+	//  Name : get_lod_max_screen_size ()
+	/// <summary>
+	/// Screen size, as a fraction of the viewport height, above which the
+	/// first lod is used.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	inline float get_lod_max_screen_size() const
+	{
+		return _max_screen_size;
+	}
+
+	//-----------------------------------------------------------------------------
+	//  Name : get_lod_min_screen_size ()
+	/// <summary>
+	/// Screen size, as a fraction of the viewport height, below which the
+	/// last lod is used.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	inline float get_lod_min_screen_size() const
+	{
+		return _min_screen_size;
+	}
+
+	//-----------------------------------------------------------------------------
+	//  Name : set_lod_max_screen_size ()
+	/// <summary>
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void set_lod_max_screen_size(float size);
+
+	//-----------------------------------------------------------------------------
+	//  Name : set_lod_min_screen_size ()
+	/// <summary>
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void set_lod_min_screen_size(float size);
+
+	//-----------------------------------------------------------------------------
+	//  Name : get_lod_hysteresis ()
+	/// <summary>
+	/// Fraction of a lod band the metric has to move past a band edge before
+	/// another lod is picked, keeps models on an edge from flickering.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	inline float get_lod_hysteresis() const
+	{
+		return _hysteresis;
+	}
+
+	//-----------------------------------------------------------------------------
+	//  Name : set_lod_hysteresis ()
+	/// <summary>
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void set_lod_hysteresis(float hysteresis);
+
 	//-----------------------------------------------------------------------------
 	//  Name : render ()
 	/// <summary>
@@ -211,6 +329,20 @@ public:
 				bool depth_test, std::uint64_t extra_states, unsigned int lod, program* user_program,
 				std::function<void(program&)> setup_params) const;
 
+	//-----------------------------------------------------------------------------
+	//  Name : record ()
+	/// <summary>
+	/// Records the subsets of a lod into a render queue instead of drawing
+	/// them. The materials provide the programs and states, extra states are
+	/// added to them. params is copied to every item. Skinning matrices are
+	/// taken from skinning when given. Safe to call from several threads
+	/// with one recorder each.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void record(render_queue::recorder& queue, const math::transform& mtx, std::uint8_t layer, float depth,
+				bool apply_cull, bool depth_write, bool depth_test, std::uint64_t extra_states,
+				unsigned int lod, const math::vec4& params, skinning_cache* skinning = nullptr) const;
+
 private:
 	/// Collection of all materials for this model.
 	std::vector<asset_handle<material>> _materials;
@@ -224,4 +356,12 @@ private:
 	float _max_distance = 13.0;
 	/// Maximum distance at which lod should have reached 0 (first lod)
 	float _min_distance = 5.0f;
+	/// Metric the lods are picked by.
+	lod_metric _lod_metric = lod_metric::distance;
+	/// Screen size above which the first lod is used.
+	float _max_screen_size = 0.5f;
+	/// Screen size below which the last lod is used.
+	float _min_screen_size = 0.05f;
+	/// Fraction of a lod band used as a dead zone around the band edges.
+	float _hysteresis = 0.1f;
 };
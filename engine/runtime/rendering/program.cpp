@@ -3,6 +3,30 @@
 #include "shader.h"
 #include "texture.h"
 #include "uniform.h"
+#include <mutex>
+
+namespace
+{
+struct uniform_slot_registry
+{
+	std::mutex mutex;
+	std::unordered_map<std::string, std::uint32_t> slots;
+	std::vector<std::string> names;
+};
+
+uniform_slot_registry& get_slot_registry()
+{
+	static uniform_slot_registry registry;
+	return registry;
+}
+
+std::string get_slot_name(uniform_slot slot)
+{
+	auto& registry = get_slot_registry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+	return registry.names[slot.index];
+}
+}
 
 program::program(asset_handle<shader> computeShader)
 {
@@ -96,8 +120,85 @@ std::shared_ptr<uniform> program::get_uniform(const std::string& _name, bool tex
 	return hUniform;
 }
 
+uniform_slot program::resolve_uniform(const std::string& _name)
+{
+	auto& registry = get_slot_registry();
+	std::lock_guard<std::mutex> lock(registry.mutex);
+
+	auto it = registry.slots.find(_name);
+	if(it == registry.slots.end())
+	{
+		it = registry.slots.emplace(_name, static_cast<std::uint32_t>(registry.names.size())).first;
+		registry.names.push_back(_name);
+	}
+
+	uniform_slot slot;
+	slot.index = it->second;
+	return slot;
+}
+
+uniform* program::get_uniform(uniform_slot _slot, bool texture)
+{
+	if(_slot.index >= slot_uniforms.size())
+		slot_uniforms.resize(_slot.index + 1, {false, nullptr});
+
+	auto& entry = slot_uniforms[_slot.index];
+	if(!entry.first || (texture && !entry.second))
+	{
+		entry.second = get_uniform(get_slot_name(_slot), texture).get();
+		entry.first = true;
+	}
+
+	return entry.second;
+}
+
+void program::set_uniform(uniform_slot _slot, const void* _value, std::uint16_t _num)
+{
+	auto hUniform = get_uniform(_slot);
+
+	if(hUniform)
+		gfx::setUniform(hUniform->handle, _value, _num);
+}
+
+void program::set_texture(std::uint8_t _stage, uniform_slot _sampler, frame_buffer* frameBuffer,
+						  uint8_t _attachment /*= 0 */,
+						  std::uint32_t _flags /*= std::numeric_limits<std::uint32_t>::max()*/)
+{
+	if(!frameBuffer)
+		return;
+
+	gfx::setTexture(_stage, get_uniform(_sampler, true)->handle,
+					gfx::getTexture(frameBuffer->handle, _attachment), _flags);
+}
+
+void program::set_texture(std::uint8_t _stage, uniform_slot _sampler, gfx::FrameBufferHandle frameBuffer,
+						  uint8_t _attachment /*= 0 */,
+						  std::uint32_t _flags /*= std::numeric_limits<std::uint32_t>::max()*/)
+{
+	gfx::setTexture(_stage, get_uniform(_sampler, true)->handle, gfx::getTexture(frameBuffer, _attachment),
+					_flags);
+}
+
+void program::set_texture(std::uint8_t _stage, uniform_slot _sampler, texture* _texture,
+						  std::uint32_t _flags /*= std::numeric_limits<std::uint32_t>::max()*/)
+{
+	if(!_texture)
+		return;
+
+	gfx::setTexture(_stage, get_uniform(_sampler, true)->handle, _texture->handle, _flags);
+}
+
+void program::set_texture(std::uint8_t _stage, uniform_slot _sampler, gfx::TextureHandle _texture,
+						  std::uint32_t _flags /*= std::numeric_limits<std::uint32_t>::max()*/)
+{
+	gfx::setTexture(_stage, get_uniform(_sampler, true)->handle, _texture, _flags);
+}
+
 void program::add_shader(asset_handle<shader> shader)
 {
+	// names may now map to other uniforms
+	slot_uniforms.clear();
+
 	for(auto& uniform : shader->uniforms)
 	{
 		uniforms[uniform->info.name] = uniform;
@@ -3,7 +3,9 @@
 #include "../assets/asset_handle.h"
 #include "core/graphics/graphics.h"
 #include <limits>
+#include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 struct frame_buffer;
@@ -11,6 +13,19 @@ struct texture;
 struct shader;
 struct uniform;
 
+//-----------------------------------------------------------------------------
+//  Name : uniform_slot (Struct)
+/// <summary>
+/// A uniform or sampler name resolved once with program::resolve_uniform.
+/// Slots are shared by all programs, each program looks a name up the
+/// first time it is used with a slot and indexes an array afterwards.
+/// </summary>
+//-----------------------------------------------------------------------------
+struct uniform_slot
+{
+	std::uint32_t index = std::numeric_limits<std::uint32_t>::max();
+};
+
 struct program
 {
 	//-----------------------------------------------------------------------------
@@ -139,6 +154,47 @@ struct program
 	//-----------------------------------------------------------------------------
 	std::shared_ptr<uniform> get_uniform(const std::string& _name, bool texture = false);
 
+	//-----------------------------------------------------------------------------
+	//  Name : resolve_uniform ()
+	/// <summary>
+	/// Returns the slot of a uniform or sampler name, the same name always
+	/// gets the same slot. Resolve names once, e.g. into statics.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	static uniform_slot resolve_uniform(const std::string& _name);
+
+	//-----------------------------------------------------------------------------
+	//  Name : set_uniform ()
+	/// <summary>
+	/// Same as the named version without the name lookup.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void set_uniform(uniform_slot _slot, const void* _value, std::uint16_t _num = 1);
+
+	//-----------------------------------------------------------------------------
+	//  Name : set_texture ()
+	/// <summary>
+	/// Same as the named versions without the name lookup.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void set_texture(std::uint8_t _stage, uniform_slot _sampler, frame_buffer* _handle, uint8_t _attachment = 0,
+					 std::uint32_t _flags = std::numeric_limits<std::uint32_t>::max());
+	void set_texture(std::uint8_t _stage, uniform_slot _sampler, gfx::FrameBufferHandle _handle,
+					 uint8_t _attachment = 0, std::uint32_t _flags = std::numeric_limits<std::uint32_t>::max());
+	void set_texture(std::uint8_t _stage, uniform_slot _sampler, texture* _texture,
+					 std::uint32_t _flags = std::numeric_limits<std::uint32_t>::max());
+	void set_texture(std::uint8_t _stage, uniform_slot _sampler, gfx::TextureHandle _texture,
+					 std::uint32_t _flags = std::numeric_limits<std::uint32_t>::max());
+
+	//-----------------------------------------------------------------------------
+	//  Name : get_uniform ()
+	/// <summary>
+	/// Returns the uniform bound to a slot in this program or nullptr.
+	/// Samplers are created when missing, like the named version does.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	uniform* get_uniform(uniform_slot _slot, bool texture = false);
+
 	//-----------------------------------------------------------------------------
 	//  Name : add_shader ()
 	/// <summary>
@@ -175,6 +231,9 @@ struct program
 	std::vector<std::uint16_t> shaders_cached;
 	/// All uniforms for this program.
 	std::unordered_map<std::string, std::shared_ptr<uniform>> uniforms;
+	/// Uniforms looked up so far, indexed by slot. Null entries are names
+	/// this program does not use.
+	std::vector<std::pair<bool, uniform*>> slot_uniforms;
 	/// Internal handle
 	gfx::ProgramHandle handle = {gfx::kInvalidHandle};
 };
@@ -0,0 +1,269 @@
+#include "render_queue.h"
+#include "core/graphics/graphics.h"
+#include "material.h"
+#include "mesh.h"
+#include "program.h"
+#include <algorithm>
+
+namespace
+{
+std::uint64_t hash_pointer(const void* p, std::uint32_t bits)
+{
+	// Fibonacci hashing, keeps the top bits of the product
+	const auto value = static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(p));
+	return ((value >> 4) * 11400714819323198485ull) >> (64 - bits);
+}
+
+bool same_state(const draw_item& a, const draw_item& b)
+{
+	return a.prog == b.prog && a.mat == b.mat && a.skinned == b.skinned;
+}
+
+bool can_instance(const draw_item& a, const draw_item& b)
+{
+	return b.instanced_prog == a.instanced_prog && b.mat == a.mat && b.msh == a.msh &&
+		   b.group_id == a.group_id && b.states == a.states && b.params == a.params && b.transform_count == 1;
+}
+
+// instanced draws below this size are not worth the instance buffer
+const std::size_t min_instances = 2;
+}
+
+render_queue_stats& render_queue_stats::operator+=(const render_queue_stats& rhs)
+{
+	items += rhs.items;
+	program_changes += rhs.program_changes;
+	material_changes += rhs.material_changes;
+	mesh_changes += rhs.mesh_changes;
+	unsorted_state_changes += rhs.unsorted_state_changes;
+	instanced_draws += rhs.instanced_draws;
+	instances += rhs.instances;
+	sort_time += rhs.sort_time;
+	submit_time += rhs.submit_time;
+	return *this;
+}
+
+render_queue::recorder::recorder(render_queue& queue)
+	: _queue(queue)
+{
+}
+
+render_queue::recorder::~recorder()
+{
+	commit();
+}
+
+void render_queue::recorder::add(draw_item item, const math::transform* transforms, std::uint32_t count)
+{
+	item.transform_offset = static_cast<std::uint32_t>(_transforms.size());
+	item.transform_count = count;
+	_transforms.insert(_transforms.end(), transforms, transforms + count);
+	_items.push_back(item);
+}
+
+void render_queue::recorder::commit()
+{
+	if(_items.empty())
+		return;
+
+	_queue.append(_items, _transforms);
+	_items.clear();
+	_transforms.clear();
+}
+
+std::uint64_t render_queue::make_sort_key(std::uint8_t layer, const program* prog, const material* mat,
+										  const mesh* msh, std::uint32_t group_id, float depth)
+{
+	// layer 4 | program 12 | material 16 | mesh 14 | subset 6 | depth 12
+	const auto program_bits = prog ? std::uint64_t(prog->handle.idx) : 0xfffu;
+	const auto depth_bits = static_cast<std::uint64_t>(math::clamp(depth, 0.0f, 1.0f) * 4095.0f);
+
+	return (std::uint64_t(layer & 0xf) << 60) | ((program_bits & 0xfff) << 48) | (hash_pointer(mat, 16) << 32) |
+		   (hash_pointer(msh, 14) << 18) | (std::uint64_t(group_id & 0x3f) << 12) | depth_bits;
+}
+
+void render_queue::append(std::vector<draw_item>& items, std::vector<math::transform>& transforms)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	const auto offset = static_cast<std::uint32_t>(_transforms.size());
+	for(auto& item : items)
+	{
+		item.transform_offset += offset;
+	}
+
+	_items.insert(_items.end(), items.begin(), items.end());
+	_transforms.insert(_transforms.end(), transforms.begin(), transforms.end());
+}
+
+void render_queue::clear()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_items.clear();
+	_transforms.clear();
+}
+
+std::size_t render_queue::size() const
+{
+	return _items.size();
+}
+
+std::size_t render_queue::get_instance_run(std::size_t begin) const
+{
+	const auto& first = _items[_order[begin].second];
+	if(!first.instanced_prog || first.transform_count != 1)
+		return 1;
+
+	auto end = begin + 1;
+	while(end < _order.size() && can_instance(first, _items[_order[end].second]))
+	{
+		++end;
+	}
+	return end - begin;
+}
+
+render_queue_stats render_queue::flush(std::uint8_t id, const setup_pass_t& setup_pass,
+									   const setup_item_t& setup_item)
+{
+	using clock = std::chrono::high_resolution_clock;
+
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	render_queue_stats stats;
+	stats.items = static_cast<std::uint32_t>(_items.size());
+	if(_items.empty())
+		return stats;
+
+	const auto sort_start = clock::now();
+
+	_order.clear();
+	_order.reserve(_items.size());
+	for(std::size_t i = 0; i < _items.size(); ++i)
+	{
+		if(i > 0 && !same_state(_items[i - 1], _items[i]))
+			++stats.unsorted_state_changes;
+
+		_order.emplace_back(_items[i].key, static_cast<std::uint32_t>(i));
+	}
+	// the index breaks ties so the order is deterministic
+	std::sort(_order.begin(), _order.end());
+
+	const auto submit_start = clock::now();
+	stats.sort_time = submit_start - sort_start;
+
+	const bool instancing = (gfx::getCaps()->supported & BGFX_CAPS_INSTANCING) != 0;
+	const std::uint16_t instance_stride = sizeof(math::transform);
+
+	// Length of the instanceable run starting at each position, 0 inside runs.
+	_runs.assign(_order.size(), 0);
+	for(std::size_t i = 0; instancing && i < _order.size();)
+	{
+		const auto run = get_instance_run(i);
+		_runs[i] = std::uint32_t(run);
+		i += run;
+	}
+
+	const draw_item* last = nullptr;
+	bool preserved = false;
+	std::size_t i = 0;
+	while(i < _order.size())
+	{
+		const auto& item = _items[_order[i].second];
+
+		const bool new_material = !last || item.mat != last->mat || item.skinned != last->skinned;
+		const bool new_mesh = !last || item.msh != last->msh;
+
+		std::size_t run = _runs[i];
+		if(run >= min_instances)
+			run = gfx::getAvailInstanceDataBuffer(std::uint32_t(run), instance_stride);
+
+		if(run >= min_instances && item.instanced_prog->begin_pass())
+		{
+			// The whole run goes out as one draw with the world matrices in
+			// the instance data. State is never kept past it, the next draw
+			// must not inherit the instance buffer.
+			auto& prog = *item.instanced_prog;
+			setup_pass(prog);
+			if(item.mat)
+			{
+				item.mat->skinned = false;
+				item.mat->submit();
+			}
+			setup_item(prog, item);
+
+			const auto idb = gfx::allocInstanceDataBuffer(std::uint32_t(run), instance_stride);
+			auto data = reinterpret_cast<math::transform*>(idb->data);
+			for(std::size_t n = 0; n < run; ++n)
+			{
+				const auto& instance = _items[_order[i + n].second];
+				data[n] = _transforms[instance.transform_offset];
+			}
+
+			gfx::setInstanceDataBuffer(idb);
+			gfx::setState(item.states);
+			item.msh->draw_subset(item.group_id);
+			gfx::submit(id, prog.handle);
+
+			stats.program_changes += !last || last->prog != &prog;
+			stats.material_changes += new_material;
+			stats.mesh_changes += new_mesh;
+			++stats.instanced_draws;
+			stats.instances += std::uint32_t(run);
+
+			preserved = false;
+			// compare the next draw against the instanced program
+			_instanced_last = item;
+			_instanced_last.prog = &prog;
+			last = &_instanced_last;
+			i += run;
+			continue;
+		}
+
+		const bool new_program = !last || item.prog != last->prog;
+		if(new_program && !item.prog->begin_pass())
+		{
+			// nothing of the previous state is kept when this item is skipped
+			preserved = false;
+			last = nullptr;
+			++i;
+			continue;
+		}
+
+		// The previous submit kept its state when it shared the program and
+		// material, otherwise everything has to be bound again.
+		if(!preserved)
+		{
+			setup_pass(*item.prog);
+			if(item.mat)
+			{
+				item.mat->skinned = item.skinned;
+				item.mat->submit();
+			}
+		}
+
+		stats.program_changes += new_program;
+		stats.material_changes += new_material;
+		stats.mesh_changes += new_mesh;
+
+		setup_item(*item.prog, item);
+
+		gfx::setTransform(&_transforms[item.transform_offset], static_cast<std::uint16_t>(item.transform_count));
+		gfx::setState(item.states);
+		item.msh->draw_subset(item.group_id);
+
+		// Keep the state for the next item unless it starts an instanced run.
+		++i;
+		const auto next = i < _order.size() ? &_items[_order[i].second] : nullptr;
+		preserved = next && same_state(item, *next) && _runs[i] < min_instances;
+		gfx::submit(id, item.prog->handle, 0, preserved);
+
+		last = &item;
+	}
+
+	stats.submit_time = clock::now() - submit_start;
+
+	_items.clear();
+	_transforms.clear();
+
+	return stats;
+}
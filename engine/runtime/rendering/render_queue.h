@@ -0,0 +1,181 @@
+#pragma once
+#include "core/math/math_includes.h"
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+struct program;
+class material;
+class mesh;
+
+//-----------------------------------------------------------------------------
+//  Name : draw_item (Struct)
+/// <summary>
+/// A single subset of a mesh waiting in a render_queue.
+/// </summary>
+//-----------------------------------------------------------------------------
+struct draw_item
+{
+	/// Sort key, see render_queue::make_sort_key.
+	std::uint64_t key = 0;
+	/// Program to draw with.
+	program* prog = nullptr;
+	/// Program drawing several items at once, null when not instanceable.
+	program* instanced_prog = nullptr;
+	/// Material submitted before drawing, can be null.
+	material* mat = nullptr;
+	/// Mesh holding the subset.
+	mesh* msh = nullptr;
+	/// Data group of the subset.
+	std::uint32_t group_id = 0;
+	/// Render states.
+	std::uint64_t states = 0;
+	/// First matrix of the item in the queue.
+	std::uint32_t transform_offset = 0;
+	/// Number of matrices, more than one for skinned items.
+	std::uint32_t transform_count = 0;
+	/// Draw with the skinned variant of the material.
+	bool skinned = false;
+	/// Per item shader parameters, applied by the flush callback.
+	math::vec4 params;
+};
+
+//-----------------------------------------------------------------------------
+//  Name : render_queue_stats (Struct)
+/// <summary>
+/// Counters of the render queue flushes.
+/// </summary>
+//-----------------------------------------------------------------------------
+struct render_queue_stats
+{
+	/// Items submitted.
+	std::uint32_t items = 0;
+	/// Program changes between consecutive draws after sorting.
+	std::uint32_t program_changes = 0;
+	/// Material changes between consecutive draws after sorting.
+	std::uint32_t material_changes = 0;
+	/// Mesh changes between consecutive draws after sorting.
+	std::uint32_t mesh_changes = 0;
+	/// Program and material changes the recording order would have caused.
+	std::uint32_t unsorted_state_changes = 0;
+	/// Instanced draws issued.
+	std::uint32_t instanced_draws = 0;
+	/// Items drawn through instanced draws.
+	std::uint32_t instances = 0;
+	/// Time spent sorting.
+	std::chrono::duration<float> sort_time{0.0f};
+	/// Time spent submitting to the renderer.
+	std::chrono::duration<float> submit_time{0.0f};
+
+	render_queue_stats& operator+=(const render_queue_stats& rhs);
+};
+
+//-----------------------------------------------------------------------------
+//  Name : render_queue (Class)
+/// <summary>
+/// Collects draw items, sorts them by key and submits them so that draws
+/// sharing a program and material keep their bound state. Runs of items
+/// with the same mesh subset, material, states and parameters are drawn
+/// with instancing when it is supported. Items can be recorded from
+/// several threads through recorders, flushing is done on the render
+/// thread.
+/// </summary>
+//-----------------------------------------------------------------------------
+class render_queue
+{
+public:
+	//-----------------------------------------------------------------------------
+	//  Name : recorder (Class)
+	/// <summary>
+	/// Records items locally and adds them to the queue in one go when
+	/// committed or destroyed. Use one recorder per thread.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	class recorder
+	{
+	public:
+		explicit recorder(render_queue& queue);
+		~recorder();
+
+		recorder(const recorder&) = delete;
+		recorder& operator=(const recorder&) = delete;
+
+		//-----------------------------------------------------------------------------
+		//  Name : add ()
+		/// <summary>
+		/// Records an item drawn with count matrices starting at transforms.
+		/// </summary>
+		//-----------------------------------------------------------------------------
+		void add(draw_item item, const math::transform* transforms, std::uint32_t count);
+
+		//-----------------------------------------------------------------------------
+		//  Name : commit ()
+		/// <summary>
+		/// Moves the recorded items to the queue.
+		/// </summary>
+		//-----------------------------------------------------------------------------
+		void commit();
+
+	private:
+		render_queue& _queue;
+		std::vector<draw_item> _items;
+		std::vector<math::transform> _transforms;
+	};
+
+	using setup_pass_t = std::function<void(program&)>;
+	using setup_item_t = std::function<void(program&, const draw_item&)>;
+
+	//-----------------------------------------------------------------------------
+	//  Name : make_sort_key ()
+	/// <summary>
+	/// Builds a key ordering items by layer, program, material, mesh, subset
+	/// and finally front to back by depth, which is expected in the [0, 1]
+	/// range.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	static std::uint64_t make_sort_key(std::uint8_t layer, const program* prog, const material* mat,
+									   const mesh* msh, std::uint32_t group_id, float depth);
+
+	//-----------------------------------------------------------------------------
+	//  Name : clear ()
+	/// <summary>
+	/// Removes all items.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void clear();
+
+	//-----------------------------------------------------------------------------
+	//  Name : size ()
+	/// <summary>
+	/// Number of committed items.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	std::size_t size() const;
+
+	//-----------------------------------------------------------------------------
+	//  Name : flush ()
+	/// <summary>
+	/// Sorts and submits the items to the view, then clears the queue.
+	/// setup_pass is called whenever the bound state has to be set again,
+	/// setup_item before every draw.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	render_queue_stats flush(std::uint8_t id, const setup_pass_t& setup_pass, const setup_item_t& setup_item);
+
+private:
+	void append(std::vector<draw_item>& items, std::vector<math::transform>& transforms);
+	std::size_t get_instance_run(std::size_t begin) const;
+
+	std::mutex _mutex;
+	std::vector<draw_item> _items;
+	std::vector<math::transform> _transforms;
+	/// Scratch list of keys and item indices to sort.
+	std::vector<std::pair<std::uint64_t, std::uint32_t>> _order;
+	/// Scratch lengths of the instanceable runs in sorted order.
+	std::vector<std::uint32_t> _runs;
+	/// Stands in for the last draw after an instanced one.
+	draw_item _instanced_last;
+};
@@ -0,0 +1,138 @@
+#include "transient_pool.h"
+#include <algorithm>
+
+transient_pool::resource transient_pool::declare(const texture_desc& desc)
+{
+	virtual_texture v;
+	v.desc = desc;
+	_virtual.push_back(v);
+
+	gfx::TextureInfo info;
+	gfx::calcTextureSize(info, desc.width, desc.height, 1, false, false, 1, desc.format);
+	++_frame_stats.virtual_textures;
+	_frame_stats.requested_memory += info.storageSize;
+
+	return static_cast<resource>(_virtual.size() - 1);
+}
+
+void transient_pool::write(resource r, std::uint32_t pass)
+{
+	auto& v = _virtual[r];
+	v.first = std::min(v.first, pass);
+	v.last = std::max(v.last, pass);
+}
+
+void transient_pool::read(resource r, std::uint32_t pass)
+{
+	write(r, pass);
+}
+
+void transient_pool::compile()
+{
+	// Hand out textures in order of first use, a physical texture is free
+	// for a declaration starting after the last pass of its occupant.
+	_order.clear();
+	for(std::size_t i = 0; i < _virtual.size(); ++i)
+	{
+		auto& v = _virtual[i];
+		// never used, keep it alive through the whole chain
+		if(v.first > v.last)
+		{
+			v.first = 0;
+			v.last = std::numeric_limits<std::uint32_t>::max();
+		}
+		_order.push_back(i);
+	}
+	std::stable_sort(_order.begin(), _order.end(),
+					 [this](std::size_t a, std::size_t b) { return _virtual[a].first < _virtual[b].first; });
+
+	for(auto i : _order)
+	{
+		auto& v = _virtual[i];
+		auto it = std::find_if(_physical.begin(), _physical.end(), [&v](const physical_texture& p) {
+			return p.desc == v.desc && (!p.busy || p.busy_until < v.first);
+		});
+
+		if(it == _physical.end())
+		{
+			physical_texture p;
+			p.desc = v.desc;
+			p.tex = std::make_shared<texture>(v.desc.width, v.desc.height, false, 1, v.desc.format, v.desc.flags);
+
+			gfx::TextureInfo info;
+			gfx::calcTextureSize(info, v.desc.width, v.desc.height, 1, false, false, 1, v.desc.format);
+			p.size = info.storageSize;
+
+			++_frame_stats.created_textures;
+			it = _physical.insert(_physical.end(), p);
+		}
+
+		if(!it->used)
+		{
+			it->used = true;
+			++_frame_stats.physical_textures;
+			_frame_stats.allocated_memory += it->size;
+		}
+
+		it->busy = true;
+		it->busy_until = v.last;
+		v.physical = std::size_t(it - _physical.begin());
+	}
+}
+
+const std::shared_ptr<texture>& transient_pool::get(resource r)
+{
+	++_frame_stats.lookups;
+	return _physical[_virtual[r].physical].tex;
+}
+
+std::shared_ptr<frame_buffer> transient_pool::get_fbo(const std::vector<std::shared_ptr<texture>>& textures)
+{
+	++_frame_stats.lookups;
+
+	auto it = std::find_if(_fbos.begin(), _fbos.end(),
+						   [&textures](const fbo_entry& e) { return e.textures == textures; });
+	if(it == _fbos.end())
+	{
+		fbo_entry e;
+		e.textures = textures;
+		e.fbo = std::make_shared<frame_buffer>(textures);
+		it = _fbos.insert(_fbos.end(), e);
+	}
+
+	it->used = true;
+	return it->fbo;
+}
+
+void transient_pool::reset()
+{
+	_virtual.clear();
+	for(auto& p : _physical)
+	{
+		p.busy = false;
+	}
+}
+
+void transient_pool::end_frame()
+{
+	reset();
+
+	// Frame buffers go first so they no longer hold the textures.
+	_fbos.erase(std::remove_if(_fbos.begin(), _fbos.end(), [](const fbo_entry& e) { return !e.used; }),
+				_fbos.end());
+	for(auto& e : _fbos)
+	{
+		e.used = false;
+	}
+
+	_physical.erase(std::remove_if(_physical.begin(), _physical.end(),
+								   [](const physical_texture& p) { return !p.used; }),
+					_physical.end());
+	for(auto& p : _physical)
+	{
+		p.used = false;
+	}
+
+	_stats = _frame_stats;
+	_frame_stats = transient_pool_stats();
+}
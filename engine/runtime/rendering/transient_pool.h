@@ -0,0 +1,184 @@
+#pragma once
+
+#include "frame_buffer.h"
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+//-----------------------------------------------------------------------------
+//  Name : transient_pool_stats (Struct)
+/// <summary>
+/// Counters of the transient pool over a frame.
+/// </summary>
+//-----------------------------------------------------------------------------
+struct transient_pool_stats
+{
+	/// Textures declared by the passes.
+	std::uint32_t virtual_textures = 0;
+	/// Physical textures backing them.
+	std::uint32_t physical_textures = 0;
+	/// Physical textures that had to be created.
+	std::uint32_t created_textures = 0;
+	/// Bytes the declared textures would take without aliasing.
+	std::uint64_t requested_memory = 0;
+	/// Bytes of the physical textures backing them.
+	std::uint64_t allocated_memory = 0;
+	/// Texture and frame buffer lookups.
+	std::uint32_t lookups = 0;
+
+	std::uint64_t get_saved_memory() const
+	{
+		return requested_memory > allocated_memory ? requested_memory - allocated_memory : 0;
+	}
+};
+
+//-----------------------------------------------------------------------------
+//  Name : transient_pool (Class)
+/// <summary>
+/// Frame graph style allocator for render targets that only live through a
+/// chain of passes. A chain declares its textures and which of its passes
+/// write and read them, compile then works out their lifetimes and backs
+/// textures whose lifetimes do not overlap with the same physical texture.
+/// Passes are submitted in order, so once a chain is reset its physical
+/// textures are free for the next chain of the frame, e.g. the next face
+/// of a reflection probe. Textures not used for a whole frame are released.
+/// </summary>
+//-----------------------------------------------------------------------------
+class transient_pool
+{
+public:
+	using resource = std::uint32_t;
+
+	static const resource invalid_resource = std::numeric_limits<resource>::max();
+
+	//-----------------------------------------------------------------------------
+	//  Name : texture_desc (Struct)
+	/// <summary>
+	/// Physical textures are only shared between equal descriptions.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	struct texture_desc
+	{
+		std::uint16_t width = 0;
+		std::uint16_t height = 0;
+		gfx::TextureFormat::Enum format = gfx::TextureFormat::Count;
+		std::uint32_t flags = gfx::get_default_rt_sampler_flags();
+
+		bool operator==(const texture_desc& rhs) const
+		{
+			return width == rhs.width && height == rhs.height && format == rhs.format && flags == rhs.flags;
+		}
+	};
+
+	//-----------------------------------------------------------------------------
+	//  Name : declare ()
+	/// <summary>
+	/// Declares a texture of the current chain.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	resource declare(const texture_desc& desc);
+
+	//-----------------------------------------------------------------------------
+	//  Name : write ()
+	/// <summary>
+	/// Declares that the pass with the given order in the chain writes r.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void write(resource r, std::uint32_t pass);
+
+	//-----------------------------------------------------------------------------
+	//  Name : read ()
+	/// <summary>
+	/// Declares that the pass with the given order in the chain reads r.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void read(resource r, std::uint32_t pass);
+
+	//-----------------------------------------------------------------------------
+	//  Name : compile ()
+	/// <summary>
+	/// Assigns physical textures to the declared ones.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void compile();
+
+	//-----------------------------------------------------------------------------
+	//  Name : get ()
+	/// <summary>
+	/// Physical texture of a compiled resource.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	const std::shared_ptr<texture>& get(resource r);
+
+	//-----------------------------------------------------------------------------
+	//  Name : get_fbo ()
+	/// <summary>
+	/// Frame buffer over the given textures, cached while they are alive.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	std::shared_ptr<frame_buffer> get_fbo(const std::vector<std::shared_ptr<texture>>& textures);
+
+	//-----------------------------------------------------------------------------
+	//  Name : reset ()
+	/// <summary>
+	/// Ends the current chain, its declarations are dropped and all physical
+	/// textures become free again.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void reset();
+
+	//-----------------------------------------------------------------------------
+	//  Name : end_frame ()
+	/// <summary>
+	/// Releases the textures the frame did not use and publishes the stats.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	void end_frame();
+
+	//-----------------------------------------------------------------------------
+	//  Name : get_stats ()
+	/// <summary>
+	/// Returns the counters of the last frame.
+	/// </summary>
+	//-----------------------------------------------------------------------------
+	const transient_pool_stats& get_stats() const
+	{
+		return _stats;
+	}
+
+private:
+	struct virtual_texture
+	{
+		texture_desc desc;
+		std::uint32_t first = std::numeric_limits<std::uint32_t>::max();
+		std::uint32_t last = 0;
+		std::size_t physical = 0;
+	};
+
+	struct physical_texture
+	{
+		texture_desc desc;
+		std::shared_ptr<texture> tex;
+		std::uint64_t size = 0;
+		/// Last pass of the chain reading it, free when not busy.
+		std::uint32_t busy_until = 0;
+		bool busy = false;
+		bool used = false;
+	};
+
+	struct fbo_entry
+	{
+		std::vector<std::shared_ptr<texture>> textures;
+		std::shared_ptr<frame_buffer> fbo;
+		bool used = false;
+	};
+
+	std::vector<virtual_texture> _virtual;
+	std::vector<physical_texture> _physical;
+	std::vector<fbo_entry> _fbos;
+	/// Scratch declaration order sorted by first use.
+	std::vector<std::size_t> _order;
+	transient_pool_stats _frame_stats;
+	transient_pool_stats _stats;
+};
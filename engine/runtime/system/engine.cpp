@@ -1,5 +1,6 @@
 #include "engine.h"
 #include "../assets/asset_manager.h"
+#include "../assets/asset_streamer.h"
 #include "../ecs/ecs.h"
 #include "../ecs/systems/camera_system.h"
 #include "../ecs/systems/deferred_rendering.h"
@@ -7,6 +8,8 @@
 #include "../input/input.h"
 #include "../rendering/render_window.h"
 #include "../rendering/renderer.h"
+#include "core/filesystem/archive.h"
+#include "core/filesystem/filesystem.h"
 #include "core/serialization/serialization.h"
 #include "core/system/simulation.h"
 #include "core/system/task_system.h"
@@ -48,7 +51,8 @@ void engine::dispose()
 bool engine::start(std::unique_ptr<render_window> main_window)
 {
 	core::add_subsystem<core::simulation>();
-	core::add_subsystem<core::task_system>();
+	core::add_subsystem<core::task_system>(std::thread::hardware_concurrency(),
+										   core::task_system::scheduling_mode::work_stealing);
 
 	auto& render = core::add_subsystem<renderer>();
 	if(!render.init_backend(*main_window))
@@ -58,7 +62,18 @@ bool engine::start(std::unique_ptr<render_window> main_window)
 	}
 	register_main_window(std::move(main_window));
 
+	// A packed build reads its assets from the archive the editor writes.
+	// The editor maps "app:" only once a project is open and keeps reading
+	// the loose files.
+	fs::error_code err;
+	const auto packed_data = fs::resolve_protocol("app:/data.pak");
+	if(!packed_data.empty() && fs::exists(packed_data, err) && !fs::mount_archive("app:", packed_data))
+	{
+		APPLOG_ERROR("Could not mount {0}", packed_data.string());
+	}
+
 	core::add_subsystem<input>();
+	core::add_subsystem<asset_streamer>();
 	core::add_subsystem<asset_manager>();
 	core::add_subsystem<entity_component_system>();
 	core::add_subsystem<scene_graph>();
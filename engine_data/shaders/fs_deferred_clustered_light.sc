@@ -0,0 +1,74 @@
+$input v_texcoord0
+
+#include "fs_pbr_lighting.sh"
+
+SAMPLER2D(s_tex7, 7); // cluster offset and count
+SAMPLER2D(s_tex8, 8); // light indices
+SAMPLER2D(s_tex9, 9); // light data, one row of 4 texels per light
+
+// tiles x, tiles y, slices, light index texture size
+uniform vec4 u_cluster_size;
+// slice scale, slice bias, linear slicing, light data texture height
+uniform vec4 u_cluster_depth;
+
+// upper bound of the loop, the light data texture never holds more lights
+#define MAX_CLUSTER_LIGHTS 256
+
+void main()
+{
+	vec2 texcoord0 = v_texcoord0;
+	GBufferData data = decodeGBuffer(texcoord0, s_tex0, s_tex1, s_tex2, s_tex3, s_tex4);
+	vec3 indirect_specular = texture2D(s_tex5, texcoord0).xyz;
+	vec3 clip = vec3(texcoord0 * 2.0 - 1.0, data.depth);
+	clip = clipTransform(clip);
+	vec3 world_position = clipToWorld(u_invViewProj, clip);
+	vec3 indirect_diffuse = vec3(0.0f, 0.0f, 0.0f);
+
+	// Same cluster lookup as light_clusters on the CPU.
+	float view_depth = mul(u_view, vec4(world_position, 1.0)).z;
+	float depth = u_cluster_depth.z > 0.5f ? view_depth : log(max(view_depth, 0.000001f));
+	float slice = clamp(floor(depth * u_cluster_depth.x + u_cluster_depth.y), 0.0f, u_cluster_size.z - 1.0f);
+	vec2 tile = clamp(floor((clip.xy * 0.5f + 0.5f) * u_cluster_size.xy), vec2(0.0f, 0.0f), u_cluster_size.xy - 1.0f);
+	vec2 cluster_uv = vec2((tile.y * u_cluster_size.x + tile.x + 0.5f) / (u_cluster_size.x * u_cluster_size.y),
+						   (slice + 0.5f) / u_cluster_size.z);
+	vec2 cluster = texture2DLod(s_tex7, cluster_uv, 0.0f).xy;
+
+	vec3 lighting = vec3(0.0f, 0.0f, 0.0f);
+	for(int i = 0; i < MAX_CLUSTER_LIGHTS; ++i)
+	{
+		if(float(i) >= cluster.y)
+			break;
+
+		float index = cluster.x + float(i);
+		vec2 index_uv = vec2(mod(index, u_cluster_size.w) + 0.5f, floor(index / u_cluster_size.w) + 0.5f) / u_cluster_size.w;
+		float light = texture2DLod(s_tex8, index_uv, 0.0f).x;
+
+		float row = (light + 0.5f) / u_cluster_depth.w;
+		vec4 position_range = texture2DLod(s_tex9, vec2(0.125f, row), 0.0f);
+		vec4 direction_type = texture2DLod(s_tex9, vec2(0.375f, row), 0.0f);
+		vec4 color_intensity = texture2DLod(s_tex9, vec2(0.625f, row), 0.0f);
+		vec4 params = texture2DLod(s_tex9, vec2(0.875f, row), 0.0f);
+
+		vec3 vector_to_light = position_range.xyz - world_position;
+		vec3 vector_to_light_over_radius = vector_to_light / position_range.w;
+		float light_radius_mask = 0.0f;
+		float spot_falloff = 1.0f;
+		// light_type::spot is 0, light_type::point is 1
+		if(direction_type.w < 0.5f)
+		{
+			light_radius_mask = RadialAttenuation(vector_to_light_over_radius, 1.0f);
+			spot_falloff = SpotAttenuation(vector_to_light_over_radius, normalize(direction_type.xyz), vec2(params.z, 1.0f / (params.y - params.z)));
+		}
+		else
+		{
+			light_radius_mask = RadialAttenuation(vector_to_light_over_radius, params.x);
+		}
+
+		lighting += pbr_light_surface(data, world_position, indirect_specular, indirect_diffuse, vector_to_light, color_intensity.xyz, color_intensity.w, light_radius_mask, spot_falloff);
+	}
+
+	// added once for every pixel, like each light pass of its own does
+	lighting += data.emissive_color;
+
+	gl_FragColor = vec4(lighting, 1.0f);
+}